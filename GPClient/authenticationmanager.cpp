@@ -1,9 +1,15 @@
 #include "authenticationmanager.h"
 #include "portalauthenticator.h"
 #include "gatewayauthenticator.h"
+#include "gatewayprober.h"
 #include "gphelper.h"
-#include <QNetworkAccessManager>
+#include "settingsmanager.h"
+#include "connectionpool.h"
+#include "gatewayresolver.h"
+#include "taskexecutor.h"
+#include "phasetimeouts.h"
 #include <QTimer>
+#include <algorithm>
 #include "logging.h"
 
 using namespace gpclient::helper;
@@ -11,16 +17,27 @@ using namespace gpclient::helper;
 AuthenticationManager::AuthenticationManager(QObject *parent)
     : QObject(parent)
     , m_currentState(AuthState::Idle)
-    , m_networkManager(std::make_unique<QNetworkAccessManager>(this))
+    , m_gatewayProber(new GatewayProber(this))
+    , m_precheck(new NetworkPrecheck(this))
     , m_timeoutTimer(new QTimer(this))
+    , m_refreshTimer(new QTimer(this))
 {
+    m_refreshTimer->setSingleShot(true);
+    connect(m_refreshTimer, &QTimer::timeout, this, &AuthenticationManager::revalidatePortalConfig);
+
+    connect(m_gatewayProber, &GatewayProber::finished, this, &AuthenticationManager::onGatewaysRanked);
+    connect(m_precheck, &NetworkPrecheck::finished, this, &AuthenticationManager::onPrecheckFinished);
+
     m_timeoutTimer->setSingleShot(true);
-    m_timeoutTimer->setInterval(AUTH_TIMEOUT_MS);
     connect(m_timeoutTimer, &QTimer::timeout, this, [this]() {
         LOGE << "Authentication timeout occurred";
+        if (!m_phaseInteractive) {
+            PhaseTimeouts::instance().recordTimeout(m_phase, m_phaseAddress, m_timeoutTimer->interval());
+        }
         setState(AuthState::Failed);
         emit authenticationFailed("Authentication timeout");
         cleanupCurrentAuth();
+        dropSpeculativePrelogin();
     });
 }
 
@@ -39,7 +56,7 @@ void AuthenticationManager::setState(AuthState newState)
     }
 }
 
-void AuthenticationManager::authenticatePortal(const QString &portalAddress)
+void AuthenticationManager::authenticatePortal(const QString &portalAddress, const QString &expectedGateway)
 {
     if (m_currentState != AuthState::Idle) {
         LOGW << "Authentication already in progress";
@@ -51,7 +68,48 @@ void AuthenticationManager::authenticatePortal(const QString &portalAddress)
     cleanupCurrentAuth();
     
     setState(AuthState::AuthenticatingPortal);
+    emit authenticationProgress("Checking the network...");
+
+    // A captive portal or an offline network is told in under a second, rather than after the prelogin timeout
+    m_expectedGateway = expectedGateway;
+    m_precheck->check(portalAddress);
+}
+
+void AuthenticationManager::onPrecheckFinished(NetworkPrecheck::Reachability reachability, const QString &message)
+{
+    if (m_currentState != AuthState::AuthenticatingPortal) {
+        return;
+    }
+
+    if (reachability == NetworkPrecheck::Reachability::Offline
+        || reachability == NetworkPrecheck::Reachability::Captive
+        || reachability == NetworkPrecheck::Reachability::DnsBroken) {
+        LOGW << "The portal cannot be reached: " << message;
+        setState(AuthState::Failed);
+        emit authenticationFailed(message);
+        return;
+    }
+
+    if (!message.isEmpty()) {
+        LOGW << "Network precheck: " << message;
+        emit authenticationWarning(message);
+    }
+    startPortalAuth(m_portalAddress, m_expectedGateway);
+}
+
+void AuthenticationManager::startPortalAuth(const QString &portalAddress, const QString &expectedGateway)
+{
     emit authenticationProgress("Authenticating with portal...");
+
+    m_fromCachedConfig = false;
+    if (authenticateFromCache(portalAddress)) {
+        return;
+    }
+
+    // Overlaps the gateway DNS, TLS and prelogin with the portal login and getconfig.esp
+    if (!expectedGateway.isEmpty()) {
+        startSpeculativePrelogin(expectedGateway);
+    }
     
     try {
         m_portalAuth = std::make_unique<PortalAuthenticator>(
@@ -68,8 +126,11 @@ void AuthenticationManager::authenticatePortal(const QString &portalAddress)
         connect(m_portalAuth.get(), &PortalAuthenticator::portalConfigFailed, 
                 this, &AuthenticationManager::onPortalConfigFailed);
         
-        m_timeoutTimer->start();
-        m_portalAuth->authenticate();
+        connect(m_portalAuth.get(), &PortalAuthenticator::interactionStarted,
+                this, &AuthenticationManager::onInteractionStarted);
+        
+        startPhase(PhaseTimeouts::Phase::PortalAuth, portalAddress);
+        authenticateWithStoredCookie(portalAddress, m_portalAuth.get());
         
     } catch (const std::exception &e) {
         LOGE << "Failed to create portal authenticator: " << e.what();
@@ -79,7 +140,8 @@ void AuthenticationManager::authenticatePortal(const QString &portalAddress)
 }
 
 void AuthenticationManager::authenticateGateway(const QString &gatewayAddress, 
-                                               const GatewayAuthenticatorParams &params)
+                                               const GatewayAuthenticatorParams &params,
+                                               const QString &cookiePortal)
 {
     if (m_currentState != AuthState::Idle) {
         LOGW << "Authentication already in progress";
@@ -92,7 +154,43 @@ void AuthenticationManager::authenticateGateway(const QString &gatewayAddress,
     
     setState(AuthState::AuthenticatingGateway);
     emit authenticationProgress("Authenticating with gateway...");
-    
+    startPhase(PhaseTimeouts::Phase::GatewayAuth, gatewayAddress);
+
+    if (cookiePortal.isEmpty() || !params.userAuthCookie().isEmpty() || !params.prelogonUserAuthCookie().isEmpty()) {
+        startGatewayAuth(gatewayAddress, params);
+        return;
+    }
+
+    const QString username = params.username().isEmpty()
+        ? SettingsManager::instance().cachedPortalConfig(cookiePortal).config.username()
+        : params.username();
+    if (username.isEmpty()) {
+        startGatewayAuth(gatewayAddress, params);
+        return;
+    }
+
+    // The keychain is read off the GUI thread, the attempt may be reset in the meantime
+    const quint64 attempt = m_gatewayAttempt;
+    SettingsManager::instance().loadUserAuthCookie(cookiePortal, username).then(this,
+        [this, attempt, gatewayAddress, params, cookiePortal, username](SettingsManager::StoredUserAuthCookie stored) mutable {
+            if (attempt != m_gatewayAttempt || m_currentState != AuthState::AuthenticatingGateway) {
+                return;
+            }
+
+            if (stored.isValid()) {
+                LOGI << "Trying the saved portal cookie of " << username << " on the gateway";
+                params.setUsername(username);
+                params.setUserAuthCookie(stored.userAuthCookie);
+                params.setPrelogonUserAuthCookie(stored.prelogonUserAuthCookie);
+                m_cookiePortal = cookiePortal;
+                m_cookieUser = username;
+            }
+            startGatewayAuth(gatewayAddress, params);
+        });
+}
+
+void AuthenticationManager::startGatewayAuth(const QString &gatewayAddress, const GatewayAuthenticatorParams &params)
+{
     try {
         m_gatewayAuth = std::make_unique<GatewayAuthenticator>(gatewayAddress, params);
         
@@ -100,8 +198,19 @@ void AuthenticationManager::authenticateGateway(const QString &gatewayAddress,
                 this, &AuthenticationManager::onGatewayAuthSuccess);
         connect(m_gatewayAuth.get(), &GatewayAuthenticator::fail, 
                 this, &AuthenticationManager::onGatewayAuthFailed);
+        connect(m_gatewayAuth.get(), &GatewayAuthenticator::userAuthCookieRejected,
+                this, &AuthenticationManager::onUserAuthCookieRejected);
+        connect(m_gatewayAuth.get(), &GatewayAuthenticator::interactionStarted,
+                this, &AuthenticationManager::onInteractionStarted);
+
+        if (m_speculativePrelogin && m_speculativeGateway == gatewayAddress) {
+            m_gatewayAuth->setPrelogin(m_speculativePrelogin);
+            m_speculativePrelogin = nullptr;
+            m_speculativeGateway.clear();
+        } else {
+            dropSpeculativePrelogin();
+        }
         
-        m_timeoutTimer->start();
         m_gatewayAuth->authenticate();
         
     } catch (const std::exception &e) {
@@ -111,6 +220,27 @@ void AuthenticationManager::authenticateGateway(const QString &gatewayAddress,
     }
 }
 
+bool AuthenticationManager::reauthenticateGateway(const QString &gatewayAddress,
+                                                  const GatewayAuthenticatorParams &params,
+                                                  const QString &cookiePortal)
+{
+    // The cookie of the last login was handed to the connection manager, the portal data are kept
+    if (m_currentState == AuthState::Authenticated || m_currentState == AuthState::Failed) {
+        m_timeoutTimer->stop();
+        cleanupCurrentAuth();
+        m_authCookie.clear();
+        setState(AuthState::Idle);
+    }
+
+    if (m_currentState != AuthState::Idle) {
+        LOGW << "Authentication already in progress, not logging in to " << gatewayAddress;
+        return false;
+    }
+
+    authenticateGateway(gatewayAddress, params, cookiePortal);
+    return true;
+}
+
 void AuthenticationManager::authenticateGatewayDirect(const QString &gatewayAddress)
 {
     LOGI << "Starting direct gateway authentication (treating portal as gateway)";
@@ -132,7 +262,15 @@ void AuthenticationManager::reset()
     LOGI << "Resetting authentication manager";
     
     m_timeoutTimer->stop();
+    m_gatewayAttempt++;
+    m_precheck->abort();
+    m_gatewayProber->abort();
+    m_rankingInBackground = false;
+    m_fromCachedConfig = false;
+    m_refreshTimer->stop();
     cleanupCurrentAuth();
+    dropSpeculativePrelogin();
+    finishRevalidation();
     
     m_portalAddress.clear();
     m_gatewayAddress.clear();
@@ -151,10 +289,15 @@ void AuthenticationManager::cleanupCurrentAuth()
 
 void AuthenticationManager::onPortalAuthSuccess(const PortalConfigResponse &response, const QString &region)
 {
-    m_timeoutTimer->stop();
+    finishPhase();
     
     LOGI << "Portal authentication succeeded";
     m_portalConfig = response;
+
+    SettingsManager::instance().setCachedPortalConfig(m_portalAddress, response, region);
+    GatewayResolver::instance().resolve(response.allGateways());
+    storeUserAuthCookie(m_portalAddress, response);
+    scheduleRevalidation(m_portalAddress);
     
     // Check if we have gateways
     if (response.allGateways().isEmpty()) {
@@ -165,20 +308,78 @@ void AuthenticationManager::onPortalAuthSuccess(const PortalConfigResponse &resp
         return;
     }
     
-    // Select preferred gateway
-    GPGateway preferredGateway = filterPreferredGateway(response.allGateways(), region);
-    
+    // The expected gateway is still offered, its prelogin is already on the way
+    if (!m_speculativeGateway.isEmpty()) {
+        for (const auto &gateway : response.allGateways()) {
+            if (gateway.address() != m_speculativeGateway) {
+                continue;
+            }
+
+            LOGI << "The portal confirmed the expected gateway: " << gateway.name();
+            if (response.allGateways().size() > 1) {
+                m_rankingInBackground = true;
+                m_portalRegion = region;
+                m_gatewayProber->probe(response.allGateways(), region);
+            }
+            continueWithGateway(gateway, region);
+            return;
+        }
+
+        LOGI << "The expected gateway is not offered by the portal anymore";
+        dropSpeculativePrelogin();
+    }
+
+    if (response.allGateways().size() == 1) {
+        continueWithGateway(response.allGateways().first(), region);
+        return;
+    }
+
+    // Rank the gateways by latency before choosing one, see onGatewaysRanked()
+    m_portalRegion = region;
+    m_rankingInBackground = false;
+    emit authenticationProgress("Measuring the gateways...");
+    m_gatewayProber->probe(response.allGateways(), region);
+}
+
+void AuthenticationManager::onGatewaysRanked(const QList<GPGateway> &ranked)
+{
+    // The ranking becomes the order of the gateways for the client and its gateway menu
+    m_portalConfig.setAllGateways(ranked);
+    preconnectGateways(ranked);
+
+    if (m_rankingInBackground) {
+        m_rankingInBackground = false;
+        emit gatewaysReranked(ranked);
+        return;
+    }
+
+    GPGateway preferredGateway;
+    if (!ranked.isEmpty() && ranked.first().latency() >= 0) {
+        preferredGateway = ranked.first();
+        LOGI << "Selected the fastest gateway: " << preferredGateway.name() << " (" << preferredGateway.latency() << " ms)";
+    } else {
+        // None answered in time
+        preferredGateway = filterPreferredGateway(ranked, m_portalRegion);
+    }
+
+    continueWithGateway(preferredGateway, m_portalRegion);
+}
+
+void AuthenticationManager::continueWithGateway(const GPGateway &gateway, const QString &region)
+{
+    const PortalConfigResponse response = m_portalConfig;
+
     // Now authenticate with the selected gateway
     GatewayAuthenticatorParams params = GatewayAuthenticatorParams::fromPortalConfigResponse(response);
     params.setClientos(settings::get("clientos", "Linux").toString());
-    
+
     cleanupCurrentAuth();
     setState(AuthState::Idle);
     
     emit portalAuthenticationSucceeded(response, region);
     
-    // Continue with gateway authentication
-    authenticateGateway(preferredGateway.address(), params);
+    // Continue with gateway authentication, without a fresh cookie of the portal the saved one spares the gateway login
+    authenticateGateway(gateway.address(), params, m_portalAddress);
 }
 
 void AuthenticationManager::onPortalAuthFailed(const QString &errorMessage)
@@ -188,6 +389,7 @@ void AuthenticationManager::onPortalAuthFailed(const QString &errorMessage)
     LOGE << "Portal authentication failed: " << errorMessage;
     setState(AuthState::Failed);
     cleanupCurrentAuth();
+    dropSpeculativePrelogin();
     emit authenticationFailed(QString("Portal authentication failed: %1").arg(errorMessage));
 }
 
@@ -217,7 +419,7 @@ void AuthenticationManager::onPortalConfigFailed(const QString &errorMessage)
 
 void AuthenticationManager::onGatewayAuthSuccess(const QString &authCookie)
 {
-    m_timeoutTimer->stop();
+    finishPhase();
     
     LOGI << "Gateway authentication succeeded";
     m_authCookie = authCookie;
@@ -237,11 +439,252 @@ void AuthenticationManager::onGatewayAuthFailed(const QString &errorMessage)
     m_timeoutTimer->stop();
     
     LOGE << "Gateway authentication failed: " << errorMessage;
+
+    // The cached configuration may be the reason, the next attempt goes through the portal
+    if (m_fromCachedConfig) {
+        m_fromCachedConfig = false;
+        SettingsManager::instance().clearCachedPortalConfig(m_portalAddress);
+    }
+
     setState(AuthState::Failed);
     cleanupCurrentAuth();
     emit authenticationFailed(QString("Gateway authentication failed: %1").arg(errorMessage));
 }
 
+void AuthenticationManager::startPhase(PhaseTimeouts::Phase phase, const QString &address)
+{
+    m_phase = phase;
+    m_phaseAddress = address;
+    m_phaseInteractive = false;
+    m_phaseTimer.start();
+    m_timeoutTimer->start(PhaseTimeouts::instance().timeoutMs(phase, address));
+}
+
+void AuthenticationManager::finishPhase()
+{
+    m_timeoutTimer->stop();
+
+    // A login shown to the user tells nothing of the network
+    if (!m_phaseInteractive && m_phaseTimer.isValid()) {
+        PhaseTimeouts::instance().recordSuccess(m_phase, m_phaseAddress, m_phaseTimer.elapsed());
+    }
+    m_phaseTimer.invalidate();
+}
+
+void AuthenticationManager::onInteractionStarted()
+{
+    // The user gets the usual time, whatever the history of the server
+    m_phaseInteractive = true;
+    m_timeoutTimer->start(AUTH_TIMEOUT_MS);
+}
+
+void AuthenticationManager::startSpeculativePrelogin(const QString &gatewayAddress)
+{
+    dropSpeculativePrelogin();
+
+    LOGI << "Sending the prelogin of " << gatewayAddress << " ahead of the portal configuration";
+    m_speculativeGateway = gatewayAddress;
+    m_speculativePrelogin = createRequest(
+        GatewayAuthenticator::preloginUrlOf(gatewayAddress, settings::get("clientos", "Linux").toString()));
+}
+
+void AuthenticationManager::preconnectGateways(const QList<GPGateway> &ranked)
+{
+    for (int i = 0; i < ranked.size() && i < PRECONNECT_GATEWAYS; ++i) {
+        ConnectionPool::instance().preconnect(ranked.at(i).address());
+    }
+}
+
+void AuthenticationManager::dropSpeculativePrelogin()
+{
+    if (m_speculativePrelogin) {
+        LOGI << "Dropping the prelogin sent to " << m_speculativeGateway;
+        m_speculativePrelogin->abort();
+        m_speculativePrelogin->deleteLater();
+    }
+    m_speculativePrelogin = nullptr;
+    m_speculativeGateway.clear();
+}
+
+bool AuthenticationManager::authenticateFromCache(const QString &portalAddress)
+{
+    SettingsManager &settingsManager = SettingsManager::instance();
+    const SettingsManager::CachedPortalConfig cached = settingsManager.cachedPortalConfig(portalAddress);
+
+    if (!cached.isValid() || cached.config.allGateways().isEmpty()) {
+        return false;
+    }
+
+    LOGI << "Using the configuration of the portal cached at " << cached.fetchedAt.toString(Qt::ISODate);
+
+    // In the order ranked by the previous sessions, the new gateways last
+    const QList<GPGateway> saved = settingsManager.gateways(portalAddress);
+    auto rankOf = [&saved](const GPGateway &gateway) {
+        for (int i = 0; i < saved.size(); ++i) {
+            if (saved.at(i).address() == gateway.address()) {
+                return i;
+            }
+        }
+        return int(saved.size());
+    };
+
+    QList<GPGateway> gateways = cached.config.allGateways();
+    std::stable_sort(gateways.begin(), gateways.end(), [&rankOf](const GPGateway &a, const GPGateway &b) {
+        return rankOf(a) < rankOf(b);
+    });
+
+    m_portalConfig = cached.config;
+    m_portalConfig.setAllGateways(gateways);
+    preconnectGateways(gateways);
+    GatewayResolver::instance().resolve(gateways);
+    m_fromCachedConfig = true;
+
+    if (cached.isStale()) {
+        m_revalidationPortal = portalAddress;
+        revalidatePortalConfig();
+    } else {
+        scheduleRevalidation(portalAddress);
+    }
+
+    const GPGateway preferredGateway = saved.isEmpty() ? filterPreferredGateway(gateways, cached.region) : gateways.first();
+    continueWithGateway(preferredGateway, cached.region);
+    return true;
+}
+
+void AuthenticationManager::scheduleRevalidation(const QString &portalAddress)
+{
+    const qint64 seconds = SettingsManager::instance().cachedPortalConfig(portalAddress).secondsToStale();
+
+    m_revalidationPortal = portalAddress;
+    m_refreshTimer->start(int(qBound(MIN_REFRESH_DELAY_S, seconds, MAX_REFRESH_DELAY_S) * 1000));
+}
+
+void AuthenticationManager::revalidatePortalConfig()
+{
+    if (m_revalidationAuth || m_revalidationPortal.isEmpty()) {
+        return;
+    }
+
+    LOGI << "Revalidating the cached configuration of the portal " << m_revalidationPortal;
+
+    m_revalidationAuth = std::make_unique<PortalAuthenticator>(
+        m_revalidationPortal,
+        settings::get("clientos", "Linux").toString()
+    );
+    m_revalidationAuth->setInteractive(false);
+
+    connect(m_revalidationAuth.get(), &PortalAuthenticator::success,
+            this, &AuthenticationManager::onPortalConfigRevalidated);
+    connect(m_revalidationAuth.get(), &PortalAuthenticator::fail,
+            this, &AuthenticationManager::onPortalConfigRevalidationFailed);
+    connect(m_revalidationAuth.get(), &PortalAuthenticator::preloginFailed,
+            this, &AuthenticationManager::onPortalConfigRevalidationFailed);
+    connect(m_revalidationAuth.get(), &PortalAuthenticator::portalConfigFailed,
+            this, &AuthenticationManager::onPortalConfigRevalidationFailed);
+
+    authenticateWithStoredCookie(m_revalidationPortal, m_revalidationAuth.get());
+}
+
+void AuthenticationManager::finishRevalidation()
+{
+    // Called from the signals of the authenticator
+    if (m_revalidationAuth) {
+        m_revalidationAuth.release()->deleteLater();
+    }
+}
+
+void AuthenticationManager::onPortalConfigRevalidated(const PortalConfigResponse &response, const QString &region)
+{
+    finishRevalidation();
+
+    const bool changed = SettingsManager::instance().setCachedPortalConfig(m_revalidationPortal, response, region);
+    storeUserAuthCookie(m_revalidationPortal, response);
+    scheduleRevalidation(m_revalidationPortal);
+
+    if (!changed) {
+        LOGI << "The configuration of the portal did not change";
+        return;
+    }
+
+    LOGI << "The configuration of the portal changed, updating the gateways";
+    if (response.allGateways().size() > 1 && !m_gatewayProber->isRunning()) {
+        m_rankingInBackground = true;
+        m_gatewayProber->probe(response.allGateways(), region);
+    } else {
+        emit gatewaysReranked(response.allGateways());
+    }
+}
+
+void AuthenticationManager::onPortalConfigRevalidationFailed(const QString &errorMessage)
+{
+    LOGI << "Could not revalidate the portal configuration: " << errorMessage;
+    finishRevalidation();
+
+    // Not used past its refresh interval, the next connect goes through the portal
+    SettingsManager &settingsManager = SettingsManager::instance();
+    if (settingsManager.cachedPortalConfig(m_revalidationPortal).isStale()) {
+        settingsManager.clearCachedPortalConfig(m_revalidationPortal);
+    }
+}
+
+void AuthenticationManager::authenticateWithStoredCookie(const QString &portalAddress, PortalAuthenticator *authenticator)
+{
+    const QString username = SettingsManager::instance().cachedPortalConfig(portalAddress).config.username();
+    if (username.isEmpty()) {
+        authenticator->authenticate();
+        return;
+    }
+
+    // Dropped with the authenticator when the attempt is reset before the keychain answers
+    SettingsManager::instance().loadUserAuthCookie(portalAddress, username).then(authenticator,
+        [this, authenticator, portalAddress, username](SettingsManager::StoredUserAuthCookie stored) {
+            if (!stored.userAuthCookie.isEmpty()) {
+                authenticator->setUserAuthCookie(username, stored.userAuthCookie);
+                connect(authenticator, &PortalAuthenticator::userAuthCookieRejected,
+                        this, &AuthenticationManager::onUserAuthCookieRejected);
+
+                m_cookiePortal = portalAddress;
+                m_cookieUser = username;
+            }
+            authenticator->authenticate();
+        });
+}
+
+void AuthenticationManager::storeUserAuthCookie(const QString &portalAddress, const PortalConfigResponse &response)
+{
+    if (response.username().isEmpty()
+        || (response.userAuthCookie().isEmpty() && response.prelogonUserAuthCookie().isEmpty())) {
+        return;
+    }
+
+    SettingsManager::instance().storeUserAuthCookie(portalAddress, response.username(),
+        response.userAuthCookie(), response.prelogonUserAuthCookie(), cookieLifetimeOf(response));
+}
+
+int AuthenticationManager::cookieLifetimeOf(const PortalConfigResponse &response)
+{
+    // The shortest cookie lifetime announced by the portal, in hours
+    int hours = 0;
+    const QMap<QString, int> lifetimes = response.cookieLifetimes();
+    for (auto it = lifetimes.cbegin(); it != lifetimes.cend(); ++it) {
+        if (it.key().contains("cookie") && it.value() > 0 && (hours == 0 || it.value() < hours)) {
+            hours = it.value();
+        }
+    }
+    return hours > 0 ? hours : DEFAULT_COOKIE_LIFETIME_HOURS;
+}
+
+void AuthenticationManager::onUserAuthCookieRejected()
+{
+    LOGI << "The saved portal cookie was rejected, removing it";
+
+    if (!m_cookiePortal.isEmpty()) {
+        SettingsManager::instance().clearUserAuthCookie(m_cookiePortal, m_cookieUser);
+    }
+    m_cookiePortal.clear();
+    m_cookieUser.clear();
+}
+
 GPGateway AuthenticationManager::filterPreferredGateway(const QList<GPGateway> &gateways, const QString &region) const
 {
     if (gateways.isEmpty()) {
@@ -2,15 +2,20 @@
 #define AUTHENTICATIONMANAGER_H
 
 #include <QObject>
-#include <QNetworkAccessManager>
 #include <QTimer>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QNetworkReply>
 #include <memory>
 #include "portalconfigresponse.h"
 #include "gatewayauthenticatorparams.h"
 #include "gpgateway.h"
+#include "phasetimeouts.h"
+#include "networkprecheck.h"
 
 class PortalAuthenticator;
 class GatewayAuthenticator;
+class GatewayProber;
 
 class AuthenticationManager : public QObject
 {
@@ -38,10 +43,17 @@ public:
     PortalConfigResponse portalConfig() const { return m_portalConfig; }
 
 public slots:
-    void authenticatePortal(const QString &portalAddress);
+    // The prelogin of expectedGateway, usually the one of the last session, is sent along with the portal authentication
+    void authenticatePortal(const QString &portalAddress, const QString &expectedGateway = QString());
+    // Without a cookie in params, the portal cookie saved for the user of cookiePortal is tried, cleared from the keychain when rejected
     void authenticateGateway(const QString &gatewayAddress, 
-                           const GatewayAuthenticatorParams &params);
+                           const GatewayAuthenticatorParams &params,
+                           const QString &cookiePortal = QString());
     void authenticateGatewayDirect(const QString &gatewayAddress);
+    // Logs in to another gateway while the tunnel of the last login is up, false if another authentication is running
+    bool reauthenticateGateway(const QString &gatewayAddress,
+                               const GatewayAuthenticatorParams &params,
+                               const QString &cookiePortal = QString());
     void reset();
 
 signals:
@@ -50,12 +62,22 @@ signals:
     void gatewayAuthenticationSucceeded(const QString &authCookie, const QString &username);
     void authenticationFailed(const QString &errorMessage);
     void authenticationProgress(const QString &message);
+    // Something the user should know, the authentication goes on
+    void authenticationWarning(const QString &message);
+    // The gateways ranked again while the expected gateway is already being authenticated
+    void gatewaysReranked(const QList<GPGateway> &ranked);
 
 private slots:
     void onPortalAuthSuccess(const PortalConfigResponse &response, const QString &region);
     void onPortalAuthFailed(const QString &errorMessage);
     void onPortalPreloginFailed(const QString &errorMessage);
     void onPortalConfigFailed(const QString &errorMessage);
+    void onGatewaysRanked(const QList<GPGateway> &ranked);
+    void onPortalConfigRevalidated(const PortalConfigResponse &response, const QString &region);
+    void onPortalConfigRevalidationFailed(const QString &errorMessage);
+    void onUserAuthCookieRejected();
+    void onInteractionStarted();
+    void onPrecheckFinished(NetworkPrecheck::Reachability reachability, const QString &message);
     
     void onGatewayAuthSuccess(const QString &authCookie);
     void onGatewayAuthFailed(const QString &errorMessage);
@@ -63,6 +85,24 @@ private slots:
 private:
     void setState(AuthState newState);
     void cleanupCurrentAuth();
+    // Once the network precheck let it go on
+    void startPortalAuth(const QString &portalAddress, const QString &expectedGateway);
+    void continueWithGateway(const GPGateway &gateway, const QString &region);
+    void startGatewayAuth(const QString &gatewayAddress, const GatewayAuthenticatorParams &params);
+    // Arms the timeout with the deadline of the phase on the server, see PhaseTimeouts
+    void startPhase(PhaseTimeouts::Phase phase, const QString &address);
+    void finishPhase();
+    void startSpeculativePrelogin(const QString &gatewayAddress);
+    void dropSpeculativePrelogin();
+    void preconnectGateways(const QList<GPGateway> &ranked);
+    bool authenticateFromCache(const QString &portalAddress);
+    void revalidatePortalConfig();
+    void scheduleRevalidation(const QString &portalAddress);
+    void finishRevalidation();
+    // Starts the authenticator once the saved portal cookie is read from the keychain
+    void authenticateWithStoredCookie(const QString &portalAddress, PortalAuthenticator *authenticator);
+    void storeUserAuthCookie(const QString &portalAddress, const PortalConfigResponse &response);
+    static int cookieLifetimeOf(const PortalConfigResponse &response);
     GPGateway filterPreferredGateway(const QList<GPGateway> &gateways, const QString &region) const;
 
     AuthState m_currentState;
@@ -71,17 +111,54 @@ private:
     QString m_authCookie;
     QString m_username;
     PortalConfigResponse m_portalConfig;
+    // The region of the portal while the gateways are probed
+    QString m_portalRegion;
     
     // Current authenticators
     std::unique_ptr<PortalAuthenticator> m_portalAuth;
     std::unique_ptr<GatewayAuthenticator> m_gatewayAuth;
-    
-    // Network manager for requests
-    std::unique_ptr<QNetworkAccessManager> m_networkManager;
+
+    // Ranks the gateways of the portal
+    GatewayProber *m_gatewayProber;
+    // Tells an offline network or a captive portal apart before the portal times out
+    NetworkPrecheck *m_precheck;
+    QString m_expectedGateway;
+    // Set when the ranking only reorders the gateways, the gateway being already chosen
+    bool m_rankingInBackground { false };
+
+    // The gateway prelogin sent while the portal is authenticated
+    QString m_speculativeGateway;
+    QPointer<QNetworkReply> m_speculativePrelogin;
+
+    // Set when the gateway was chosen from the cached portal configuration
+    bool m_fromCachedConfig { false };
+    // Fetches the portal configuration again without interaction, see revalidatePortalConfig()
+    std::unique_ptr<PortalAuthenticator> m_revalidationAuth;
+    QString m_revalidationPortal;
+
+    // Whose saved portal cookie is being tried
+    QString m_cookiePortal;
+    QString m_cookieUser;
+    // Counts the resets, a saved cookie read for an earlier attempt is dropped
+    quint64 m_gatewayAttempt { 0 };
+    static constexpr int DEFAULT_COOKIE_LIFETIME_HOURS = 24;
+
+    // The best ranked gateways connected ahead, the chosen one and the next candidates
+    static constexpr int PRECONNECT_GATEWAYS = 2;
     
     // Timeout management
     QTimer *m_timeoutTimer;
+    // While a login window is shown
     static constexpr int AUTH_TIMEOUT_MS = 60000; // 60 seconds
+    PhaseTimeouts::Phase m_phase { PhaseTimeouts::Phase::PortalAuth };
+    QString m_phaseAddress;
+    QElapsedTimer m_phaseTimer;
+    bool m_phaseInteractive { false };
+
+    // Fires when the cached portal configuration is due for revalidation
+    QTimer *m_refreshTimer;
+    static constexpr qint64 MIN_REFRESH_DELAY_S = 60;
+    static constexpr qint64 MAX_REFRESH_DELAY_S = 7 * 24 * 3600;
 };
 
 #endif // AUTHENTICATIONMANAGER_H
\ No newline at end of file
@@ -2,10 +2,11 @@
 #include "logging.h"
 
 #include "cdpcommandmanager.h"
+#include "connectionpool.h"
 
 CDPCommandManager::CDPCommandManager(QObject *parent)
     : QObject(parent)
-    , networkManager(new QNetworkAccessManager)
+    , networkManager(ConnectionPool::instance().manager())
     , socket(new QWebSocket)
 {
     // WebSocket setup
@@ -17,7 +18,6 @@ CDPCommandManager::CDPCommandManager(QObject *parent)
 
 CDPCommandManager::~CDPCommandManager()
 {
-    delete networkManager;
     delete socket;
 }
 
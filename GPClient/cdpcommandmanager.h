@@ -25,6 +25,7 @@ signals:
     void eventReceived(QString eventName, QJsonObject params);
 
 private:
+    // Owned by ConnectionPool
     QNetworkAccessManager *networkManager;
     QWebSocket *socket;
 
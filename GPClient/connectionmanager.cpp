@@ -2,6 +2,7 @@
 #include <QStateMachine>
 #include <QTimer>
 #include "logging.h"
+#include "phasetimeouts.h"
 #include "vpn_dbus.h"
 #include "vpn_json.h"
 
@@ -13,8 +14,8 @@ ConnectionManager::ConnectionManager(std::shared_ptr<IVpn> vpn, QObject *parent)
     , m_isSwitchingGateway(false)
     , m_stateMachine(std::make_unique<QStateMachine>(this))
 {
+    // The deadline of each connect is learned from the gateway, see PhaseTimeouts
     m_connectionTimer->setSingleShot(true);
-    m_connectionTimer->setInterval(30000); // 30 second timeout
     connect(m_connectionTimer, &QTimer::timeout, this, &ConnectionManager::onConnectionTimeout);
 
     setupStateMachine();
@@ -25,11 +26,17 @@ ConnectionManager::ConnectionManager(std::shared_ptr<IVpn> vpn, QObject *parent)
             connect(vpnDbus.get(), &VpnDbus::connected, this, &ConnectionManager::onVpnConnected);
             connect(vpnDbus.get(), &VpnDbus::disconnected, this, &ConnectionManager::onVpnDisconnected);
             connect(vpnDbus.get(), &VpnDbus::error, this, &ConnectionManager::onVpnError);
+            connect(vpnDbus.get(), &VpnDbus::switched, this, &ConnectionManager::onVpnSwitched);
+            connect(vpnDbus.get(), &VpnDbus::switchFailed, this, &ConnectionManager::onVpnSwitchFailed);
+            connect(vpnDbus.get(), &VpnDbus::failingOver, this, &ConnectionManager::onVpnFailingOver);
+            connect(vpnDbus.get(), &VpnDbus::authRequired, this, &ConnectionManager::onVpnAuthRequired);
             connect(vpnDbus.get(), &VpnDbus::logAvailable, this, &ConnectionManager::onVpnLogAvailable);
         } else if (auto vpnJson = std::dynamic_pointer_cast<VpnJson>(m_vpn)) {
             connect(vpnJson.get(), &VpnJson::connected, this, &ConnectionManager::onVpnConnected);
             connect(vpnJson.get(), &VpnJson::disconnected, this, &ConnectionManager::onVpnDisconnected);
             connect(vpnJson.get(), &VpnJson::error, this, &ConnectionManager::onVpnError);
+            connect(vpnJson.get(), &VpnJson::switched, this, &ConnectionManager::onVpnSwitched);
+            connect(vpnJson.get(), &VpnJson::switchFailed, this, &ConnectionManager::onVpnSwitchFailed);
             connect(vpnJson.get(), &VpnJson::logAvailable, this, &ConnectionManager::onVpnLogAvailable);
         }
     }
@@ -53,6 +60,8 @@ void ConnectionManager::setupStateMachine()
     m_disconnectedState->addTransition(this, &ConnectionManager::requestConnect, m_connectingState);
     m_connectingState->addTransition(this, &ConnectionManager::connected, m_connectedState);
     m_connectingState->addTransition(this, &ConnectionManager::error, m_errorState);
+    // The service gave up the setup, e.g. to retry with another login
+    m_connectingState->addTransition(this, &ConnectionManager::disconnected, m_disconnectedState);
     m_connectedState->addTransition(this, &ConnectionManager::requestDisconnect, m_disconnectingState);
     m_connectedState->addTransition(this, &ConnectionManager::error, m_errorState);
     m_disconnectingState->addTransition(this, &ConnectionManager::disconnected, m_disconnectedState);
@@ -104,7 +113,10 @@ void ConnectionManager::connectToVPN(const QString &gatewayAddress, const QStrin
 
     LOGI << "Connecting to VPN gateway: " << gatewayAddress;
     emit requestConnect();  // Trigger state machine transition
-    m_connectionTimer->start();
+    m_connectAddress = gatewayAddress;
+    m_connectElapsed.start();
+    m_connectionTimer->start(PhaseTimeouts::instance().timeoutMs(PhaseTimeouts::Phase::Tunnel, gatewayAddress));
+    m_tunnelSpan = Tracer::begin("client.tunnel");
     
     try {
         m_vpn->connect(gatewayAddress, allGateways, username, authCookie);
@@ -112,6 +124,8 @@ void ConnectionManager::connectToVPN(const QString &gatewayAddress, const QStrin
         m_connectionTimer->stop();
         QString errorMsg = QString("Failed to connect: %1").arg(e.what());
         LOGE << errorMsg;
+        Tracer::end(m_tunnelSpan, errorMsg);
+        m_tunnelSpan = 0;
         emit error(errorMsg);
     }
 }
@@ -150,20 +164,38 @@ void ConnectionManager::switchGateway(const GPGateway &newGateway)
         return;
     }
 
+    if (m_currentState != ConnectionState::Connected) {
+        setCurrentGateway(newGateway);
+        return;
+    }
+
     LOGI << "Switching gateway from " << m_currentGateway.name() << " to " << newGateway.name();
-    
+
+    // The tunnel stays up, the switch goes on with completeGatewaySwitch() once the new gateway is authenticated
     m_isSwitchingGateway = true;
+    m_previousGateway = m_currentGateway;
     setCurrentGateway(newGateway);
-    
-    if (m_currentState == ConnectionState::Connected) {
-        disconnectFromVPN();
+}
+
+void ConnectionManager::completeGatewaySwitch(const QString &username, const QString &authCookie)
+{
+    if (!m_vpn || !m_isSwitchingGateway) {
+        return;
     }
+
+    LOGI << "Bringing up the tunnel to " << m_currentGateway.address() << " next to the current one";
+    m_vpn->switchGateway(m_currentGateway.address(), username, authCookie);
 }
 
 void ConnectionManager::onVpnConnected()
 {
+    if (m_connectionTimer->isActive()) {
+        PhaseTimeouts::instance().recordSuccess(PhaseTimeouts::Phase::Tunnel, m_connectAddress, m_connectElapsed.elapsed());
+    }
     m_connectionTimer->stop();
     m_lastError.clear();
+    Tracer::end(m_tunnelSpan);
+    m_tunnelSpan = 0;
     
     if (m_isSwitchingGateway) {
         m_isSwitchingGateway = false;
@@ -177,11 +209,8 @@ void ConnectionManager::onVpnDisconnected()
 {
     m_connectionTimer->stop();
     
-    if (m_isSwitchingGateway) {
-        // If we were switching gateways, attempt to reconnect to the new one
-        // This would need to be handled by the caller with stored auth info
-        m_isSwitchingGateway = false;
-    }
+    // The tunnel went down in the middle of a switch, there is nothing left to switch
+    m_isSwitchingGateway = false;
     
     emit disconnected();
 }
@@ -191,9 +220,77 @@ void ConnectionManager::onVpnError(const QString &errorMessage)
     m_connectionTimer->stop();
     m_lastError = errorMessage;
     LOGE << "VPN Error: " << errorMessage;
+    Tracer::end(m_tunnelSpan, errorMessage);
+    m_tunnelSpan = 0;
     emit error(errorMessage);
 }
 
+void ConnectionManager::onVpnSwitched(const QString &server)
+{
+    LOGI << "Gateway switched to: " << server;
+    m_isSwitchingGateway = false;
+    emit gatewaySwitched(m_currentGateway);
+}
+
+void ConnectionManager::onVpnSwitchFailed(const QString &errorMessage)
+{
+    abortGatewaySwitch(errorMessage);
+}
+
+void ConnectionManager::onVpnFailingOver(const QString &server)
+{
+    LOGW << "Gateway " << m_connectAddress << " could not be set up, the service is trying " << server;
+
+    // The deadline starts over with the gateway now being set up
+    if (m_connectionTimer->isActive()) {
+        m_connectAddress = server;
+        m_connectElapsed.start();
+        m_connectionTimer->start(PhaseTimeouts::instance().timeoutMs(PhaseTimeouts::Phase::Tunnel, server));
+    }
+
+    for (const GPGateway &gateway : std::as_const(m_gateways)) {
+        if (gateway.address() == server) {
+            setCurrentGateway(gateway);
+            emit gatewayFailedOver(gateway);
+            return;
+        }
+    }
+}
+
+void ConnectionManager::onVpnAuthRequired(const QString &server)
+{
+    LOGW << "Gateway " << server << " rejected the cookie it was failed over with";
+
+    // The connect is over, the retry is timed on its own
+    m_connectionTimer->stop();
+    Tracer::end(m_tunnelSpan, "authentication required");
+    m_tunnelSpan = 0;
+
+    for (const GPGateway &gateway : std::as_const(m_gateways)) {
+        if (gateway.address() == server) {
+            setCurrentGateway(gateway);
+            emit gatewayAuthRequired(gateway);
+            return;
+        }
+    }
+
+    emit error(QString("The gateway %1 requires a login").arg(server));
+}
+
+void ConnectionManager::abortGatewaySwitch(const QString &errorMessage)
+{
+    if (!m_isSwitchingGateway) {
+        return;
+    }
+
+    LOGE << "Gateway switch failed: " << errorMessage;
+    m_isSwitchingGateway = false;
+
+    // Still connected to the previous gateway
+    setCurrentGateway(m_previousGateway);
+    emit gatewaySwitchFailed(m_previousGateway, errorMessage);
+}
+
 void ConnectionManager::onVpnLogAvailable(const QString &log)
 {
     emit logAvailable(log);
@@ -202,6 +299,9 @@ void ConnectionManager::onVpnLogAvailable(const QString &log)
 void ConnectionManager::onConnectionTimeout()
 {
     LOGE << "Connection timeout occurred";
+    PhaseTimeouts::instance().recordTimeout(PhaseTimeouts::Phase::Tunnel, m_connectAddress, m_connectionTimer->interval());
+    Tracer::end(m_tunnelSpan, "timeout");
+    m_tunnelSpan = 0;
     if (m_vpn) {
         m_vpn->disconnect();
     }
@@ -3,12 +3,14 @@
 
 #include <QObject>
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QStateMachine>
 #include <QState>
 #include <memory>
 #include "vpn.h"
 #include "gpgateway.h"
 #include "portalconfigresponse.h"
+#include "tracer.h"
 
 class ConnectionManager : public QObject
 {
@@ -29,6 +31,7 @@ public:
 
     ConnectionState currentState() const { return m_currentState; }
     bool isConnected() const { return m_currentState == ConnectionState::Connected; }
+    bool isSwitchingGateway() const { return m_isSwitchingGateway; }
     
     void setGateways(const QList<GPGateway> &gateways);
     void setCurrentGateway(const GPGateway &gateway);
@@ -40,6 +43,9 @@ public slots:
                      const QString &username, const QString &authCookie);
     void disconnectFromVPN();
     void switchGateway(const GPGateway &newGateway);
+    // Called with the cookie of the new gateway, the running tunnel is kept until the new one is up
+    void completeGatewaySwitch(const QString &username, const QString &authCookie);
+    void abortGatewaySwitch(const QString &errorMessage);
 
 signals:
     void stateChanged(ConnectionState newState);
@@ -48,6 +54,11 @@ signals:
     void error(const QString &errorMessage);
     void logAvailable(const QString &log);
     void gatewaySwitched(const GPGateway &newGateway);
+    void gatewaySwitchFailed(const GPGateway &previousGateway, const QString &errorMessage);
+    // The service went on with another gateway of the portal while connecting
+    void gatewayFailedOver(const GPGateway &gateway);
+    // The gateway failed over to rejected the cookie, the connect is to be retried with a login to it
+    void gatewayAuthRequired(const GPGateway &gateway);
     
     // State machine transition triggers
     void requestConnect();
@@ -57,6 +68,10 @@ private slots:
     void onVpnConnected();
     void onVpnDisconnected();
     void onVpnError(const QString &errorMessage);
+    void onVpnSwitched(const QString &server);
+    void onVpnSwitchFailed(const QString &errorMessage);
+    void onVpnFailingOver(const QString &server);
+    void onVpnAuthRequired(const QString &server);
     void onVpnLogAvailable(const QString &log);
     void onConnectionTimeout();
 
@@ -67,10 +82,16 @@ private:
     std::shared_ptr<IVpn> m_vpn;
     ConnectionState m_currentState;
     GPGateway m_currentGateway;
+    GPGateway m_previousGateway;
     QList<GPGateway> m_gateways;
     QTimer *m_connectionTimer;
+    // The gateway and start of the connect being timed
+    QString m_connectAddress;
+    QElapsedTimer m_connectElapsed;
     bool m_isSwitchingGateway;
     QString m_lastError;
+    // From the connect request to the tunnel being up
+    Tracer::SpanId m_tunnelSpan { 0 };
     
     // State machine for connection management
     std::unique_ptr<QStateMachine> m_stateMachine;
@@ -0,0 +1,171 @@
+#include "connectionpool.h"
+#include <QCoreApplication>
+#include <QSslSocket>
+#include <QStandardPaths>
+#include <QUrl>
+#include <memory>
+#include "logging.h"
+#include "tracer.h"
+#include "taskexecutor.h"
+
+ConnectionPool& ConnectionPool::instance()
+{
+    // Parented to the application, created after it
+    static ConnectionPool *instance = new ConnectionPool(qApp);
+    return *instance;
+}
+
+ConnectionPool::ConnectionPool(QObject *parent)
+    : QObject(parent)
+    , m_manager(new QNetworkAccessManager(this))
+    , m_sessions(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/tls-sessions")
+    , m_saveTimer(new QTimer(this))
+{
+    // The key is read from the keychain, off the GUI thread
+    const QString path = m_sessions.path();
+    TaskExecutor::instance().runIo([path]() {
+        TlsSessionCache loaded(path);
+        loaded.load();
+        return loaded;
+    }).then(this, [this](TlsSessionCache loaded) {
+        m_sessions.merge(loaded);
+    });
+
+    m_saveTimer->setSingleShot(true);
+    m_saveTimer->setInterval(2000);
+    connect(m_saveTimer, &QTimer::timeout, this, &ConnectionPool::saveSessions);
+    connect(qApp, &QCoreApplication::aboutToQuit, this, [this]() {
+        // Written before exit, see TaskExecutor::waitForDone()
+        if (m_saveTimer->isActive()) {
+            m_saveTimer->stop();
+            saveSessions();
+        }
+        LOGI << "TLS handshakes: " << m_resumedHandshakes << " resumed, " << m_fullHandshakes << " full";
+    });
+}
+
+void ConnectionPool::saveSessions()
+{
+    TaskExecutor::instance().runIo([sessions = m_sessions]() mutable {
+        sessions.save();
+    });
+}
+
+QSslConfiguration ConnectionPool::sslConfiguration(const QString &host) const
+{
+    QSslConfiguration conf = QSslConfiguration::defaultConfiguration();
+
+    // Skip the ssl verifying
+    conf.setPeerVerifyMode(QSslSocket::VerifyNone);
+    conf.setSslOption(QSsl::SslOptionDisableLegacyRenegotiation, false);
+    // The manager keeps the TLS sessions, a new connection to the same server resumes them
+    conf.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+
+    if (!host.isEmpty()) {
+        conf.setSessionTicket(m_sessions.ticket(host));
+    }
+
+    return conf;
+}
+
+QNetworkReply *ConnectionPool::post(const QNetworkRequest &request, const QByteArray &data)
+{
+    QNetworkReply *reply = m_manager->post(request, data);
+    instrument(reply);
+    return reply;
+}
+
+void ConnectionPool::preconnect(const QString &address)
+{
+    const QUrl url("https://" + address);
+    if (!url.isValid() || url.host().isEmpty()) {
+        return;
+    }
+
+    const QString key = url.host() + ":" + QString::number(url.port(443));
+    auto it = m_preconnected.find(key);
+    if (it != m_preconnected.end() && it->elapsed() < PRECONNECT_TTL_MS) {
+        return;
+    }
+
+    LOGI << "Preconnecting to " << key;
+    m_manager->connectToHostEncrypted(url.host(), quint16(url.port(443)), sslConfiguration(url.host()));
+
+    QElapsedTimer timer;
+    timer.start();
+    m_preconnected.insert(key, timer);
+}
+
+void ConnectionPool::instrument(QNetworkReply *reply)
+{
+    auto timing = std::make_shared<Timing>();
+    timing->timer.start();
+    const bool offeredSession = !reply->request().sslConfiguration().sessionTicket().isEmpty();
+
+    // Not emitted when the request goes over a connection already open
+    connect(reply, &QNetworkReply::socketStartedConnecting, this, [timing]() {
+        if (timing->connectStartMs < 0) {
+            timing->connectStartMs = timing->timer.elapsed();
+        }
+    });
+    // Emitted when the request opened a new connection
+    connect(reply, &QNetworkReply::encrypted, this, [this, reply, timing, offeredSession]() {
+        timing->connectedMs = timing->timer.elapsed();
+        onEncrypted(reply, offeredSession);
+    });
+    connect(reply, &QNetworkReply::requestSent, this, [timing]() {
+        timing->requestSentMs = timing->timer.elapsed();
+    });
+    connect(reply, &QNetworkReply::metaDataChanged, this, [timing]() {
+        if (timing->firstByteMs < 0) {
+            timing->firstByteMs = timing->timer.elapsed();
+        }
+    });
+    connect(reply, &QNetworkReply::finished, this, [this, reply, timing]() {
+        report(reply, *timing);
+        keepSession(reply);
+    });
+}
+
+void ConnectionPool::onEncrypted(QNetworkReply *reply, bool offeredSession)
+{
+    // OpenSSL gives no certificate chain for a resumed session, the peer sends none then
+    const QSslConfiguration conf = reply->sslConfiguration();
+    const bool resumed = offeredSession && conf.peerCertificateChain().isEmpty() && !conf.peerCertificate().isNull();
+
+    if (resumed) {
+        ++m_resumedHandshakes;
+    } else {
+        ++m_fullHandshakes;
+    }
+
+    LOGI << "TLS handshake with " << reply->url().host() << ": " << (resumed ? "resumed" : "full")
+         << " (" << m_resumedHandshakes << " resumed, " << m_fullHandshakes << " full so far)";
+    Tracer::instant("tls.handshake", reply->url().host() + (resumed ? " resumed" : " full"));
+}
+
+void ConnectionPool::keepSession(QNetworkReply *reply)
+{
+    const QSslConfiguration conf = reply->sslConfiguration();
+    if (m_sessions.store(reply->url().host(), conf.sessionTicket(), conf.sessionTicketLifeTimeHint())) {
+        m_saveTimer->start();
+    }
+}
+
+void ConnectionPool::report(QNetworkReply *reply, const Timing &timing)
+{
+    const qint64 total = timing.timer.elapsed();
+    // QNetworkReply does not tell the host lookup from the TCP connect, they are reported together
+    const bool reused = timing.connectStartMs < 0;
+    const qint64 handshake = (timing.connectedMs >= 0 && timing.connectStartMs >= 0) ? timing.connectedMs - timing.connectStartMs : -1;
+    const qint64 firstByte = (timing.firstByteMs >= 0 && timing.requestSentMs >= 0) ? timing.firstByteMs - timing.requestSentMs : -1;
+
+    const QString detail = reused
+        ? QString("%1 reused connection, ttfb %2 ms, total %3 ms")
+              .arg(reply->url().path()).arg(firstByte).arg(total)
+        : QString("%1 queued %2 ms, lookup+connect+tls %3 ms, ttfb %4 ms, total %5 ms")
+              .arg(reply->url().path()).arg(timing.connectStartMs).arg(handshake).arg(firstByte).arg(total);
+
+    LOGI << "Request to " << reply->url().host() << ": " << detail;
+    Tracer::instant("http.request", reply->url().host() + detail);
+}
@@ -0,0 +1,86 @@
+#ifndef CONNECTIONPOOL_H
+#define CONNECTIONPOOL_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QSslConfiguration>
+#include <QTimer>
+#include "tlssessioncache.h"
+
+/*
+ * The network access manager of every portal and gateway request.
+ *
+ * Sharing one manager keeps the TLS connections open from the prelogin to
+ * getconfig.esp and login.esp, and the TLS sessions for the connections
+ * opened afterwards. preconnect() opens the connection to a server before
+ * the first request, while the user is still typing or the gateway is
+ * being chosen.
+ *
+ * The TLS sessions are saved across launches (see TlsSessionCache), the
+ * first connection to a server after a restart resumes its session. The
+ * resumptions and full handshakes are counted. They are loaded and saved off
+ * the GUI thread (see TaskExecutor), the connections opened before the load
+ * finished run a full handshake.
+ *
+ * Each request is timed and logged: host lookup with connect and TLS
+ * handshake when a connection is opened, time to the first byte of the
+ * response and total.
+ */
+class ConnectionPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    static ConnectionPool& instance();
+
+    QNetworkAccessManager *manager() { return m_manager; }
+    // The configuration of the requests to the host, with its saved TLS session
+    QSslConfiguration sslConfiguration(const QString &host = QString()) const;
+
+    int resumedHandshakes() const { return m_resumedHandshakes; }
+    int fullHandshakes() const { return m_fullHandshakes; }
+
+    QNetworkReply *post(const QNetworkRequest &request, const QByteArray &data);
+    // Opens a TLS connection to the address (host or host:port), once in PRECONNECT_TTL_MS
+    void preconnect(const QString &address);
+
+private:
+    explicit ConnectionPool(QObject *parent = nullptr);
+    ~ConnectionPool() = default;
+
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    struct Timing {
+        QElapsedTimer timer;
+        qint64 connectStartMs { -1 };
+        qint64 connectedMs { -1 };
+        qint64 requestSentMs { -1 };
+        qint64 firstByteMs { -1 };
+    };
+
+    void instrument(QNetworkReply *reply);
+    void report(QNetworkReply *reply, const Timing &timing);
+    void onEncrypted(QNetworkReply *reply, bool offeredSession);
+    void keepSession(QNetworkReply *reply);
+    // Encrypts and writes a copy of the sessions off the GUI thread
+    void saveSessions();
+
+    // About the time QNetworkAccessManager keeps an idle connection
+    static constexpr int PRECONNECT_TTL_MS = 30000;
+
+    QNetworkAccessManager *m_manager;
+    QHash<QString, QElapsedTimer> m_preconnected;
+
+    TlsSessionCache m_sessions;
+    // Writes the sessions once they stop changing
+    QTimer *m_saveTimer;
+    int m_resumedHandshakes { 0 };
+    int m_fullHandshakes { 0 };
+};
+
+#endif // CONNECTIONPOOL_H
@@ -15,12 +15,25 @@ GatewayAuthenticator::GatewayAuthenticator(const QString& gateway, GatewayAuthen
     : QObject()
     , gateway(gateway)
     , params(params)
-    , preloginUrl("https://" + gateway + "/ssl-vpn/prelogin.esp?tmp=tmp&kerberos-support=yes&ipv6-support=yes&clientVer=4100")
+    , preloginUrl(preloginUrlOf(gateway, params.clientos()))
     , loginUrl("https://" + gateway + "/ssl-vpn/login.esp")
 {
-    if (!params.clientos().isEmpty()) {
-        preloginUrl = preloginUrl + "&clientos=" + params.clientos();
+}
+
+QString GatewayAuthenticator::preloginUrlOf(const QString &gateway, const QString &clientos)
+{
+    QString url = "https://" + gateway + "/ssl-vpn/prelogin.esp?tmp=tmp&kerberos-support=yes&ipv6-support=yes&clientVer=4100";
+    if (!clientos.isEmpty()) {
+        url = url + "&clientos=" + clientos;
     }
+    return url;
+}
+
+void GatewayAuthenticator::setPrelogin(QNetworkReply *reply)
+{
+    // Owned from now on, dropped with the authenticator when not needed
+    reply->setParent(this);
+    speculativePrelogin = reply;
 }
 
 void GatewayAuthenticator::authenticate()
@@ -31,15 +44,20 @@ void GatewayAuthenticator::authenticate()
     loginParams.setUser(params.username());
     loginParams.setPassword(params.password());
     loginParams.setUserAuthCookie(params.userAuthCookie());
+    loginParams.setPrelogonAuthCookie(params.prelogonUserAuthCookie());
     loginParams.setInputStr(params.inputStr());
 
+    isCookieLogin = !params.userAuthCookie().isEmpty() || !params.prelogonUserAuthCookie().isEmpty();
+
     login(loginParams);
 }
 
 void GatewayAuthenticator::login(const LoginParams &loginParams)
 {
-    LOGI << QString("Trying to login the gateway at %1, with %2").arg(loginUrl).arg(QString(loginParams.toUtf8()));
+    // Not the parameters, they carry the password or the cookies
+    LOGI << "Trying to login the gateway at " << loginUrl;
 
+    loginSpan = Tracer::begin("gateway.login");
     auto *reply = createRequest(loginUrl, loginParams.toUtf8());
     connect(reply, &QNetworkReply::finished, this, &GatewayAuthenticator::onLoginFinished);
 }
@@ -48,10 +66,19 @@ void GatewayAuthenticator::onLoginFinished()
 {
     QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
     QByteArray response = reply->readAll();
+    Tracer::end(loginSpan, reply->errorString());
+    loginSpan = 0;
 
     if (reply->error() || response.contains("Authentication failure")) {
         LOGE << QString("Failed to login the gateway at %1, %2").arg(loginUrl, reply->errorString());
 
+        if (isCookieLogin) {
+            isCookieLogin = false;
+            params.setUserAuthCookie("");
+            params.setPrelogonUserAuthCookie("");
+            emit userAuthCookieRejected();
+        }
+
         if (standardLoginWindow) {
             standardLoginWindow->setProcessing(false);
             openMessageBox("Gateway login failed.", "Please check your credentials and try again.");
@@ -80,13 +107,40 @@ void GatewayAuthenticator::doAuth()
 {
     LOGI << "Perform the gateway prelogin at " << preloginUrl;
 
-    auto *reply = createRequest(preloginUrl);
+    preloginSpan = Tracer::begin("gateway.prelogin");
+
+    QNetworkReply *reply = speculativePrelogin;
+    speculativePrelogin = nullptr;
+
+    // A speculative request that failed may have failed for another reason than this gateway, send it again
+    if (reply && reply->isFinished() && reply->error()) {
+        reply->deleteLater();
+        reply = nullptr;
+    }
+
+    if (reply) {
+        LOGI << "Using the prelogin sent ahead of the portal configuration";
+        if (reply->isFinished()) {
+            preloginFinished(reply);
+        } else {
+            connect(reply, &QNetworkReply::finished, this, &GatewayAuthenticator::onPreloginFinished);
+        }
+        return;
+    }
+
+    reply = createRequest(preloginUrl);
     connect(reply, &QNetworkReply::finished, this, &GatewayAuthenticator::onPreloginFinished);
 }
 
 void GatewayAuthenticator::onPreloginFinished()
 {
-    auto *reply = qobject_cast<QNetworkReply*>(sender());
+    preloginFinished(qobject_cast<QNetworkReply*>(sender()));
+}
+
+void GatewayAuthenticator::preloginFinished(QNetworkReply *reply)
+{
+    Tracer::end(preloginSpan, reply->errorString());
+    preloginSpan = 0;
 
     if (reply->error()) {
         LOGE << QString("Failed to prelogin the gateway at %1, %2").arg(preloginUrl, reply->errorString());
@@ -122,6 +176,7 @@ void GatewayAuthenticator::normalAuth(QString labelUsername, QString labelPasswo
     connect(standardLoginWindow, &StandardLoginWindow::rejected, this, &GatewayAuthenticator::onLoginWindowRejected);
     connect(standardLoginWindow, &StandardLoginWindow::finished, this, &GatewayAuthenticator::onLoginWindowFinished);
 
+    emit interactionStarted();
     standardLoginWindow->show();
 }
 
@@ -166,15 +221,16 @@ void GatewayAuthenticator::samlAuth(QString samlMethod, QString samlRequest, QSt
         loginWindow->deleteLater();
     });
 
+    emit interactionStarted();
     loginWindow->login(samlMethod, samlRequest, preloginUrl);
 }
 
 void GatewayAuthenticator::onSAMLLoginSuccess(const QMap<QString, QString> &samlResult)
 {
     if (samlResult.contains("preloginCookie")) {
-        LOGI << "SAML login succeeded, got the prelogin-cookie " << samlResult.value("preloginCookie");
+        LOGI << "SAML login succeeded, got the prelogin-cookie";
     } else {
-        LOGI << "SAML login succeeded, got the portal-userauthcookie " << samlResult.value("userAuthCookie");
+        LOGI << "SAML login succeeded, got the portal-userauthcookie";
     }
 
     LoginParams loginParams { params.clientos() };
@@ -222,5 +278,6 @@ void GatewayAuthenticator::showChallenge(const QString &responseText)
         challengeDialog = nullptr;
     });
 
+    emit interactionStarted();
     challengeDialog->show();
 }
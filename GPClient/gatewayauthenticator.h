@@ -2,11 +2,14 @@
 #define GATEWAYAUTHENTICATOR_H
 
 #include <QtCore/QObject>
+#include <QtCore/QPointer>
+#include <QtNetwork/QNetworkReply>
 
 #include "standardloginwindow.h"
 #include "challengedialog.h"
 #include "loginparams.h"
 #include "gatewayauthenticatorparams.h"
+#include "tracer.h"
 
 class GatewayAuthenticator : public QObject
 {
@@ -14,11 +17,19 @@ class GatewayAuthenticator : public QObject
 public:
     explicit GatewayAuthenticator(const QString &gateway, GatewayAuthenticatorParams params);
 
+    static QString preloginUrlOf(const QString &gateway, const QString &clientos);
+
     void authenticate();
+    // A prelogin request already sent to preloginUrlOf() of this gateway, used instead of sending one
+    void setPrelogin(QNetworkReply *reply);
 
 signals:
     void success(const QString &authCookie);
     void fail(const QString &msg = "");
+    // The gateway did not accept the portal cookie, the authentication goes on with a login
+    void userAuthCookieRejected();
+    // A login window or challenge is shown, the time of the user is not a network delay
+    void interactionStarted();
 
 private slots:
     void onLoginFinished();
@@ -34,11 +45,17 @@ private:
     GatewayAuthenticatorParams params;
     QString preloginUrl;
     QString loginUrl;
+    QPointer<QNetworkReply> speculativePrelogin;
+    bool isCookieLogin { false };
 
     StandardLoginWindow *standardLoginWindow { nullptr };
     ChallengeDialog *challengeDialog { nullptr };
 
+    Tracer::SpanId loginSpan { 0 };
+    Tracer::SpanId preloginSpan { 0 };
+
     void login(const LoginParams& loginParams);
+    void preloginFinished(QNetworkReply *reply);
     void doAuth();
     void normalAuth(QString labelUsername, QString labelPassword, QString authMessage);
     void samlAuth(QString samlMethod, QString samlRequest, QString preloginUrl = "");
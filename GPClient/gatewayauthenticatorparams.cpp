@@ -11,6 +11,7 @@ GatewayAuthenticatorParams GatewayAuthenticatorParams::fromPortalConfigResponse(
     params.setUsername(portalConfig.username());
     params.setPassword(portalConfig.password());
     params.setUserAuthCookie(portalConfig.userAuthCookie());
+    params.setPrelogonUserAuthCookie(portalConfig.prelogonUserAuthCookie());
 
     return params;
 }
@@ -45,6 +46,16 @@ void GatewayAuthenticatorParams::setUserAuthCookie(const QString &newUserAuthCoo
     m_userAuthCookie = newUserAuthCookie;
 }
 
+const QString &GatewayAuthenticatorParams::prelogonUserAuthCookie() const
+{
+    return m_prelogonUserAuthCookie;
+}
+
+void GatewayAuthenticatorParams::setPrelogonUserAuthCookie(const QString &newPrelogonUserAuthCookie)
+{
+    m_prelogonUserAuthCookie = newPrelogonUserAuthCookie;
+}
+
 const QString &GatewayAuthenticatorParams::clientos() const
 {
     return m_clientos;
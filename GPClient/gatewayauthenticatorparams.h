@@ -21,6 +21,9 @@ public:
     const QString &userAuthCookie() const;
     void setUserAuthCookie(const QString &newUserAuthCookie);
 
+    const QString &prelogonUserAuthCookie() const;
+    void setPrelogonUserAuthCookie(const QString &newPrelogonUserAuthCookie);
+
     const QString &clientos() const;
     void setClientos(const QString &newClientos);
 
@@ -31,6 +34,7 @@ private:
     QString m_username;
     QString m_password;
     QString m_userAuthCookie;
+    QString m_prelogonUserAuthCookie;
     QString m_clientos;
     QString m_inputStr;
 };
@@ -0,0 +1,220 @@
+#include "gatewayprober.h"
+#include <QNetworkReply>
+#include <QSslConfiguration>
+#include <QSslSocket>
+#include <QUrl>
+#include <algorithm>
+#include "gphelper.h"
+#include "logging.h"
+
+using namespace gpclient::helper;
+
+GatewayProber::GatewayProber(QObject *parent)
+    : QObject(parent)
+    , m_deadline(new QTimer(this))
+{
+    m_deadline->setSingleShot(true);
+    m_deadline->setInterval(PROBE_DEADLINE_MS);
+    connect(m_deadline, &QTimer::timeout, this, [this]() {
+        LOGI << "Gateway probe deadline reached";
+        finish();
+    });
+}
+
+GatewayProber::~GatewayProber()
+{
+    abort();
+}
+
+void GatewayProber::probe(const QList<GPGateway> &gateways, const QString &ruleName)
+{
+    abort();
+
+    LOGI << "Probing " << gateways.size() << " gateway(s), rule: " << ruleName;
+    m_ruleName = ruleName;
+    m_probeSpan = Tracer::begin("gateway.probe");
+
+    for (const auto &gateway : gateways) {
+        Probe probe;
+        probe.gateway = gateway;
+        m_probes.append(probe);
+    }
+
+    // The list is not resized until the next probe, the callbacks refer to the probes by index
+    m_deadline->start();
+    for (int i = 0; i < m_probes.size(); ++i) {
+        startHandshake(i);
+        startPrelogin(i);
+    }
+}
+
+void GatewayProber::abort()
+{
+    m_deadline->stop();
+    for (auto &probe : m_probes) {
+        release(probe);
+    }
+    m_probes.clear();
+}
+
+void GatewayProber::startHandshake(int index)
+{
+    Probe &probe = m_probes[index];
+    const QUrl url("https://" + probe.gateway.address());
+
+    probe.socket = new QSslSocket(this);
+    probe.socket->setPeerVerifyMode(QSslSocket::VerifyNone);
+
+    connect(probe.socket, &QSslSocket::encrypted, this, [this, index]() {
+        Probe &probe = m_probes[index];
+        probe.handshakeMs = probe.handshakeTimer.elapsed();
+        release(probe);
+        checkFinished();
+    });
+    connect(probe.socket, &QSslSocket::errorOccurred, this, [this, index](QAbstractSocket::SocketError) {
+        Probe &probe = m_probes[index];
+        LOGI << "TLS handshake with " << probe.gateway.name() << " failed: " << probe.socket->errorString();
+        release(probe);
+        checkFinished();
+    });
+
+    probe.handshakeTimer.start();
+    probe.socket->connectToHostEncrypted(url.host(), url.port(443));
+}
+
+void GatewayProber::startPrelogin(int index)
+{
+    Probe &probe = m_probes[index];
+    const QString preloginUrl = "https://" + probe.gateway.address()
+        + "/ssl-vpn/prelogin.esp?tmp=tmp&kerberos-support=yes&ipv6-support=yes&clientVer=4100";
+
+    // The shared network manager keeps the connection, the gateway authentication reuses it afterwards
+    probe.reply = createRequest(preloginUrl);
+    probe.requestTimer.start();
+
+    connect(probe.reply, &QNetworkReply::finished, this, [this, index]() {
+        Probe &probe = m_probes[index];
+        const qint64 elapsed = probe.requestTimer.elapsed();
+        // Any HTTP answer is a round trip, whatever the status
+        const bool answered = probe.reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).isValid();
+
+        if (!answered) {
+            LOGI << "Prelogin of " << probe.gateway.name() << " failed: " << probe.reply->errorString();
+        }
+
+        probe.reply->deleteLater();
+        probe.reply = nullptr;
+
+        if (answered) {
+            probe.samples.append(elapsed);
+            if (probe.samples.size() < PRELOGIN_SAMPLES && isRunning()) {
+                startPrelogin(index);
+                return;
+            }
+        }
+        checkFinished();
+    });
+}
+
+void GatewayProber::checkFinished()
+{
+    for (const auto &probe : m_probes) {
+        if (!probe.isDone()) {
+            return;
+        }
+    }
+    finish();
+}
+
+void GatewayProber::finish()
+{
+    m_deadline->stop();
+
+    QList<std::pair<double, GPGateway>> scored;
+    for (auto &probe : m_probes) {
+        release(probe);
+
+        GPGateway gateway = probe.gateway;
+        if (!probe.samples.isEmpty()) {
+            gateway.setLatency(percentile(probe.samples, 50));
+        } else if (probe.handshakeMs >= 0) {
+            gateway.setLatency(probe.handshakeMs);
+        }
+
+        const double score = scoreOf(probe);
+        LOGI << "Gateway " << gateway.name() << ": handshake " << probe.handshakeMs << " ms, "
+             << probe.samples.size() << " prelogin sample(s), p50 " << percentile(probe.samples, 50)
+             << " ms, p90 " << percentile(probe.samples, 90) << " ms, score " << score;
+        scored.append({ score, gateway });
+    }
+    m_probes.clear();
+
+    // Ties keep the order of the portal
+    std::stable_sort(scored.begin(), scored.end(), [](const auto &a, const auto &b) {
+        return a.first < b.first;
+    });
+
+    QList<GPGateway> ranked;
+    for (const auto &entry : scored) {
+        ranked.append(entry.second);
+    }
+
+    Tracer::end(m_probeSpan, ranked.isEmpty() ? QString() : ranked.first().name());
+    m_probeSpan = 0;
+
+    emit finished(ranked);
+}
+
+void GatewayProber::release(Probe &probe)
+{
+    if (probe.socket) {
+        disconnect(probe.socket, nullptr, this, nullptr);
+        probe.socket->abort();
+        probe.socket->deleteLater();
+        probe.socket = nullptr;
+    }
+    if (probe.reply) {
+        disconnect(probe.reply, nullptr, this, nullptr);
+        probe.reply->abort();
+        probe.reply->deleteLater();
+        probe.reply = nullptr;
+    }
+}
+
+double GatewayProber::scoreOf(const Probe &probe) const
+{
+    const double priorityPenalty = double(priorityOf(probe.gateway) - 1) * PRIORITY_STEP_MS;
+
+    if (!probe.samples.isEmpty()) {
+        const qint64 median = percentile(probe.samples, 50);
+        // A gateway answering unevenly is worth less than its median
+        const qint64 spread = percentile(probe.samples, 90) - median;
+        return double(median) + double(spread) / 2 + priorityPenalty;
+    }
+    if (probe.handshakeMs >= 0) {
+        return double(probe.handshakeMs) + priorityPenalty;
+    }
+    // Not reachable within the deadline, behind all the others
+    return double(PROBE_DEADLINE_MS) * 2 + priorityPenalty;
+}
+
+int GatewayProber::priorityOf(const GPGateway &gateway) const
+{
+    int priority = gateway.priorityOf(m_ruleName);
+    if (priority <= 0) {
+        priority = gateway.priorityOf("Any");
+    }
+    return priority > 0 ? priority : DEFAULT_PRIORITY;
+}
+
+qint64 GatewayProber::percentile(QList<qint64> samples, int percent)
+{
+    if (samples.isEmpty()) {
+        return -1;
+    }
+
+    // Nearest rank
+    std::sort(samples.begin(), samples.end());
+    const int rank = (percent * samples.size() + 99) / 100;
+    return samples.at(std::max(rank, 1) - 1);
+}
@@ -0,0 +1,77 @@
+#ifndef GATEWAYPROBER_H
+#define GATEWAYPROBER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QList>
+#include <QTimer>
+#include "gpgateway.h"
+#include "tracer.h"
+
+class QNetworkReply;
+class QSslSocket;
+
+/*
+ * Measures all the gateways of the portal at once and ranks them.
+ *
+ * Each gateway gets a TLS handshake and a few prelogin.esp round trips,
+ * every gateway in parallel, until they are all done or the deadline
+ * passes. The rank combines the median and the spread of the round trips
+ * with the priority the portal gives the gateway for the region, a gateway
+ * that did not answer comes after the ones that did.
+ */
+class GatewayProber : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit GatewayProber(QObject *parent = nullptr);
+    ~GatewayProber();
+
+    bool isRunning() const { return m_deadline->isActive(); }
+
+    void probe(const QList<GPGateway> &gateways, const QString &ruleName);
+    void abort();
+
+signals:
+    // Best first, with the measured latency set on the reachable gateways
+    void finished(const QList<GPGateway> &ranked);
+
+private:
+    static constexpr int PROBE_DEADLINE_MS = 2500;
+    static constexpr int PRELOGIN_SAMPLES = 3;
+    // What a step of the portal priority is worth against the latency
+    static constexpr int PRIORITY_STEP_MS = 50;
+    // The priority of a gateway without a rule for the region, in the middle of 1 (highest) to 5 (lowest)
+    static constexpr int DEFAULT_PRIORITY = 3;
+
+    struct Probe {
+        GPGateway gateway;
+        QSslSocket *socket { nullptr };
+        QNetworkReply *reply { nullptr };
+        QElapsedTimer handshakeTimer;
+        QElapsedTimer requestTimer;
+        qint64 handshakeMs { -1 };
+        // The prelogin round trips in milliseconds
+        QList<qint64> samples;
+
+        bool isDone() const { return !socket && !reply; }
+    };
+
+    QList<Probe> m_probes;
+    QString m_ruleName;
+    QTimer *m_deadline;
+    Tracer::SpanId m_probeSpan { 0 };
+
+    void startHandshake(int index);
+    void startPrelogin(int index);
+    void checkFinished();
+    void finish();
+    void release(Probe &probe);
+
+    double scoreOf(const Probe &probe) const;
+    int priorityOf(const GPGateway &gateway) const;
+    static qint64 percentile(QList<qint64> samples, int percent);
+};
+
+#endif // GATEWAYPROBER_H
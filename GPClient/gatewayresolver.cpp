@@ -0,0 +1,173 @@
+#include "gatewayresolver.h"
+#include <QCoreApplication>
+#include <QHostInfo>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QUrl>
+#include <algorithm>
+#include "logging.h"
+
+GatewayResolver& GatewayResolver::instance()
+{
+    // Parented to the application, created after it
+    static GatewayResolver *instance = new GatewayResolver(qApp);
+    return *instance;
+}
+
+GatewayResolver::GatewayResolver(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void GatewayResolver::resolve(const QList<GPGateway> &gateways)
+{
+    for (const auto &gateway : gateways) {
+        const QUrl url("https://" + gateway.address());
+        const QString host = url.host();
+
+        // Nothing to resolve for an address
+        if (host.isEmpty() || !QHostAddress(host).isNull() || m_races.contains(host)) {
+            continue;
+        }
+
+        auto it = m_entries.constFind(host);
+        if (it != m_entries.constEnd() && !it->expiry.hasExpired()) {
+            continue;
+        }
+
+        auto race = std::make_shared<Race>();
+        race->host = host;
+        race->port = quint16(url.port(443));
+        m_races.insert(host, race);
+
+        lookup(race);
+    }
+}
+
+QStringList GatewayResolver::resolveEntries(const QStringList &servers) const
+{
+    QStringList entries;
+    for (const auto &server : servers) {
+        const QString host = hostOf(server);
+        auto it = m_entries.constFind(host);
+        if (it == m_entries.constEnd() || it->expiry.hasExpired()) {
+            continue;
+        }
+
+        const QString entry = host + ":" + it->address.toString();
+        if (!entries.contains(entry)) {
+            entries << entry;
+        }
+    }
+    return entries;
+}
+
+void GatewayResolver::lookup(const std::shared_ptr<Race> &race)
+{
+    QHostInfo::lookupHost(race->host, this, [this, race](const QHostInfo &info) {
+        for (const auto &address : info.addresses()) {
+            auto &list = address.protocol() == QAbstractSocket::IPv6Protocol ? race->ipv6 : race->ipv4;
+            list << address;
+        }
+
+        startRace(race);
+    });
+}
+
+void GatewayResolver::startRace(const std::shared_ptr<Race> &race)
+{
+    for (int i = 0; i < std::max(race->ipv6.size(), race->ipv4.size()); ++i) {
+        if (i < race->ipv6.size()) {
+            race->candidates << race->ipv6.at(i);
+        }
+        if (i < race->ipv4.size()) {
+            race->candidates << race->ipv4.at(i);
+        }
+    }
+
+    if (race->candidates.isEmpty()) {
+        LOGI << "Could not resolve the gateway " << race->host;
+        finish(race, QHostAddress());
+        return;
+    }
+
+    race->attemptTimer = new QTimer(this);
+    race->attemptTimer->setInterval(ATTEMPT_DELAY_MS);
+    connect(race->attemptTimer, &QTimer::timeout, this, [this, race]() {
+        attempt(race);
+    });
+
+    race->deadline = new QTimer(this);
+    race->deadline->setSingleShot(true);
+    connect(race->deadline, &QTimer::timeout, this, [this, race]() {
+        finish(race, QHostAddress());
+    });
+
+    race->deadline->start(RACE_TIMEOUT_MS);
+    race->attemptTimer->start();
+    attempt(race);
+}
+
+void GatewayResolver::attempt(const std::shared_ptr<Race> &race)
+{
+    if (race->sockets.size() >= race->candidates.size()) {
+        race->attemptTimer->stop();
+        return;
+    }
+
+    const QHostAddress address = race->candidates.at(race->sockets.size());
+    auto *socket = new QTcpSocket(this);
+    race->sockets << socket;
+
+    connect(socket, &QTcpSocket::connected, this, [this, race, address]() {
+        finish(race, address);
+    });
+    connect(socket, &QTcpSocket::errorOccurred, this, [this, race](QAbstractSocket::SocketError) {
+        if (++race->failed == race->candidates.size()) {
+            finish(race, QHostAddress());
+            return;
+        }
+        // Do not wait for the delay when an attempt failed
+        attempt(race);
+    });
+
+    socket->connectToHost(address, race->port);
+}
+
+void GatewayResolver::finish(const std::shared_ptr<Race> &race, const QHostAddress &winner)
+{
+    if (m_races.value(race->host) != race) {
+        return;
+    }
+    m_races.remove(race->host);
+
+    for (auto *socket : race->sockets) {
+        disconnect(socket, nullptr, this, nullptr);
+        socket->abort();
+        socket->deleteLater();
+    }
+    race->sockets.clear();
+    for (auto *timer : { race->attemptTimer, race->deadline }) {
+        if (timer) {
+            timer->stop();
+            timer->deleteLater();
+        }
+    }
+
+    if (winner.isNull()) {
+        LOGI << "No address of " << race->host << " answered";
+        return;
+    }
+
+    LOGI << "Resolved " << race->host << " to " << winner.toString() << " for " << ENTRY_TTL_S << " s";
+
+    Entry entry;
+    entry.address = winner;
+    entry.expiry = QDeadlineTimer(qint64(ENTRY_TTL_S) * 1000);
+    m_entries.insert(race->host, entry);
+}
+
+QString GatewayResolver::hostOf(const QString &server)
+{
+    return QUrl("https://" + server).host();
+}
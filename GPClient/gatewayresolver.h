@@ -0,0 +1,80 @@
+#ifndef GATEWAYRESOLVER_H
+#define GATEWAYRESOLVER_H
+
+#include <QObject>
+#include <QDeadlineTimer>
+#include <QHash>
+#include <QHostAddress>
+#include <QList>
+#include <QStringList>
+#include <memory>
+#include "gpgateway.h"
+
+class QTcpSocket;
+class QTimer;
+
+/*
+ * Resolves the gateways ahead of the connection, so that the service can
+ * hand the address to openconnect (--resolve) instead of letting it wait on
+ * a slow resolver.
+ *
+ * The gateways are looked up in parallel through the system resolver
+ * (getaddrinfo), the one openconnect would use: /etc/hosts, nsswitch and the
+ * split DNS of systemd-resolved give the same answer. The addresses are then
+ * tried the happy eyeballs way (RFC 8305): IPv6 and IPv4 interleaved, IPv6
+ * first, a new TCP connect every ATTEMPT_DELAY_MS until one succeeds. The
+ * first address to connect is kept for ENTRY_TTL_S, the system resolver
+ * does not tell the TTL of the records.
+ */
+class GatewayResolver : public QObject
+{
+    Q_OBJECT
+
+public:
+    static GatewayResolver& instance();
+
+    // Resolves in the background the gateways without a valid address
+    void resolve(const QList<GPGateway> &gateways);
+    // "host:address" of the servers with a valid address, the format of openconnect --resolve
+    QStringList resolveEntries(const QStringList &servers) const;
+
+private:
+    explicit GatewayResolver(QObject *parent = nullptr);
+    ~GatewayResolver() = default;
+
+    GatewayResolver(const GatewayResolver&) = delete;
+    GatewayResolver& operator=(const GatewayResolver&) = delete;
+
+    struct Entry {
+        QHostAddress address;
+        QDeadlineTimer expiry;
+    };
+
+    struct Race {
+        QString host;
+        quint16 port { 443 };
+        QList<QHostAddress> ipv4;
+        QList<QHostAddress> ipv6;
+        // Interleaved, IPv6 first
+        QList<QHostAddress> candidates;
+        QList<QTcpSocket *> sockets;
+        int failed { 0 };
+        QTimer *attemptTimer { nullptr };
+        QTimer *deadline { nullptr };
+    };
+
+    static constexpr int ATTEMPT_DELAY_MS = 250;
+    static constexpr int RACE_TIMEOUT_MS = 3000;
+    static constexpr int ENTRY_TTL_S = 60;
+
+    QHash<QString, Entry> m_entries;
+    QHash<QString, std::shared_ptr<Race>> m_races;
+
+    void lookup(const std::shared_ptr<Race> &race);
+    void startRace(const std::shared_ptr<Race> &race);
+    void attempt(const std::shared_ptr<Race> &race);
+    void finish(const std::shared_ptr<Race> &race, const QHostAddress &winner);
+    static QString hostOf(const QString &server);
+};
+
+#endif // GATEWAYRESOLVER_H
@@ -3,6 +3,8 @@
 #include "gphelper.h"
 #include "vpn_dbus.h"
 #include "vpn_json.h"
+#include "connectionpool.h"
+#include "gatewayresolver.h"
 
 #include <QApplication>
 #include <QCloseEvent>
@@ -10,6 +12,8 @@
 #include <QTimer>
 #include <QPushButton>
 #include <QIcon>
+#include <QJsonArray>
+#include <QSaveFile>
 #include "logging.h"
 
 using namespace gpclient::helper;
@@ -22,6 +26,7 @@ ModernGPClient::ModernGPClient(std::shared_ptr<IVpn> vpn, QWidget *parent)
     , m_isAutoConnecting(false)
     , m_isInitialized(false)
     , m_isQuitting(false)
+    , m_isFailoverLogin(false)
 {
     ui->setupUi(this);
     
@@ -37,6 +42,12 @@ ModernGPClient::ModernGPClient(std::shared_ptr<IVpn> vpn, QWidget *parent)
     m_autoConnectTimer = new QTimer(this);
     m_autoConnectTimer->setSingleShot(true);
     m_autoConnectTimer->setInterval(2000); // 2 second delay for auto-connect
+
+    m_stallMonitor = new StallMonitor(this);
+
+    m_preconnectTimer = new QTimer(this);
+    m_preconnectTimer->setSingleShot(true);
+    m_preconnectTimer->setInterval(500);
     
     setupUI();
     setupConnections();
@@ -104,14 +115,26 @@ void ModernGPClient::setupConnections()
             this, &ModernGPClient::onConnectionStateChanged);
     connect(m_connectionManager.get(), &ConnectionManager::error,
             this, &ModernGPClient::onConnectionError);
+    connect(m_connectionManager.get(), &ConnectionManager::gatewaySwitched,
+            this, &ModernGPClient::onGatewaySwitched);
+    connect(m_connectionManager.get(), &ConnectionManager::gatewaySwitchFailed,
+            this, &ModernGPClient::onGatewaySwitchFailed);
+    connect(m_connectionManager.get(), &ConnectionManager::gatewayFailedOver,
+            this, &ModernGPClient::onGatewayFailedOver);
+    connect(m_connectionManager.get(), &ConnectionManager::gatewayAuthRequired,
+            this, &ModernGPClient::onGatewayAuthRequired);
     
     // Authentication manager
     connect(m_authManager.get(), &AuthenticationManager::stateChanged,
             this, &ModernGPClient::onAuthenticationStateChanged);
     connect(m_authManager.get(), &AuthenticationManager::authenticationProgress,
             this, &ModernGPClient::onAuthenticationProgress);
+    connect(m_authManager.get(), &AuthenticationManager::authenticationWarning,
+            this, &ModernGPClient::onAuthenticationWarning);
     connect(m_authManager.get(), &AuthenticationManager::portalAuthenticationSucceeded,
             this, &ModernGPClient::onPortalAuthSucceeded);
+    connect(m_authManager.get(), &AuthenticationManager::gatewaysReranked,
+            this, &ModernGPClient::onGatewaysReranked);
     connect(m_authManager.get(), &AuthenticationManager::gatewayAuthenticationSucceeded,
             this, &ModernGPClient::onGatewayAuthSucceeded);
     connect(m_authManager.get(), &AuthenticationManager::authenticationFailed,
@@ -126,6 +149,16 @@ void ModernGPClient::setupConnections()
     // Auto-connect timer
     connect(m_autoConnectTimer, &QTimer::timeout,
             this, &ModernGPClient::onAutoConnectTimeout);
+
+    // The TLS connection to the portal is ready when the user connects
+    connect(m_preconnectTimer, &QTimer::timeout, this, [this]() {
+        const QUrl url("https://" + m_currentPortal);
+        const bool validHost = url.isValid()
+            && (url.host().contains('.') || url.host().contains(':') || url.host() == "localhost");
+        if (validHost) {
+            ConnectionPool::instance().preconnect(m_currentPortal);
+        }
+    });
 }
 
 void ModernGPClient::setupSystemTray()
@@ -219,6 +252,12 @@ void ModernGPClient::connectToVPN()
     // Save portal address
     m_currentPortal = portal;
     m_settings.setPortalAddress(portal);
+
+    // Every span of this attempt, including the ones of gpservice, is recorded under this id
+    finishTrace("superseded");
+    Tracer::setCurrentTrace(Tracer::newTraceId());
+    m_connectSpan = Tracer::begin("client.connect");
+    m_stallMonitor->start();
     
     // Start authentication process
     if (!m_currentGateway.name().isEmpty()) {
@@ -226,11 +265,16 @@ void ModernGPClient::connectToVPN()
         LOGI << "Quick connect to saved gateway: " << m_currentGateway.name();
         GatewayAuthenticatorParams params;
         params.setClientos(m_settings.clientOS());
-        m_authManager->authenticateGateway(m_currentGateway.address(), params);
+        // Resolved while the gateway authenticates, for the --resolve of openconnect
+        GatewayResolver::instance().resolve(m_availableGateways.isEmpty() ? QList<GPGateway> { m_currentGateway } : m_availableGateways);
+        // A single login.esp with the portal cookie of the last session, a login only when rejected
+        m_authManager->authenticateGateway(m_currentGateway.address(), params, portal);
     } else {
         // Start with portal authentication
         LOGI << "Starting portal authentication";
-        m_authManager->authenticatePortal(portal);
+        // The first gateway saved for the portal is the best ranked of the last session
+        const QList<GPGateway> savedGateways = m_settings.gateways(portal);
+        m_authManager->authenticatePortal(portal, savedGateways.isEmpty() ? QString() : savedGateways.first().address());
     }
 }
 
@@ -438,6 +482,7 @@ void ModernGPClient::onPortalInputChanged()
         }
         
         updateGatewayMenu();
+        m_preconnectTimer->start();
     }
 }
 
@@ -455,10 +500,11 @@ void ModernGPClient::onConnectionStateChanged(ConnectionManager::ConnectionState
     // Show notifications for important state changes
     switch (state) {
         case ConnectionManager::ConnectionState::Connected:
+            finishTrace();
             showInfo("GlobalProtect", "Connected successfully");
             break;
         case ConnectionManager::ConnectionState::Disconnected:
-            if (!m_isQuitting) {
+            if (!m_isQuitting && !m_isFailoverLogin) {
                 showInfo("GlobalProtect", "Disconnected");
             }
             break;
@@ -470,6 +516,7 @@ void ModernGPClient::onConnectionStateChanged(ConnectionManager::ConnectionState
 void ModernGPClient::onConnectionError(const QString &error)
 {
     LOGE << "Connection error: " << error;
+    finishTrace(error);
     showError("Connection Failed", error);
     updateUIState();
 }
@@ -498,6 +545,11 @@ void ModernGPClient::onAuthenticationProgress(const QString &message)
     LOGI << "Auth progress: " << message;
 }
 
+void ModernGPClient::onAuthenticationWarning(const QString &message)
+{
+    showInfo("GlobalProtect", message);
+}
+
 void ModernGPClient::onPortalAuthSucceeded(const PortalConfigResponse &config, const QString &region)
 {
     LOGI << "Portal authentication succeeded";
@@ -521,16 +573,40 @@ void ModernGPClient::onPortalAuthSucceeded(const PortalConfigResponse &config, c
     updateGatewayMenu();
 }
 
+void ModernGPClient::onGatewaysReranked(const QList<GPGateway> &ranked)
+{
+    m_availableGateways = ranked;
+    m_connectionManager->setGateways(m_availableGateways);
+
+    if (!m_currentPortal.isEmpty()) {
+        m_settings.setGateways(m_currentPortal, m_availableGateways);
+    }
+
+    updateGatewayMenu();
+}
+
 void ModernGPClient::onGatewayAuthSucceeded(const QString &authCookie, const QString &username)
 {
     LOGI << "Gateway authentication succeeded for user: " << username;
     
+    // A switch keeps the running tunnel until the new one is up
+    if (m_connectionManager && m_connectionManager->isSwitchingGateway()) {
+        m_connectionManager->completeGatewaySwitch(username, authCookie);
+        return;
+    }
+
     // Now connect to VPN
     if (m_connectionManager && !m_currentGateway.name().isEmpty()) {
         QStringList gatewayAddresses;
         for (const auto &gateway : m_availableGateways) {
             gatewayAddresses.append(gateway.address());
         }
+
+        // The other gateways were already tried
+        if (m_isFailoverLogin) {
+            m_isFailoverLogin = false;
+            gatewayAddresses = QStringList { m_currentGateway.address() };
+        }
         
         m_connectionManager->connectToVPN(
             m_currentGateway.address(),
@@ -544,19 +620,115 @@ void ModernGPClient::onGatewayAuthSucceeded(const QString &authCookie, const QSt
 void ModernGPClient::onAuthenticationFailed(const QString &error)
 {
     LOGE << "Authentication failed: " << error;
+    m_isFailoverLogin = false;
+
+    // The new gateway could not be authenticated, the current tunnel is still up
+    if (m_connectionManager && m_connectionManager->isSwitchingGateway()) {
+        m_connectionManager->abortGatewaySwitch(error);
+        return;
+    }
+
+    finishTrace(error);
     showError("Authentication Failed", error);
     updateUIState();
 }
 
+void ModernGPClient::setTraceFile(const QString &path)
+{
+    m_traceFile = path;
+    Tracer::setProcessName("gpclient");
+    Tracer::setEnabled(!path.isEmpty());
+}
+
+void ModernGPClient::finishTrace(const QString &detail)
+{
+    if (m_stallMonitor->isRunning()) {
+        const qint64 stallMs = m_stallMonitor->stop();
+        LOGI << "Longest GUI thread stall of the connection attempt: " << stallMs << " ms";
+        Tracer::instant("gui.stall", QString("%1 ms").arg(stallMs));
+    }
+
+    if (!m_connectSpan) {
+        return;
+    }
+
+    Tracer::end(m_connectSpan, detail);
+    m_connectSpan = 0;
+
+    const QString traceId = Tracer::currentTrace();
+    Tracer::setCurrentTrace(QString());
+
+    // The service has finished its spans by the time the client sees the result
+    const QJsonArray clientEvents = Tracer::events(traceId);
+    const QString path = m_traceFile;
+    m_vpn->traceEvents(traceId, [clientEvents, traceId, path](const QJsonArray &serviceEvents) {
+        QJsonArray events = clientEvents;
+        for (const QJsonValue &event : serviceEvents) {
+            events.append(event);
+        }
+
+        QSaveFile file(path);
+        if (!file.open(QIODevice::WriteOnly) || file.write(Tracer::toJson(events)) < 0 || !file.commit()) {
+            LOGW << "Failed to write the trace to " << path << ": " << file.errorString();
+            return;
+        }
+        LOGI << "Trace " << traceId << " written to " << path;
+    });
+}
+
 void ModernGPClient::onSystemTrayGatewayChange(const GPGateway &gateway)
 {
-    if (gateway.name() != m_currentGateway.name()) {
+    if (gateway.name() == m_currentGateway.name()) {
+        return;
+    }
+
+    if (!m_connectionManager || !m_connectionManager->isConnected()) {
         setCurrentGateway(gateway);
-        
-        // If connected, switch gateway
-        if (m_connectionManager && m_connectionManager->isConnected()) {
-            m_connectionManager->switchGateway(gateway);
-        }
+        return;
+    }
+
+    // Switch without dropping the tunnel, the gateway becomes the current one once its tunnel is up
+    m_connectionManager->switchGateway(gateway);
+
+    GatewayAuthenticatorParams params;
+    params.setClientos(m_settings.clientOS());
+    if (!m_authManager->reauthenticateGateway(gateway.address(), params)) {
+        m_connectionManager->abortGatewaySwitch("Another authentication is in progress");
+    }
+}
+
+void ModernGPClient::onGatewaySwitched(const GPGateway &gateway)
+{
+    setCurrentGateway(gateway);
+}
+
+void ModernGPClient::onGatewaySwitchFailed(const GPGateway &previousGateway, const QString &error)
+{
+    setCurrentGateway(previousGateway);
+    showError("Gateway Switch Failed", error);
+}
+
+void ModernGPClient::onGatewayFailedOver(const GPGateway &gateway)
+{
+    // Remembered as the gateway of the portal, it is the one that worked
+    LOGI << "Connecting through " << gateway.name() << " instead";
+    setCurrentGateway(gateway);
+}
+
+void ModernGPClient::onGatewayAuthRequired(const GPGateway &gateway)
+{
+    // The cookie of the gateway failed over from is not valid there, a login with the portal cookie gets one
+    LOGI << "Logging in to " << gateway.name() << " to connect through it";
+    setCurrentGateway(gateway);
+
+    // The manager is still authenticated with the cookie that was rejected
+    GatewayAuthenticatorParams params;
+    params.setClientos(m_settings.clientOS());
+    m_isFailoverLogin = true;
+    if (!m_authManager->reauthenticateGateway(gateway.address(), params, m_currentPortal)) {
+        m_isFailoverLogin = false;
+        showError("Authentication Failed", QString("Could not log in to %1, another authentication is in progress").arg(gateway.name()));
+        updateUIState();
     }
 }
 
@@ -11,6 +11,8 @@
 #include "settingsmanager.h"
 #include "vpn.h"
 #include "gpgateway.h"
+#include "tracer.h"
+#include "stallmonitor.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class GPClient; }
@@ -29,6 +31,8 @@ public:
     void connectToVPN();
     void disconnectFromVPN();
     void reset();
+    // Writes the phases of each connection attempt to the file, in the Chrome trace-event format
+    void setTraceFile(const QString &path);
 
 protected:
     void closeEvent(QCloseEvent *event) override;
@@ -47,11 +51,17 @@ private slots:
     // Connection Manager Events
     void onConnectionStateChanged(ConnectionManager::ConnectionState state);
     void onConnectionError(const QString &error);
+    void onGatewaySwitched(const GPGateway &gateway);
+    void onGatewaySwitchFailed(const GPGateway &previousGateway, const QString &error);
+    void onGatewayFailedOver(const GPGateway &gateway);
+    void onGatewayAuthRequired(const GPGateway &gateway);
 
     // Authentication Manager Events
     void onAuthenticationStateChanged(AuthenticationManager::AuthState state);
     void onAuthenticationProgress(const QString &message);
+    void onAuthenticationWarning(const QString &message);
     void onPortalAuthSucceeded(const PortalConfigResponse &config, const QString &region);
+    void onGatewaysReranked(const QList<GPGateway> &ranked);
     void onGatewayAuthSucceeded(const QString &authCookie, const QString &username);
     void onAuthenticationFailed(const QString &error);
 
@@ -80,6 +90,8 @@ private:
     
     void saveWindowGeometry();
     void restoreWindowGeometry();
+
+    void finishTrace(const QString &detail = QString());
     
     // Core components
     Ui::GPClient *ui;
@@ -97,10 +109,21 @@ private:
     // Auto-connect functionality
     QTimer *m_autoConnectTimer;
     bool m_isAutoConnecting;
+
+    // Connects to the portal once the address stops changing
+    QTimer *m_preconnectTimer;
     
     // State tracking
     bool m_isInitialized;
     bool m_isQuitting;
+    // Logging in to a gateway the service failed over to, the connect then goes to that gateway only
+    bool m_isFailoverLogin;
+
+    // Tracing of the connection attempts, see setTraceFile()
+    QString m_traceFile;
+    Tracer::SpanId m_connectSpan { 0 };
+    // The longest GUI thread stall of each connection attempt, reported by finishTrace()
+    StallMonitor *m_stallMonitor;
 };
 
 #endif // GPCLIENT_MODERN_H
\ No newline at end of file
@@ -41,12 +41,30 @@ int GPGateway::priorityOf(QString ruleName) const
     return 0;
 }
 
+int GPGateway::latency() const
+{
+    return _latency;
+}
+
+void GPGateway::setLatency(int latency)
+{
+    _latency = latency;
+}
+
 QJsonObject GPGateway::toJsonObject() const
 {
     QJsonObject obj;
     obj.insert("name", name());
     obj.insert("address", address());
 
+    if (!_priorityRules.isEmpty()) {
+        QJsonObject rules;
+        for (auto it = _priorityRules.cbegin(); it != _priorityRules.cend(); ++it) {
+            rules.insert(it.key(), it.value());
+        }
+        obj.insert("priorityRules", rules);
+    }
+
     return obj;
 }
 
@@ -93,5 +111,12 @@ GPGateway GPGateway::fromJsonObject(const QJsonObject &jsonObj)
     g.setName(jsonObj.value("name").toString());
     g.setAddress(jsonObj.value("address").toString());
 
+    QMap<QString, int> priorityRules;
+    const QJsonObject rules = jsonObj.value("priorityRules").toObject();
+    for (auto it = rules.constBegin(); it != rules.constEnd(); ++it) {
+        priorityRules.insert(it.key(), it.value().toInt());
+    }
+    g.setPriorityRules(priorityRules);
+
     return g;
 }
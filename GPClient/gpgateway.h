@@ -17,6 +17,9 @@ public:
     void setAddress(const QString &address);
     void setPriorityRules(const QMap<QString, int> &priorityRules);
     int priorityOf(QString ruleName) const;
+    // The round trip measured by GatewayProber in milliseconds, -1 when not measured
+    int latency() const;
+    void setLatency(int latency);
     QJsonObject toJsonObject() const;
     QString toString() const;
 
@@ -28,6 +31,7 @@ private:
     QString _name;
     QString _address;
     QMap<QString, int> _priorityRules;
+    int _latency { -1 };
 };
 
 Q_DECLARE_METATYPE(GPGateway)
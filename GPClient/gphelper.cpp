@@ -12,33 +12,24 @@
 #include <keychain.h>
 
 #include "gphelper.h"
+#include "connectionpool.h"
 
 using namespace QKeychain;
 
-QNetworkAccessManager* gpclient::helper::networkManager = nullptr;
-
 QNetworkReply* gpclient::helper::createRequest(QString url, QByteArray params)
 {
     QNetworkRequest request(url);
 
-    // Skip the ssl verifying
-    QSslConfiguration conf = request.sslConfiguration();
-    conf.setPeerVerifyMode(QSslSocket::VerifyNone);
-    conf.setSslOption(QSsl::SslOptionDisableLegacyRenegotiation, false);
-    request.setSslConfiguration(conf);
+    // Skip the ssl verifying, the same configuration as the preconnected connections
+    request.setSslConfiguration(ConnectionPool::instance().sslConfiguration(request.url().host()));
 
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded");
     request.setHeader(QNetworkRequest::UserAgentHeader, UA);
 
-    // Ensure network manager exists (lazy init after Q(Core)Application is constructed)
-    if (!networkManager) {
-        networkManager = new QNetworkAccessManager(qApp);
-    }
-
     if (params == nullptr) {
-        return networkManager->post(request, QByteArray(nullptr));
+        return ConnectionPool::instance().post(request, QByteArray(nullptr));
     }
-    return networkManager->post(request, params);
+    return ConnectionPool::instance().post(request, params);
 }
 
 GPGateway gpclient::helper::filterPreferredGateway(QList<GPGateway> gateways, const QString ruleName)
@@ -59,8 +50,8 @@ GPGateway gpclient::helper::filterPreferredGateway(QList<GPGateway> gateways, co
 
 QUrlQuery gpclient::helper::parseGatewayResponse(const QByteArray &xml)
 {
+    // Not logged, the cookie is one of the positional arguments
     LOGI << "Start parsing the gateway response...";
-    LOGI << "The gateway response is: " << xml;
 
     QXmlStreamReader xmlReader{xml};
     QList<QString> args;
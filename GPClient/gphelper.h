@@ -16,8 +16,6 @@ const QString UA = "PAN GlobalProtect";
 
 namespace gpclient {
     namespace helper {
-        extern QNetworkAccessManager *networkManager;
-
         QNetworkReply* createRequest(QString url, QByteArray params = nullptr);
 
         GPGateway filterPreferredGateway(QList<GPGateway> gateways, const QString ruleName);
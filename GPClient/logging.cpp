@@ -0,0 +1,237 @@
+#include "logging.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRegularExpression>
+#include <QThread>
+#include <QWaitCondition>
+#include <cstdio>
+#include <utility>
+
+std::atomic<int> Logger::threshold { 2 };
+
+namespace {
+
+/*
+ * Writes the records of every thread, off the thread that logged them.
+ *
+ * The records are queued as they are, the writer thread adds the timestamp
+ * and level, removes the cookies and writes them to stderr and, when set,
+ * to the log file. The file is rotated once it reaches MAX_FILE_SIZE,
+ * keeping MAX_ROTATED_FILES older ones (gpclient.log.1 the most recent).
+ */
+class LogWriter
+{
+public:
+    ~LogWriter()
+    {
+        {
+            QMutexLocker locker(&m_mutex);
+            m_stopping = true;
+            m_wakeUp.wakeAll();
+        }
+        if (m_thread) {
+            m_thread->wait();
+            delete m_thread;
+        }
+    }
+
+    void setFilePath(const QString &path)
+    {
+        QMutexLocker locker(&m_mutex);
+        m_filePath = path;
+        m_filePathChanged = true;
+    }
+
+    void submit(QtMsgType type, const QString &text)
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_thread) {
+            m_thread = QThread::create([this]() { run(); });
+            m_thread->start(QThread::LowPriority);
+        }
+        if (m_queue.size() >= MAX_QUEUED) {
+            m_dropped++;
+            return;
+        }
+        m_queue.append({ type, QDateTime::currentMSecsSinceEpoch(), text });
+        m_wakeUp.wakeOne();
+    }
+
+    void flush()
+    {
+        QMutexLocker locker(&m_mutex);
+        while (!m_queue.isEmpty() || m_writing) {
+            m_drained.wait(&m_mutex);
+        }
+    }
+
+private:
+    struct Record {
+        QtMsgType type;
+        qint64 timestamp;
+        QString text;
+    };
+
+    // Past it the records are dropped rather than the loggers blocked
+    static constexpr int MAX_QUEUED = 10000;
+    static constexpr qint64 MAX_FILE_SIZE = 10 * 1024 * 1024;
+    static constexpr int MAX_ROTATED_FILES = 3;
+
+    QMutex m_mutex;
+    QWaitCondition m_wakeUp;
+    QWaitCondition m_drained;
+    QList<Record> m_queue;
+    int m_dropped { 0 };
+    bool m_writing { false };
+    bool m_stopping { false };
+    QThread *m_thread { nullptr };
+    QString m_filePath;
+    bool m_filePathChanged { false };
+
+    // Owned by the writer thread
+    QFile m_file;
+    QByteArray m_line;
+
+    void run()
+    {
+        QList<Record> batch;
+        for (;;) {
+            int dropped;
+            bool filePathChanged;
+            QString filePath;
+            {
+                QMutexLocker locker(&m_mutex);
+                m_writing = false;
+                m_drained.wakeAll();
+                while (m_queue.isEmpty() && !m_stopping) {
+                    m_wakeUp.wait(&m_mutex);
+                }
+                if (m_queue.isEmpty()) {
+                    return;
+                }
+                batch.swap(m_queue);
+                dropped = m_dropped;
+                m_dropped = 0;
+                filePathChanged = m_filePathChanged;
+                m_filePathChanged = false;
+                filePath = m_filePath;
+                m_writing = true;
+            }
+
+            if (filePathChanged) {
+                openFile(filePath);
+            }
+            if (dropped > 0) {
+                write({ QtWarningMsg, QDateTime::currentMSecsSinceEpoch(),
+                        QString("%1 log record(s) dropped, the writer could not keep up").arg(dropped) });
+            }
+            for (const Record &record : std::as_const(batch)) {
+                write(record);
+            }
+            batch.clear();
+
+            std::fflush(stderr);
+            if (m_file.isOpen()) {
+                m_file.flush();
+            }
+        }
+    }
+
+    void write(const Record &record)
+    {
+        const char *level = "DEBUG";
+        switch (record.type) {
+            case QtDebugMsg:    level = "DEBUG"; break;
+            case QtInfoMsg:     level = "INFO "; break;
+            case QtWarningMsg:  level = "WARN "; break;
+            case QtCriticalMsg: level = "ERROR"; break;
+            case QtFatalMsg:    level = "FATAL"; break;
+        }
+
+        m_line.truncate(0);
+        m_line += QDateTime::fromMSecsSinceEpoch(record.timestamp).toString("yyyy-MM-dd hh:mm:ss.zzz").toLatin1();
+        m_line += ' ';
+        m_line += level;
+        m_line += "  ";
+        m_line += redact(record.text).toUtf8();
+        m_line += '\n';
+
+        std::fwrite(m_line.constData(), 1, size_t(m_line.size()), stderr);
+
+        if (m_file.isOpen()) {
+            if (m_file.size() + m_line.size() > MAX_FILE_SIZE) {
+                rotate();
+            }
+            m_file.write(m_line);
+        }
+    }
+
+    // The session cookies are never written, whatever was logged
+    static QString redact(const QString &text)
+    {
+        static const QRegularExpression cookie(
+            R"(([\w-]*cookie[\w-]*"?\s*[=:>]\s*"?)([^&\s<"]+))",
+            QRegularExpression::CaseInsensitiveOption);
+
+        if (!text.contains(QLatin1String("cookie"), Qt::CaseInsensitive)) {
+            return text;
+        }
+        QString redacted = text;
+        return redacted.replace(cookie, "\\1<redacted>");
+    }
+
+    void openFile(const QString &path)
+    {
+        m_file.close();
+        if (path.isEmpty()) {
+            return;
+        }
+
+        QDir().mkpath(QFileInfo(path).absolutePath());
+        m_file.setFileName(path);
+        if (!m_file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            std::fprintf(stderr, "Could not open the log file %s\n", qPrintable(path));
+        }
+    }
+
+    void rotate()
+    {
+        const QString path = m_file.fileName();
+        m_file.close();
+
+        QFile::remove(QString("%1.%2").arg(path).arg(MAX_ROTATED_FILES));
+        for (int i = MAX_ROTATED_FILES - 1; i >= 1; --i) {
+            QFile::rename(QString("%1.%2").arg(path).arg(i), QString("%1.%2").arg(path).arg(i + 1));
+        }
+        QFile::rename(path, path + ".1");
+
+        openFile(path);
+    }
+};
+
+LogWriter& writer()
+{
+    static LogWriter instance;
+    return instance;
+}
+
+}
+
+void Logger::configure(int level, const QString &filePath)
+{
+    threshold.store(level, std::memory_order_relaxed);
+    writer().setFilePath(filePath);
+}
+
+void Logger::flush()
+{
+    writer().flush();
+}
+
+void Logger::submit(QtMsgType type, const QString &text)
+{
+    writer().submit(type, text);
+}
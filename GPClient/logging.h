@@ -4,65 +4,133 @@
 #include <QDebug>
 #include <QDateTime>
 #include <QTextStream>
+#include <atomic>
+#include <memory>
+#include <string>
 
 // Qt-native logging macros to replace plog
 // These provide a similar streaming interface as plog
+//
+// The level is checked before anything is formatted: a filtered LOGD costs a
+// load and a branch. A record is formatted into a buffer of the thread, reused
+// from one record to the next, and only copied into the queued record handed
+// to a writer thread that adds the timestamp, redacts the cookies and writes
+// it to stderr and the log file, see Logger::configure().
+
+class Logger {
+public:
+    // 0 errors only, 1 warnings, 2 info, 3 debug
+    static void configure(int level, const QString &filePath = QString());
+    // Writes the queued records, before exit
+    static void flush();
+
+    static bool isEnabled(QtMsgType type) {
+        return severityOf(type) <= threshold.load(std::memory_order_relaxed);
+    }
+
+    static void submit(QtMsgType type, const QString &text);
+
+private:
+    static int severityOf(QtMsgType type) {
+        switch (type) {
+            case QtFatalMsg:
+            case QtCriticalMsg: return 0;
+            case QtWarningMsg:  return 1;
+            case QtInfoMsg:     return 2;
+            case QtDebugMsg:    return 3;
+        }
+        return 3;
+    }
+
+    static std::atomic<int> threshold;
+};
 
 class LogMessage {
 public:
     LogMessage(QtMsgType type, const char* file, int line)
-        : m_type(type), m_file(file), m_line(line) {}
-    
+        : m_type(type), m_file(file), m_line(line) {
+        Buffers &buffers = threadBuffers();
+        if (buffers.depth < MAX_DEPTH) {
+            m_buffer = &buffers.slots[buffers.depth++];
+        } else {
+            m_ownBuffer = std::make_unique<Buffer>();
+            m_buffer = m_ownBuffer.get();
+        }
+        // Keeps the capacity, and drops the manipulators of the previous record
+        m_buffer->text.truncate(0);
+        m_buffer->stream.reset();
+    }
+
     ~LogMessage() {
-        QString timestamp = QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss.zzz");
-        QString level;
-        switch (m_type) {
-            case QtDebugMsg:    level = "DEBUG"; break;
-            case QtInfoMsg:     level = "INFO "; break;
-            case QtWarningMsg:  level = "WARN "; break;
-            case QtCriticalMsg: level = "ERROR"; break;
-            case QtFatalMsg:    level = "FATAL"; break;
+        m_buffer->stream.flush();
+        Logger::submit(m_type, QString(m_buffer->text.constData(), m_buffer->text.size()));
+
+        if (m_buffer->text.capacity() > MAX_RETAINED) {
+            m_buffer->text = QString();
+            m_buffer->text.reserve(INITIAL_CAPACITY);
+        }
+        if (!m_ownBuffer) {
+            threadBuffers().depth--;
         }
-        
-        QTextStream(stderr) << timestamp << " " << level << "  " << m_stream << "\n";
     }
-    
+
+    LogMessage(const LogMessage&) = delete;
+    LogMessage& operator=(const LogMessage&) = delete;
+
     template<typename T>
     LogMessage& operator<<(const T& value) {
-        QTextStream ts(&m_stream);
-        ts << value;
-        return *this;
-    }
-    
-    // Overload for QString
-    LogMessage& operator<<(const QString& value) {
-        m_stream += value;
+        m_buffer->stream << value;
         return *this;
     }
-    
+
     // Overload for std::string
     LogMessage& operator<<(const std::string& value) {
-        m_stream += QString::fromStdString(value);
-        return *this;
-    }
-    
-    // Overload for const char*
-    LogMessage& operator<<(const char* value) {
-        m_stream += QString::fromUtf8(value);
+        m_buffer->stream << QString::fromStdString(value);
         return *this;
     }
 
 private:
+    // Most records fit, the longer ones grow it once or twice
+    static const int INITIAL_CAPACITY { 128 };
+    // A buffer grown past it by a long record is not kept
+    static const int MAX_RETAINED { 16 * 1024 };
+    // Records formatted at once on a thread, a value logging while it is formatted takes the next buffer
+    static const int MAX_DEPTH { 4 };
+
+    struct Buffer {
+        Buffer() {
+            text.reserve(INITIAL_CAPACITY);
+            stream.setString(&text);
+        }
+
+        QString text;
+        QTextStream stream;
+    };
+
+    struct Buffers {
+        Buffer slots[MAX_DEPTH];
+        int depth { 0 };
+    };
+
+    static Buffers &threadBuffers() {
+        thread_local Buffers buffers;
+        return buffers;
+    }
+
     QtMsgType m_type;
     const char* m_file;
     int m_line;
-    QString m_stream;
+    Buffer *m_buffer;
+    // Deeper than MAX_DEPTH
+    std::unique_ptr<Buffer> m_ownBuffer;
 };
 
-#define LOGD LogMessage(QtDebugMsg, __FILE__, __LINE__)
-#define LOGI LogMessage(QtInfoMsg, __FILE__, __LINE__)
-#define LOGW LogMessage(QtWarningMsg, __FILE__, __LINE__)
-#define LOGE LogMessage(QtCriticalMsg, __FILE__, __LINE__)
-#define LOGF LogMessage(QtFatalMsg, __FILE__, __LINE__)
+#define LOG_IF_ENABLED(type) if (!Logger::isEnabled(type)) {} else LogMessage(type, __FILE__, __LINE__)
+
+#define LOGD LOG_IF_ENABLED(QtDebugMsg)
+#define LOGI LOG_IF_ENABLED(QtInfoMsg)
+#define LOGW LOG_IF_ENABLED(QtWarningMsg)
+#define LOGE LOG_IF_ENABLED(QtCriticalMsg)
+#define LOGF LOG_IF_ENABLED(QtFatalMsg)
 
 #endif // LOGGING_H
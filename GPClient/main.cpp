@@ -13,6 +13,8 @@
 #include "vpn_json.h"
 #include "enhancedwebview.h"
 #include "version.h"
+#include "taskexecutor.h"
+#include "settingsmanager.h"
 
 #define QT_AUTO_SCREEN_SCALE_FACTOR "QT_AUTO_SCREEN_SCALE_FACTOR"
 
@@ -39,6 +41,9 @@ int main(int argc, char *argv[])
         return 0;
     }
     
+    SettingsManager &settings = SettingsManager::instance();
+    Logger::configure(settings.logLevel(), settings.logToFile() ? settings.logFilePath() : QString());
+
     // Set application icon globally
     app.setWindowIcon(QIcon(":/images/com.qt.gpclient.svg"));
     
@@ -54,6 +59,7 @@ int main(int argc, char *argv[])
       {"now", "Do not show the dialog with the connect button; connect immediately instead."},
       {"start-minimized", "Launch the client minimized."},
       {"reset", "Reset the client's settings."},
+      {"trace", "Record the phases of each connection attempt, including those of gpservice, and write them to <file> as Chrome trace-event JSON.", "file"},
     });
     parser.process(app);
 
@@ -90,6 +96,10 @@ int main(int argc, char *argv[])
         QObject::connect(static_cast<VpnJson*>(vpn.get()), &VpnJson::connected, &w, &ModernGPClient::quit);
     }
 
+    if (parser.isSet("trace")) {
+        w.setTraceFile(parser.value("trace"));
+    }
+
     if (parser.isSet("reset")) {
         w.reset();
     }
@@ -102,5 +112,9 @@ int main(int argc, char *argv[])
       w.show();
     }
 
-    return app.exec();
+    const int ret = app.exec();
+    // The keychain writes still queued, the TLS sessions saved on quit
+    TaskExecutor::instance().waitForDone();
+    Logger::flush();
+    return ret;
 }
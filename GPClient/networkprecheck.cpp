@@ -0,0 +1,262 @@
+#include "networkprecheck.h"
+#include <QHostInfo>
+#include <QNetworkAccessManager>
+#include <QNetworkInterface>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QTcpSocket>
+#include "settingsmanager.h"
+#include "logging.h"
+
+NetworkPrecheck::NetworkPrecheck(QObject *parent)
+    : QObject(parent)
+    , m_manager(new QNetworkAccessManager(this))
+    , m_deadline(new QTimer(this))
+{
+    m_deadline->setSingleShot(true);
+    m_deadline->setInterval(DEADLINE_MS);
+    connect(m_deadline, &QTimer::timeout, this, [this]() {
+        LOGD << "Network precheck deadline reached";
+        evaluate(true);
+    });
+}
+
+NetworkPrecheck::~NetworkPrecheck()
+{
+    abort();
+}
+
+void NetworkPrecheck::check(const QString &portalAddress)
+{
+    abort();
+
+    m_portal = portalAddress;
+    m_probe = Outcome::Pending;
+    m_dns = Outcome::Pending;
+    m_tcp = Outcome::Pending;
+    m_dnsAnswered = false;
+    m_probeStatus = 0;
+    m_captiveUrl.clear();
+    m_span = Tracer::begin("network.precheck");
+
+    // Nothing to wait for without an address
+    if (!hasUsableInterface()) {
+        finish(Reachability::Offline);
+        return;
+    }
+
+    const QUrl url("https://" + portalAddress);
+    m_running = true;
+    m_deadline->start();
+    startProbe();
+    startLookup(url.host());
+    startConnect(url.host(), quint16(url.port(443)));
+}
+
+void NetworkPrecheck::abort()
+{
+    m_running = false;
+    m_deadline->stop();
+    release();
+    if (m_span) {
+        Tracer::end(m_span, "aborted");
+        m_span = 0;
+    }
+}
+
+void NetworkPrecheck::startProbe()
+{
+    const QUrl url(SettingsManager::instance().connectivityCheckUrl());
+    if (!url.isValid() || url.isEmpty()) {
+        m_probe = Outcome::Skipped;
+        return;
+    }
+
+    // The redirect of a captive portal is the answer, it is not followed
+    QNetworkRequest request(url);
+    request.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::ManualRedirectPolicy);
+    request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+
+    m_probeReply = m_manager->get(request);
+    connect(m_probeReply, &QNetworkReply::finished, this, [this, reply = m_probeReply]() {
+        reply->deleteLater();
+        if (reply != m_probeReply) {
+            return;
+        }
+        m_probeReply = nullptr;
+
+        const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        m_probeStatus = status;
+        if (status == 204) {
+            m_probe = Outcome::Succeeded;
+        } else if (status > 0) {
+            m_probe = Outcome::Intercepted;
+            const QUrl location = reply->attribute(QNetworkRequest::RedirectionTargetAttribute).toUrl();
+            m_captiveUrl = location.isEmpty() ? reply->url() : reply->url().resolved(location);
+        } else {
+            m_probe = Outcome::Failed;
+        }
+        LOGD << "Connectivity check: HTTP " << status << " " << reply->errorString();
+        evaluate(false);
+    });
+}
+
+void NetworkPrecheck::startLookup(const QString &host)
+{
+    m_lookupId = QHostInfo::lookupHost(host, this, [this](const QHostInfo &info) {
+        if (info.lookupId() != m_lookupId) {
+            return;
+        }
+        m_lookupId = -1;
+
+        if (info.error() == QHostInfo::NoError && !info.addresses().isEmpty()) {
+            m_dns = Outcome::Succeeded;
+        } else {
+            m_dns = Outcome::Failed;
+            m_dnsAnswered = info.error() == QHostInfo::HostNotFound;
+        }
+        LOGD << "Portal lookup: " << info.addresses().size() << " address(es) " << info.errorString();
+        evaluate(false);
+    });
+}
+
+void NetworkPrecheck::startConnect(const QString &host, quint16 port)
+{
+    m_socket = new QTcpSocket(this);
+    connect(m_socket, &QTcpSocket::connected, this, [this]() {
+        m_tcp = Outcome::Succeeded;
+        m_socket->abort();
+        evaluate(false);
+    });
+    connect(m_socket, &QTcpSocket::errorOccurred, this, [this]() {
+        if (m_tcp != Outcome::Pending) {
+            return;
+        }
+        m_tcp = Outcome::Failed;
+        LOGD << "Portal connect: " << m_socket->errorString();
+        evaluate(false);
+    });
+    m_socket->connectToHost(host, port);
+}
+
+/* Final: the deadline passed, what is still pending is not coming */
+void NetworkPrecheck::evaluate(bool final)
+{
+    if (!isRunning()) {
+        return;
+    }
+
+    // A proxy, a block page or a filtered check URL answer as well: only a portal that cannot be
+    // connected to either is behind a captive portal, otherwise the authentication goes on with a
+    // warning. A connect still pending at the deadline is a slow link, not a failure
+    if (m_probe == Outcome::Intercepted) {
+        if (m_tcp == Outcome::Failed) {
+            finish(Reachability::Captive);
+        } else if (m_tcp == Outcome::Succeeded) {
+            finish(Reachability::Reachable);
+        } else if (final) {
+            finish(Reachability::Unknown);
+        }
+        return;
+    }
+    if (m_probe == Outcome::Succeeded && m_dns == Outcome::Succeeded) {
+        finish(Reachability::Reachable);
+        return;
+    }
+    if (m_probe == Outcome::Succeeded && m_dns == Outcome::Failed) {
+        finish(Reachability::DnsBroken);
+        return;
+    }
+    // The connectivity check could still reveal a captive portal answering for the portal
+    if (m_tcp == Outcome::Succeeded && (m_probe != Outcome::Pending || final)) {
+        finish(Reachability::Reachable);
+        return;
+    }
+
+    const bool done = m_probe != Outcome::Pending && m_dns != Outcome::Pending && m_tcp != Outcome::Pending;
+    if (!done && !final) {
+        return;
+    }
+
+    // A resolver that answers is there, one that does not is as good as no network. With the
+    // portal resolved, a refused connect and a failed check say nothing about the network itself
+    if (m_dns == Outcome::Failed && m_tcp != Outcome::Succeeded) {
+        finish(m_dnsAnswered ? Reachability::DnsBroken : Reachability::Offline);
+    } else {
+        finish(Reachability::Unknown);
+    }
+}
+
+void NetworkPrecheck::finish(Reachability reachability)
+{
+    m_running = false;
+    m_deadline->stop();
+    release();
+
+    const QString message = messageOf(reachability);
+    LOGI << "Network precheck of " << m_portal << ": " << QVariant::fromValue(reachability).toString();
+    Tracer::end(m_span, QVariant::fromValue(reachability).toString());
+    m_span = 0;
+
+    emit finished(reachability, message);
+}
+
+void NetworkPrecheck::release()
+{
+    if (m_probeReply) {
+        QNetworkReply *reply = m_probeReply;
+        m_probeReply = nullptr;
+        reply->abort();
+    }
+    if (m_lookupId >= 0) {
+        QHostInfo::abortHostLookup(m_lookupId);
+        m_lookupId = -1;
+    }
+    if (m_socket) {
+        m_socket->disconnect(this);
+        m_socket->abort();
+        m_socket->deleteLater();
+        m_socket = nullptr;
+    }
+}
+
+QString NetworkPrecheck::messageOf(Reachability reachability) const
+{
+    switch (reachability) {
+        case Reachability::Offline:
+            return "This computer is not connected to a network. Connect to a network and try again.";
+        case Reachability::Captive:
+            return QString("This network requires signing in before it can be used. Sign in with a web browser%1 and try again.")
+                .arg(m_captiveUrl.isEmpty() ? QString() : " at " + m_captiveUrl.toString());
+        case Reachability::DnsBroken:
+            return QString("The portal %1 cannot be found, the DNS servers of this network are not answering for it.").arg(m_portal);
+        case Reachability::Reachable:
+        case Reachability::Unknown:
+            // Only a warning, the portal is tried anyway
+            if (m_probe == Outcome::Intercepted) {
+                return QString("The connectivity check was answered with HTTP %1, this network may filter or proxy the traffic.")
+                    .arg(m_probeStatus);
+            }
+            break;
+    }
+    return QString();
+}
+
+/* An interface that is up with an address beyond loopback and link-local */
+bool NetworkPrecheck::hasUsableInterface()
+{
+    const QList<QNetworkInterface> interfaces = QNetworkInterface::allInterfaces();
+    for (const QNetworkInterface &interface : interfaces) {
+        const auto flags = interface.flags();
+        if (!(flags & QNetworkInterface::IsUp) || !(flags & QNetworkInterface::IsRunning) || (flags & QNetworkInterface::IsLoopBack)) {
+            continue;
+        }
+        for (const QNetworkAddressEntry &entry : interface.addressEntries()) {
+            const QHostAddress ip = entry.ip();
+            if (!ip.isLoopback() && !ip.isLinkLocal()) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
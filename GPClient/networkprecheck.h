@@ -0,0 +1,96 @@
+#ifndef NETWORKPRECHECK_H
+#define NETWORKPRECHECK_H
+
+#include <QObject>
+#include <QTimer>
+#include <QUrl>
+#include "tracer.h"
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class QTcpSocket;
+
+/*
+ * Tells, before the portal is authenticated, whether it can be reached at
+ * all.
+ *
+ * Three checks race under a sub-second deadline: an HTTP request to the
+ * connectivity check URL, that only a network without a captive portal
+ * answers with 204, the DNS lookup of the portal and a TCP connect to its
+ * port. The verdict is given as soon as the results allow it. A connectivity
+ * check answered by someone else only means a captive portal when the
+ * portal cannot be connected to either; a proxy or a filter answering it is
+ * reported as a warning with a reachable portal, or with an Unknown network
+ * when the connect to the portal is still pending. Without a
+ * clear answer by the deadline the network is Unknown and the
+ * authentication goes on as usual, the check never holds it up for long.
+ */
+class NetworkPrecheck : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum class Reachability {
+        Reachable,
+        Offline,
+        Captive,
+        DnsBroken,
+        Unknown
+    };
+    Q_ENUM(Reachability)
+
+    explicit NetworkPrecheck(QObject *parent = nullptr);
+    ~NetworkPrecheck();
+
+    bool isRunning() const { return m_running; }
+
+    void check(const QString &portalAddress);
+    void abort();
+
+signals:
+    // With a message for the user when the portal cannot be reached, or a warning when it can
+    void finished(NetworkPrecheck::Reachability reachability, const QString &message);
+
+private:
+    static constexpr int DEADLINE_MS = 800;
+
+    enum class Outcome {
+        Pending,
+        Succeeded,
+        Failed,
+        // The connectivity check was answered by someone else, a captive portal
+        Intercepted,
+        Skipped
+    };
+
+    QNetworkAccessManager *m_manager;
+    QTimer *m_deadline;
+    bool m_running { false };
+    QString m_portal;
+    Tracer::SpanId m_span { 0 };
+
+    QNetworkReply *m_probeReply { nullptr };
+    Outcome m_probe { Outcome::Pending };
+    int m_probeStatus { 0 };
+    // Where the captive portal sends the browser
+    QUrl m_captiveUrl;
+
+    int m_lookupId { -1 };
+    Outcome m_dns { Outcome::Pending };
+    // The resolver answered, the name is unknown to it
+    bool m_dnsAnswered { false };
+
+    QTcpSocket *m_socket { nullptr };
+    Outcome m_tcp { Outcome::Pending };
+
+    void startProbe();
+    void startLookup(const QString &host);
+    void startConnect(const QString &host, quint16 port);
+    void evaluate(bool final);
+    void finish(Reachability reachability);
+    void release();
+    QString messageOf(Reachability reachability) const;
+    static bool hasUsableInterface();
+};
+
+#endif // NETWORKPRECHECK_H
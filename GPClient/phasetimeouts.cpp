@@ -0,0 +1,95 @@
+#include "phasetimeouts.h"
+#include <QtMath>
+#include <algorithm>
+#include "settingsmanager.h"
+#include "logging.h"
+
+PhaseTimeouts& PhaseTimeouts::instance()
+{
+    static PhaseTimeouts instance;
+    return instance;
+}
+
+int PhaseTimeouts::timeoutMs(Phase phase, const QString &address)
+{
+    const Limits limits = limitsOf(phase);
+    const int backoff = m_backoffMs.value(keyOf(phase, address), 0);
+    QList<int> sorted = history(phase, address);
+    if (sorted.size() < MIN_SAMPLES) {
+        return std::max(limits.defaultMs, backoff);
+    }
+
+    std::sort(sorted.begin(), sorted.end());
+    // Nearest rank
+    const int rank = qCeil(0.99 * sorted.size()) - 1;
+    const int p99 = sorted.at(std::clamp(rank, 0, int(sorted.size()) - 1));
+    const int timeout = std::max(std::clamp(int(p99 * MARGIN), limits.floorMs, limits.ceilingMs), backoff);
+
+    LOGD << "Deadline of " << nameOf(phase) << " on " << address << ": " << timeout << " ms (p99 " << p99 << " ms of " << sorted.size() << ")";
+    return timeout;
+}
+
+void PhaseTimeouts::recordSuccess(Phase phase, const QString &address, qint64 durationMs)
+{
+    m_backoffMs.remove(keyOf(phase, address));
+    record(phase, address, int(std::min<qint64>(durationMs, limitsOf(phase).ceilingMs)));
+}
+
+void PhaseTimeouts::recordTimeout(Phase phase, const QString &address, int timeoutMs)
+{
+    // Censored, only the next attempt gets more time, see the class comment
+    const int next = std::min(timeoutMs * 2, limitsOf(phase).ceilingMs);
+    m_backoffMs.insert(keyOf(phase, address), next);
+    LOGI << nameOf(phase) << " on " << address << " timed out after " << timeoutMs << " ms, the next attempt gets " << next << " ms";
+}
+
+void PhaseTimeouts::record(Phase phase, const QString &address, int durationMs)
+{
+    if (address.isEmpty()) {
+        return;
+    }
+
+    QList<int> &samples = history(phase, address);
+    samples << durationMs;
+    while (samples.size() > MAX_SAMPLES) {
+        samples.removeFirst();
+    }
+    SettingsManager::instance().setPhaseDurations(nameOf(phase), address, samples);
+}
+
+QString PhaseTimeouts::keyOf(Phase phase, const QString &address)
+{
+    return nameOf(phase) + "/" + address;
+}
+
+QList<int> &PhaseTimeouts::history(Phase phase, const QString &address)
+{
+    const QString key = keyOf(phase, address);
+    auto it = m_history.find(key);
+    if (it == m_history.end()) {
+        it = m_history.insert(key, SettingsManager::instance().phaseDurations(nameOf(phase), address));
+    }
+    return *it;
+}
+
+PhaseTimeouts::Limits PhaseTimeouts::limitsOf(Phase phase)
+{
+    switch (phase) {
+        case Phase::PortalAuth:
+        case Phase::GatewayAuth:
+            return { 60000, 10000, 120000 };
+        case Phase::Tunnel:
+            return { 30000, 10000, 120000 };
+    }
+    return { 30000, 10000, 120000 };
+}
+
+QString PhaseTimeouts::nameOf(Phase phase)
+{
+    switch (phase) {
+        case Phase::PortalAuth:  return "portalAuth";
+        case Phase::GatewayAuth: return "gatewayAuth";
+        case Phase::Tunnel:      return "tunnel";
+    }
+    return "unknown";
+}
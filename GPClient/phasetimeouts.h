@@ -0,0 +1,74 @@
+#ifndef PHASETIMEOUTS_H
+#define PHASETIMEOUTS_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+
+/*
+ * The deadlines of the connection phases, learned per server.
+ *
+ * The duration of every successful phase is kept, the last MAX_SAMPLES of
+ * each server and phase. Once MIN_SAMPLES are known, the deadline is the
+ * 99th percentile times MARGIN, within the floor and ceiling of the phase:
+ * a hung attempt on a fast gateway fails early, a slow gateway still gets
+ * the time it usually needs.
+ *
+ * A timed out attempt is censored: it only tells that the phase took longer
+ * than the deadline, not how long, so it is kept out of the samples. Counting
+ * the deadline as a duration would make it the 99th percentile, and every
+ * timeout would raise the next deadline up to the ceiling, a dead gateway
+ * then taking longer and longer to fail.
+ *
+ * Only the next attempt gets more time: after a timeout its deadline is
+ * twice the one that passed, up to the ceiling, until the phase succeeds
+ * again. A slow but healthy gateway can then finish, and be learned, the
+ * attempt that usually times out; a dead one backs off to the ceiling and
+ * is forgotten on restart.
+ */
+class PhaseTimeouts
+{
+public:
+    enum class Phase {
+        PortalAuth,
+        GatewayAuth,
+        Tunnel
+    };
+
+    static PhaseTimeouts& instance();
+
+    int timeoutMs(Phase phase, const QString &address);
+    void recordSuccess(Phase phase, const QString &address, qint64 durationMs);
+    void recordTimeout(Phase phase, const QString &address, int timeoutMs);
+
+private:
+    PhaseTimeouts() = default;
+    ~PhaseTimeouts() = default;
+
+    PhaseTimeouts(const PhaseTimeouts&) = delete;
+    PhaseTimeouts& operator=(const PhaseTimeouts&) = delete;
+
+    struct Limits {
+        // Until MIN_SAMPLES are known
+        int defaultMs;
+        int floorMs;
+        int ceilingMs;
+    };
+
+    static Limits limitsOf(Phase phase);
+    static QString nameOf(Phase phase);
+    static QString keyOf(Phase phase, const QString &address);
+    QList<int> &history(Phase phase, const QString &address);
+    void record(Phase phase, const QString &address, int durationMs);
+
+    static constexpr int MAX_SAMPLES = 50;
+    static constexpr int MIN_SAMPLES = 5;
+    static constexpr double MARGIN = 1.5;
+
+    // Loaded from the settings on first use
+    QHash<QString, QList<int>> m_history;
+    // The deadline of the next attempt after a timeout, cleared by a success
+    QHash<QString, int> m_backoffMs;
+};
+
+#endif // PHASETIMEOUTS_H
@@ -9,6 +9,7 @@
 #include "preloginresponse.h"
 #include "portalconfigresponse.h"
 #include "gpgateway.h"
+#include "taskexecutor.h"
 
 using namespace gpclient::helper;
 
@@ -34,13 +35,27 @@ void PortalAuthenticator::authenticate()
 
     LOGI << QString("(%1/%2) attempts").arg(attempts).arg(MAX_ATTEMPTS) << ", preform portal prelogin at " << preloginUrl;
 
+    preloginSpan = Tracer::begin("portal.prelogin");
     QNetworkReply *reply = createRequest(preloginUrl);
     connect(reply, &QNetworkReply::finished, this, &PortalAuthenticator::onPreloginFinished);
 }
 
+void PortalAuthenticator::setInteractive(bool interactive)
+{
+    this->interactive = interactive;
+}
+
+void PortalAuthenticator::setUserAuthCookie(const QString &username, const QString &userAuthCookie)
+{
+    this->cookieUsername = username;
+    this->userAuthCookie = userAuthCookie;
+}
+
 void PortalAuthenticator::onPreloginFinished()
 {
     auto *reply = qobject_cast<QNetworkReply*>(sender());
+    Tracer::end(preloginSpan, reply->errorString());
+    preloginSpan = 0;
 
     if (reply->error()) {
         LOGE << QString("Error occurred while accessing %1, %2").arg(preloginUrl, reply->errorString());
@@ -55,6 +70,21 @@ void PortalAuthenticator::onPreloginFinished()
 
     LOGI << "Finished parsing the prelogin response. The region field is: " << preloginResponse.region();
 
+    const bool knownResponse = preloginResponse.hasSamlAuthFields() || preloginResponse.hasNormalAuthFields();
+    if (knownResponse && !userAuthCookie.isEmpty()) {
+        // A single getconfig.esp instead of the login, see onFetchConfigFinished() when rejected
+        LOGI << "Trying the saved portal-userauthcookie of " << cookieUsername;
+        isCookieLogin = true;
+        fetchConfig(cookieUsername, "", "", userAuthCookie);
+    } else {
+        startLogin();
+    }
+
+    delete reply;
+}
+
+void PortalAuthenticator::startLogin()
+{
     if (preloginResponse.hasSamlAuthFields()) {
         // Do SAML authentication
         samlAuth();
@@ -65,8 +95,6 @@ void PortalAuthenticator::onPreloginFinished()
         LOGE << QString("Unknown prelogin response for %1 got %2").arg(preloginUrl).arg(QString::fromUtf8(preloginResponse.rawResponse()));
         emit preloginFailed("Unknown response for portal prelogin interface.");
     }
-
-    delete reply;
 }
 
 void PortalAuthenticator::tryAutoLogin()
@@ -85,6 +113,12 @@ void PortalAuthenticator::tryAutoLogin()
 
 void PortalAuthenticator::normalAuth()
 {
+    if (!interactive) {
+        LOGI << "The portal requires a login, not possible without interaction";
+        emitFail("Login required.");
+        return;
+    }
+
     LOGI << "Trying to launch the normal login window...";
 
     standardLoginWindow = new StandardLoginWindow {portal, preloginResponse.labelUsername(), preloginResponse.labelPassword(), preloginResponse.authMessage() };
@@ -94,6 +128,7 @@ void PortalAuthenticator::normalAuth()
     connect(standardLoginWindow, &StandardLoginWindow::rejected, this, &PortalAuthenticator::onLoginWindowRejected);
     connect(standardLoginWindow, &StandardLoginWindow::finished, this, &PortalAuthenticator::onLoginWindowFinished);
 
+    emit interactionStarted();
     standardLoginWindow->show();
 }
 
@@ -116,6 +151,12 @@ void PortalAuthenticator::onLoginWindowFinished()
 
 void PortalAuthenticator::samlAuth()
 {
+    if (!interactive) {
+        LOGI << "The portal requires a SAML login, not possible without interaction";
+        emitFail("Login required.");
+        return;
+    }
+
     LOGI << "Trying to perform SAML login with saml-method " << preloginResponse.samlMethod();
 
     auto *loginWindow = new SAMLLoginWindow;
@@ -133,6 +174,7 @@ void PortalAuthenticator::samlAuth()
         loginWindow->deleteLater();
     });
 
+    emit interactionStarted();
     loginWindow->login(preloginResponse.samlMethod(), preloginResponse.samlRequest(), preloginUrl);
 }
 
@@ -172,6 +214,7 @@ void PortalAuthenticator::fetchConfig(QString username, QString password, QStrin
 
     LOGI << "Fetching the portal config from " << configUrl;
 
+    configSpan = Tracer::begin("portal.getconfig");
     auto *reply = createRequest(configUrl, loginParams.toUtf8());
     connect(reply, &QNetworkReply::finished, this, &PortalAuthenticator::onFetchConfigFinished);
 }
@@ -179,10 +222,20 @@ void PortalAuthenticator::fetchConfig(QString username, QString password, QStrin
 void PortalAuthenticator::onFetchConfigFinished()
 {
     QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+    Tracer::end(configSpan, reply->errorString());
+    configSpan = 0;
 
     if (reply->error()) {
         LOGE << QString("Failed to fetch the portal config from %1, %2").arg(configUrl).arg(reply->errorString());
 
+        if (isCookieLogin) {
+            isCookieLogin = false;
+            userAuthCookie.clear();
+            emit userAuthCookieRejected();
+            startLogin();
+            return;
+        }
+
         // Login failed, enable the fields of the normal login window
         if (standardLoginWindow) {
             standardLoginWindow->setProcessing(false);
@@ -197,20 +250,25 @@ void PortalAuthenticator::onFetchConfigFinished()
     }
 
     LOGI << "Fetch the portal config succeeded.";
-    PortalConfigResponse response = PortalConfigResponse::parse(reply->readAll());
 
-    // Add the username & password to the response object
-    response.setUsername(username);
-    response.setPassword(password);
+    // A portal with many gateways sends a large configuration, parsed off the GUI thread
+    const QByteArray xml = reply->readAll();
+    TaskExecutor::instance().run([xml]() {
+        return PortalConfigResponse::parse(xml);
+    }).then(this, [this](PortalConfigResponse response) {
+        // Add the username & password to the response object
+        response.setUsername(username);
+        response.setPassword(password);
 
-    // Close the login window
-    if (standardLoginWindow) {
-        LOGI << "Closing the StandardLoginWindow...";
+        // Close the login window
+        if (standardLoginWindow) {
+            LOGI << "Closing the StandardLoginWindow...";
 
-        standardLoginWindow->close();
-    }
+            standardLoginWindow->close();
+        }
 
-    emit success(response, preloginResponse.region());
+        emit success(response, preloginResponse.region());
+    });
 }
 
 void PortalAuthenticator::emitFail(const QString& msg)
@@ -7,6 +7,7 @@
 #include "standardloginwindow.h"
 #include "samlloginwindow.h"
 #include "preloginresponse.h"
+#include "tracer.h"
 
 
 class PortalAuthenticator : public QObject
@@ -17,12 +18,20 @@ public:
     ~PortalAuthenticator();
 
     void authenticate();
+    // Without interaction the authentication fails instead of showing a login window
+    void setInteractive(bool interactive);
+    // A portal-userauthcookie of an earlier login, tried before asking for a login
+    void setUserAuthCookie(const QString &username, const QString &userAuthCookie);
 
 signals:
     void success(const PortalConfigResponse response, const QString region);
     void fail(const QString& msg);
     void preloginFailed(const QString& msg);
     void portalConfigFailed(const QString msg);
+    // The portal did not accept the cookie given to setUserAuthCookie()
+    void userAuthCookieRejected();
+    // A login window is shown, the time of the user is not a network delay
+    void interactionStarted();
 
 private slots:
     void onPreloginFinished();
@@ -47,9 +56,18 @@ private:
     PreloginResponse preloginResponse;
 
     bool isAutoLogin{ false };
+    bool interactive{ true };
+
+    QString cookieUsername;
+    QString userAuthCookie;
+    bool isCookieLogin{ false };
 
     StandardLoginWindow *standardLoginWindow { nullptr };
 
+    Tracer::SpanId preloginSpan { 0 };
+    Tracer::SpanId configSpan { 0 };
+
+    void startLogin();
     void tryAutoLogin();
     void normalAuth();
     void samlAuth();
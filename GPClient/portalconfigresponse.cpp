@@ -1,4 +1,5 @@
 #include <QtCore/QXmlStreamReader>
+#include <QtCore/QJsonArray>
 #include "logging.h"
 
 #include "portalconfigresponse.h"
@@ -6,6 +7,8 @@
 QString PortalConfigResponse::xmlUserAuthCookie = "portal-userauthcookie";
 QString PortalConfigResponse::xmlPrelogonUserAuthCookie = "portal-prelogonuserauthcookie";
 QString PortalConfigResponse::xmlGateways = "gateways";
+QString PortalConfigResponse::xmlRefreshInterval = "refresh-config-interval";
+QString PortalConfigResponse::xmlConnectMethod = "connect-method";
 
 PortalConfigResponse::PortalConfigResponse()
 {
@@ -36,6 +39,12 @@ PortalConfigResponse PortalConfigResponse::parse(const QByteArray xml)
             response.setPrelogonUserAuthCookie(xmlReader.readElementText());
         } else if (name == xmlGateways) {
             response.setAllGateways(parseGateways(xmlReader));
+        } else if (name == xmlRefreshInterval) {
+            response.m_refreshInterval = xmlReader.readElementText().toInt();
+        } else if (name == xmlConnectMethod) {
+            response.m_connectMethod = xmlReader.readElementText();
+        } else if (name.endsWith("-lifetime")) {
+            response.m_cookieLifetimes.insert(name, xmlReader.readElementText(QXmlStreamReader::SkipChildElements).toInt());
         }
     }
 
@@ -138,6 +147,11 @@ QString PortalConfigResponse::userAuthCookie() const
     return m_userAuthCookie;
 }
 
+QString PortalConfigResponse::prelogonUserAuthCookie() const
+{
+    return m_prelogonAuthCookie;
+}
+
 QList<GPGateway> PortalConfigResponse::allGateways() const
 {
     return m_gateways;
@@ -148,6 +162,65 @@ void PortalConfigResponse::setAllGateways(QList<GPGateway> gateways)
     m_gateways = gateways;
 }
 
+int PortalConfigResponse::refreshInterval() const
+{
+    return m_refreshInterval;
+}
+
+QString PortalConfigResponse::connectMethod() const
+{
+    return m_connectMethod;
+}
+
+QMap<QString, int> PortalConfigResponse::cookieLifetimes() const
+{
+    return m_cookieLifetimes;
+}
+
+QJsonObject PortalConfigResponse::toJsonObject() const
+{
+    QJsonArray gateways;
+    for (const auto &gateway : m_gateways) {
+        gateways.append(gateway.toJsonObject());
+    }
+
+    QJsonObject lifetimes;
+    for (auto it = m_cookieLifetimes.cbegin(); it != m_cookieLifetimes.cend(); ++it) {
+        lifetimes.insert(it.key(), it.value());
+    }
+
+    QJsonObject obj;
+    obj.insert("username", m_username);
+    obj.insert("gateways", gateways);
+    obj.insert("refreshInterval", m_refreshInterval);
+    obj.insert("connectMethod", m_connectMethod);
+    obj.insert("cookieLifetimes", lifetimes);
+
+    return obj;
+}
+
+PortalConfigResponse PortalConfigResponse::fromJsonObject(const QJsonObject &obj)
+{
+    PortalConfigResponse response;
+
+    QList<GPGateway> gateways;
+    for (const auto &item : obj.value("gateways").toArray()) {
+        gateways.append(GPGateway::fromJsonObject(item.toObject()));
+    }
+
+    const QJsonObject lifetimes = obj.value("cookieLifetimes").toObject();
+    for (auto it = lifetimes.constBegin(); it != lifetimes.constEnd(); ++it) {
+        response.m_cookieLifetimes.insert(it.key(), it.value().toInt());
+    }
+
+    response.setUsername(obj.value("username").toString());
+    response.setAllGateways(gateways);
+    response.m_refreshInterval = obj.value("refreshInterval").toInt();
+    response.m_connectMethod = obj.value("connectMethod").toString();
+
+    return response;
+}
+
 void PortalConfigResponse::setRawResponse(const QByteArray response)
 {
     m_rawResponse = response;
@@ -3,6 +3,8 @@
 
 #include <QtCore/QString>
 #include <QtCore/QList>
+#include <QtCore/QMap>
+#include <QtCore/QJsonObject>
 #include <QtCore/QXmlStreamReader>
 
 #include "gpgateway.h"
@@ -19,9 +21,20 @@ public:
     const QString &username() const;
     QString password() const;
     QString userAuthCookie() const;
+    QString prelogonUserAuthCookie() const;
     QList<GPGateway> allGateways() const;
     void setAllGateways(QList<GPGateway> gateways);
 
+    // How often the portal wants its configuration fetched again, in hours, 0 when not given
+    int refreshInterval() const;
+    QString connectMethod() const;
+    // The cookie lifetimes announced by the portal (the *-lifetime elements), by element name
+    QMap<QString, int> cookieLifetimes() const;
+
+    // The part of the configuration that can be cached: no cookie nor password
+    QJsonObject toJsonObject() const;
+    static PortalConfigResponse fromJsonObject(const QJsonObject &obj);
+
     void setUsername(const QString username);
     void setPassword(const QString password);
 
@@ -29,6 +42,8 @@ private:
     static QString xmlUserAuthCookie;
     static QString xmlPrelogonUserAuthCookie;
     static QString xmlGateways;
+    static QString xmlRefreshInterval;
+    static QString xmlConnectMethod;
 
     QByteArray m_rawResponse;
     QString m_username;
@@ -37,6 +52,9 @@ private:
     QString m_prelogonAuthCookie;
 
     QList<GPGateway> m_gateways;
+    int m_refreshInterval { 0 };
+    QString m_connectMethod;
+    QMap<QString, int> m_cookieLifetimes;
 
     void setRawResponse(const QByteArray response);
     void setUserAuthCookie(const QString cookie);
@@ -29,12 +29,15 @@ SAMLLoginWindow::SAMLLoginWindow(QWidget *parent)
             return;
         }
         LOGI << "MAX_WAIT_TIME exceeded, display the login window.";
+        Tracer::instant("saml.window.shown");
         this->show();
     });
 }
 
 void SAMLLoginWindow::closeEvent(QCloseEvent *event)
 {
+    Tracer::end(loginSpan, "closed");
+    loginSpan = 0;
     event->accept();
     reject();
 }
@@ -42,6 +45,7 @@ void SAMLLoginWindow::closeEvent(QCloseEvent *event)
 void SAMLLoginWindow::login(const QString samlMethod, const QString samlRequest, const QString preloginUrl)
 {
     webView->page()->profile()->cookieStore()->deleteSessionCookies();
+    loginSpan = Tracer::begin("saml.login");
 
     if (samlMethod == "POST") {
         webView->setHtml(samlRequest, preloginUrl);
@@ -51,6 +55,8 @@ void SAMLLoginWindow::login(const QString samlMethod, const QString samlRequest,
     } else {
         LOGE << "Unknown saml-auth-method expected POST or REDIRECT, got " << samlMethod;
         failed = true;
+        Tracer::end(loginSpan, "unknown saml-auth-method");
+        loginSpan = 0;
         emit fail("ERR001", "Unknown saml-auth-method, got " + samlMethod);
     }
 }
@@ -99,6 +105,8 @@ void SAMLLoginWindow::checkSamlResult(QString username, QString preloginCookie,
              << ", preloginCookie: " << samlResult.value("preloginCookie")
              << ", userAuthCookie: " << samlResult.value("userAuthCookie");
 
+        Tracer::end(loginSpan);
+        loginSpan = 0;
         emit success(samlResult);
         accept();
     }
@@ -124,6 +132,8 @@ void SAMLLoginWindow::handleHtml(const QString &html)
     } else if (samlAuthStatus == "-1") {
         LOGI << "SAML authentication failed...";
         failed = true;
+        Tracer::end(loginSpan, "authentication failed");
+        loginSpan = 0;
         emit fail("ERR002", "Authentication failed, please try again.");
     } else {
         show();
@@ -6,6 +6,7 @@
 #include <QtWidgets/QDialog>
 
 #include "enhancedwebview.h"
+#include "tracer.h"
 
 class SAMLLoginWindow : public QDialog
 {
@@ -31,6 +32,8 @@ private:
     bool failed { false };
     EnhancedWebView *webView { nullptr };
     QMap<QString, QString> samlResult;
+    // From login() to the result, including the time the user spends in the window
+    Tracer::SpanId loginSpan { 0 };
 
     void closeEvent(QCloseEvent *event);
     void handleHtml(const QString &html);
@@ -1,9 +1,12 @@
 #include "settingsmanager.h"
 #include "gphelper.h"
+#include "taskexecutor.h"
 #include <QStandardPaths>
 #include <QDir>
 #include <QSysInfo>
 #include <QMutexLocker>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include "logging.h"
 
 using namespace gpclient::helper;
@@ -145,6 +148,21 @@ QString SettingsManager::selectedGatewayKey(const QString &portalAddress) const
     return QString("gateways/%1/selected").arg(QString(portalAddress).replace("/", "_"));
 }
 
+QString SettingsManager::portalConfigKey(const QString &portalAddress) const
+{
+    return QString("portalConfig/%1").arg(QString(portalAddress).replace("/", "_"));
+}
+
+QString SettingsManager::phaseDurationsKey(const QString &phase, const QString &address) const
+{
+    return QString("phaseDurations/%1/%2").arg(QString(address).replace("/", "_"), phase);
+}
+
+QString SettingsManager::userAuthCookieKey(const QString &portalAddress, const QString &username) const
+{
+    return QString("userAuthCookie/%1/%2").arg(portalAddress, username);
+}
+
 QList<GPGateway> SettingsManager::gateways(const QString &portalAddress) const
 {
     QMutexLocker locker(&m_mutex);
@@ -201,6 +219,97 @@ void SettingsManager::setCurrentGateway(const QString &portalAddress, const GPGa
     LOGI << "Set current gateway to: " << gateway.name() << " for portal: " << portalAddress;
 }
 
+bool SettingsManager::CachedPortalConfig::isStale() const
+{
+    return secondsToStale() <= 0;
+}
+
+qint64 SettingsManager::CachedPortalConfig::secondsToStale() const
+{
+    if (!isValid()) {
+        return 0;
+    }
+
+    const int hours = config.refreshInterval() > 0 ? config.refreshInterval() : DEFAULT_REFRESH_INTERVAL_HOURS;
+    return qint64(hours) * 3600 - fetchedAt.secsTo(QDateTime::currentDateTimeUtc());
+}
+
+SettingsManager::CachedPortalConfig SettingsManager::cachedPortalConfig(const QString &portalAddress) const
+{
+    QMutexLocker locker(&m_mutex);
+    CachedPortalConfig cached;
+
+    const QString key = portalConfigKey(portalAddress);
+    const QString user = m_settings->value(key + "/lastUser", "").toString();
+    const QString userKey = key + "/users/" + QString(user).replace("/", "_");
+    const QByteArray json = m_settings->value(userKey + "/config", "").toString().toUtf8();
+
+    if (json.isEmpty()) {
+        return cached;
+    }
+
+    cached.config = PortalConfigResponse::fromJsonObject(QJsonDocument::fromJson(json).object());
+    cached.region = m_settings->value(userKey + "/region", "").toString();
+    cached.fetchedAt = m_settings->value(userKey + "/fetchedAt").toDateTime();
+
+    return cached;
+}
+
+bool SettingsManager::setCachedPortalConfig(const QString &portalAddress, const PortalConfigResponse &config, const QString &region)
+{
+    QMutexLocker locker(&m_mutex);
+
+    const QString key = portalConfigKey(portalAddress);
+    const QString userKey = key + "/users/" + QString(config.username()).replace("/", "_");
+    const QString json = QString::fromUtf8(QJsonDocument(config.toJsonObject()).toJson(QJsonDocument::Compact));
+
+    const bool changed = m_settings->value(userKey + "/config", "").toString() != json
+        || m_settings->value(userKey + "/region", "").toString() != region;
+
+    m_settings->setValue(key + "/lastUser", config.username());
+    m_settings->setValue(userKey + "/fetchedAt", QDateTime::currentDateTimeUtc());
+    if (changed) {
+        m_settings->setValue(userKey + "/config", json);
+        m_settings->setValue(userKey + "/region", region);
+        LOGI << "Cached the configuration of portal " << portalAddress << " for user " << config.username();
+    }
+
+    return changed;
+}
+
+void SettingsManager::clearCachedPortalConfig(const QString &portalAddress)
+{
+    QMutexLocker locker(&m_mutex);
+    m_settings->remove(portalConfigKey(portalAddress));
+}
+
+QList<int> SettingsManager::phaseDurations(const QString &phase, const QString &address) const
+{
+    QMutexLocker locker(&m_mutex);
+    QList<int> durations;
+
+    const QStringList values = m_settings->value(phaseDurationsKey(phase, address)).toStringList();
+    for (const auto &value : values) {
+        bool ok = false;
+        const int duration = value.toInt(&ok);
+        if (ok && duration > 0) {
+            durations << duration;
+        }
+    }
+
+    return durations;
+}
+
+void SettingsManager::setPhaseDurations(const QString &phase, const QString &address, const QList<int> &durations)
+{
+    QMutexLocker locker(&m_mutex);
+    QStringList values;
+    for (int duration : durations) {
+        values << QString::number(duration);
+    }
+    m_settings->setValue(phaseDurationsKey(phase, address), values);
+}
+
 bool SettingsManager::hasStoredCredentials() const
 {
     QString username, password;
@@ -218,24 +327,28 @@ QString SettingsManager::storedUsername() const
 
 void SettingsManager::storeCredentials(const QString &username, const QString &password)
 {
-    try {
-        settings::secureSave("username", username);
-        settings::secureSave("password", password);
-        LOGI << "Credentials stored securely for user: " << username;
-    } catch (const std::exception &e) {
-        LOGE << "Failed to store credentials: " << e.what();
-    }
+    TaskExecutor::instance().runIo([username, password]() {
+        try {
+            settings::secureSave("username", username);
+            settings::secureSave("password", password);
+            LOGI << "Credentials stored securely for user: " << username;
+        } catch (const std::exception &e) {
+            LOGE << "Failed to store credentials: " << e.what();
+        }
+    });
 }
 
 void SettingsManager::clearStoredCredentials()
 {
-    try {
-        settings::secureSave("username", "");
-        settings::secureSave("password", "");
-        LOGI << "Stored credentials cleared";
-    } catch (const std::exception &e) {
-        LOGW << "Failed to clear credentials: " << e.what();
-    }
+    TaskExecutor::instance().runIo([]() {
+        try {
+            settings::secureSave("username", "");
+            settings::secureSave("password", "");
+            LOGI << "Stored credentials cleared";
+        } catch (const std::exception &e) {
+            LOGW << "Failed to clear credentials: " << e.what();
+        }
+    });
 }
 
 bool SettingsManager::getStoredCredentials(QString &username, QString &password) const
@@ -252,6 +365,64 @@ bool SettingsManager::getStoredCredentials(QString &username, QString &password)
     }
 }
 
+void SettingsManager::storeUserAuthCookie(const QString &portalAddress, const QString &username,
+                                          const QString &userAuthCookie, const QString &prelogonUserAuthCookie, int lifetimeHours)
+{
+    QJsonObject obj;
+    obj.insert("userAuthCookie", userAuthCookie);
+    obj.insert("prelogonUserAuthCookie", prelogonUserAuthCookie);
+    obj.insert("expiresAt", QDateTime::currentDateTimeUtc().addSecs(qint64(lifetimeHours) * 3600).toString(Qt::ISODate));
+
+    const QString value = QString::fromUtf8(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+    const QString key = userAuthCookieKey(portalAddress, username);
+    TaskExecutor::instance().runIo([key, value, username, lifetimeHours]() {
+        if (settings::secureSave(key, value)) {
+            LOGI << "Stored the portal cookie of " << username << " for " << lifetimeHours << " hour(s)";
+        } else {
+            LOGW << "Failed to store the portal cookie in the keychain";
+        }
+    });
+}
+
+bool SettingsManager::storedUserAuthCookie(const QString &portalAddress, const QString &username,
+                                           QString &userAuthCookie, QString &prelogonUserAuthCookie) const
+{
+    QString value;
+    if (username.isEmpty() || !settings::secureGet(userAuthCookieKey(portalAddress, username), value) || value.isEmpty()) {
+        return false;
+    }
+
+    const QJsonObject obj = QJsonDocument::fromJson(value.toUtf8()).object();
+    const QDateTime expiresAt = QDateTime::fromString(obj.value("expiresAt").toString(), Qt::ISODate);
+    if (!expiresAt.isValid() || expiresAt <= QDateTime::currentDateTimeUtc()) {
+        LOGI << "The stored portal cookie of " << username << " expired";
+        return false;
+    }
+
+    userAuthCookie = obj.value("userAuthCookie").toString();
+    prelogonUserAuthCookie = obj.value("prelogonUserAuthCookie").toString();
+    return !userAuthCookie.isEmpty() || !prelogonUserAuthCookie.isEmpty();
+}
+
+QFuture<SettingsManager::StoredUserAuthCookie> SettingsManager::loadUserAuthCookie(const QString &portalAddress, const QString &username) const
+{
+    return TaskExecutor::instance().runIo([this, portalAddress, username]() {
+        StoredUserAuthCookie stored;
+        storedUserAuthCookie(portalAddress, username, stored.userAuthCookie, stored.prelogonUserAuthCookie);
+        return stored;
+    });
+}
+
+void SettingsManager::clearUserAuthCookie(const QString &portalAddress, const QString &username)
+{
+    const QString key = userAuthCookieKey(portalAddress, username);
+    TaskExecutor::instance().runIo([key]() {
+        if (!settings::secureSave(key, "")) {
+            LOGW << "Failed to clear the portal cookie in the keychain";
+        }
+    });
+}
+
 QByteArray SettingsManager::mainWindowGeometry() const
 {
     QMutexLocker locker(&m_mutex);
@@ -301,6 +472,18 @@ void SettingsManager::setLogFilePath(const QString &path)
     m_settings->setValue("logging/filePath", path);
 }
 
+QString SettingsManager::connectivityCheckUrl() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_settings->value("network/connectivityCheckUrl", DEFAULT_CONNECTIVITY_CHECK_URL).toString();
+}
+
+void SettingsManager::setConnectivityCheckUrl(const QString &url)
+{
+    QMutexLocker locker(&m_mutex);
+    m_settings->setValue("network/connectivityCheckUrl", url);
+}
+
 void SettingsManager::resetAll()
 {
     QMutexLocker locker(&m_mutex);
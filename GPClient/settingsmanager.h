@@ -4,8 +4,11 @@
 #include <QObject>
 #include <QSettings>
 #include <QMutex>
+#include <QDateTime>
+#include <QFuture>
 #include <memory>
 #include "gpgateway.h"
+#include "portalconfigresponse.h"
 
 class SettingsManager : public QObject
 {
@@ -36,19 +39,55 @@ public:
     
     GPGateway currentGateway(const QString &portalAddress) const;
     void setCurrentGateway(const QString &portalAddress, const GPGateway &gateway);
+
+    // Portal configuration cache, one entry per portal and user, the last user of the portal is looked up
+    struct CachedPortalConfig {
+        PortalConfigResponse config;
+        QString region;
+        QDateTime fetchedAt;
+
+        bool isValid() const { return fetchedAt.isValid(); }
+        // Older than the refresh interval of the portal
+        bool isStale() const;
+        qint64 secondsToStale() const;
+    };
+    CachedPortalConfig cachedPortalConfig(const QString &portalAddress) const;
+    // Returns whether the configuration differs from the cached one, only the fetch time is renewed otherwise
+    bool setCachedPortalConfig(const QString &portalAddress, const PortalConfigResponse &config, const QString &region);
+    void clearCachedPortalConfig(const QString &portalAddress);
+
+    // The last durations of a connection phase on a server, in milliseconds, see PhaseTimeouts
+    QList<int> phaseDurations(const QString &phase, const QString &address) const;
+    void setPhaseDurations(const QString &phase, const QString &address, const QList<int> &durations);
     
-    // Credential management (secure storage)
+    // Credential management (secure storage), the writes are done off the GUI thread, see TaskExecutor::runIo()
     bool hasStoredCredentials() const;
     QString storedUsername() const;
     void storeCredentials(const QString &username, const QString &password);
     void clearStoredCredentials();
     bool getStoredCredentials(QString &username, QString &password) const;
+
+    // The portal-userauthcookie and portal-prelogonuserauthcookie of a user, in the keychain with their expiry
+    struct StoredUserAuthCookie {
+        QString userAuthCookie;
+        QString prelogonUserAuthCookie;
+
+        bool isValid() const { return !userAuthCookie.isEmpty() || !prelogonUserAuthCookie.isEmpty(); }
+    };
+    void storeUserAuthCookie(const QString &portalAddress, const QString &username,
+                             const QString &userAuthCookie, const QString &prelogonUserAuthCookie, int lifetimeHours);
+    // False when nothing is stored or the cookies expired
+    bool storedUserAuthCookie(const QString &portalAddress, const QString &username,
+                              QString &userAuthCookie, QString &prelogonUserAuthCookie) const;
+    // storedUserAuthCookie() off the GUI thread, after the keychain writes already submitted
+    QFuture<StoredUserAuthCookie> loadUserAuthCookie(const QString &portalAddress, const QString &username) const;
+    void clearUserAuthCookie(const QString &portalAddress, const QString &username);
     
     // Window geometry
     QByteArray mainWindowGeometry() const;
     void setMainWindowGeometry(const QByteArray &geometry);
     
-    // Logging settings
+    // Logging settings, applied at startup, see Logger::configure()
     int logLevel() const;
     void setLogLevel(int level);
     
@@ -57,6 +96,10 @@ public:
     
     QString logFilePath() const;
     void setLogFilePath(const QString &path);
+
+    // Answered with 204 by a network without a captive portal, empty to skip that check, see NetworkPrecheck
+    QString connectivityCheckUrl() const;
+    void setConnectivityCheckUrl(const QString &url);
     
     // Reset all settings
     void resetAll();
@@ -80,6 +123,9 @@ private:
     void initializeDefaults();
     QString gatewaysKey(const QString &portalAddress) const;
     QString selectedGatewayKey(const QString &portalAddress) const;
+    QString portalConfigKey(const QString &portalAddress) const;
+    QString phaseDurationsKey(const QString &phase, const QString &address) const;
+    QString userAuthCookieKey(const QString &portalAddress, const QString &username) const;
     
     std::unique_ptr<QSettings> m_settings;
     mutable QMutex m_mutex;
@@ -90,6 +136,9 @@ private:
     static constexpr bool DEFAULT_START_MINIMIZED = false;
     static constexpr bool DEFAULT_AUTO_CONNECT = false;
     static constexpr bool DEFAULT_LOG_TO_FILE = false;
+    static constexpr const char* DEFAULT_CONNECTIVITY_CHECK_URL = "http://connectivitycheck.gstatic.com/generate_204";
+    // When the portal does not give a refresh-config-interval
+    static constexpr int DEFAULT_REFRESH_INTERVAL_HOURS = 24;
 };
 
 #endif // SETTINGSMANAGER_H
\ No newline at end of file
@@ -0,0 +1,40 @@
+#include "stallmonitor.h"
+#include <QTimer>
+#include <algorithm>
+
+StallMonitor::StallMonitor(QObject *parent)
+    : QObject(parent)
+    , m_ticker(new QTimer(this))
+{
+    m_ticker->setTimerType(Qt::PreciseTimer);
+    m_ticker->setInterval(TICK_MS);
+    connect(m_ticker, &QTimer::timeout, this, &StallMonitor::onTick);
+}
+
+void StallMonitor::start()
+{
+    m_longestStallMs = 0;
+    m_sinceTick.start();
+    m_ticker->start();
+}
+
+qint64 StallMonitor::stop()
+{
+    if (m_ticker->isActive()) {
+        // A stall still going on
+        onTick();
+        m_ticker->stop();
+    }
+    return m_longestStallMs;
+}
+
+bool StallMonitor::isRunning() const
+{
+    return m_ticker->isActive();
+}
+
+void StallMonitor::onTick()
+{
+    const qint64 stall = m_sinceTick.restart() - TICK_MS;
+    m_longestStallMs = std::max(m_longestStallMs, stall);
+}
@@ -0,0 +1,38 @@
+#ifndef STALLMONITOR_H
+#define STALLMONITOR_H
+
+#include <QObject>
+#include <QElapsedTimer>
+
+class QTimer;
+
+/*
+ * Measures how long the GUI thread stops handling events.
+ *
+ * While running, a timer is due every TICK_MS: a tick arriving late means
+ * the event loop was blocked for the delay. The longest delay is kept until
+ * stop(), one connect attempt.
+ */
+class StallMonitor : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit StallMonitor(QObject *parent = nullptr);
+
+    void start();
+    // Returns the longest stall since start(), in milliseconds
+    qint64 stop();
+    bool isRunning() const;
+
+private:
+    static constexpr int TICK_MS = 10;
+
+    QTimer *m_ticker;
+    QElapsedTimer m_sinceTick;
+    qint64 m_longestStallMs { 0 };
+
+    void onTick();
+};
+
+#endif // STALLMONITOR_H
@@ -3,6 +3,9 @@
 #include "standardloginwindow.h"
 #include "ui_standardloginwindow.h"
 #include "gphelper.h"
+#include "settingsmanager.h"
+#include "taskexecutor.h"
+#include <utility>
 
 using namespace gpclient::helper;
 
@@ -24,14 +27,20 @@ StandardLoginWindow::StandardLoginWindow(const QString &portalAddress, const QSt
 }
 
 void StandardLoginWindow::autocomplete() {
-    QString username, password;
-    settings::secureGet("username", username);
-    settings::secureGet("password", password);
-
-    if (!username.isEmpty() && !password.isEmpty()) {
-        ui->username->setText(username);
-        ui->password->setText(password);
-    }
+    // The keychain is read off the GUI thread, the fields are left alone once the user typed in them
+    TaskExecutor::instance().runIo([]() {
+        std::pair<QString, QString> credentials;
+        settings::secureGet("username", credentials.first);
+        settings::secureGet("password", credentials.second);
+        return credentials;
+    }).then(this, [this](const std::pair<QString, QString> &credentials) {
+        if (credentials.first.isEmpty() || credentials.second.isEmpty()
+            || !ui->username->text().isEmpty() || !ui->password->text().isEmpty()) {
+            return;
+        }
+        ui->username->setText(credentials.first);
+        ui->password->setText(credentials.second);
+    });
 }
 
 void StandardLoginWindow::setProcessing(bool isProcessing) {
@@ -48,8 +57,8 @@ void StandardLoginWindow::on_loginButton_clicked() {
         return;
     }
 
-    settings::secureSave("username", username);
-    settings::secureSave("password", password);
+    // Written off the GUI thread, see TaskExecutor
+    SettingsManager::instance().storeCredentials(username, password);
 
     emit performLogin(username, password);
 }
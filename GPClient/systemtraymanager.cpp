@@ -79,9 +79,12 @@ void SystemTrayManager::updateGatewayMenu(const QList<GPGateway> &gateways, cons
         return;
     }
     
-    // Add gateway options
+    // Add gateway options, in the order ranked by GatewayProber
     for (const auto &gateway : gateways) {
         QString actionText = QString("%1 (%2)").arg(gateway.name(), gateway.address());
+        if (gateway.latency() >= 0) {
+            actionText += QString(" - %1 ms").arg(gateway.latency());
+        }
         QAction *gatewayAction = m_gatewayMenu->addAction(actionText);
         gatewayAction->setData(QVariant::fromValue(gateway));
         gatewayAction->setCheckable(true);
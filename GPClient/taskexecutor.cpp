@@ -0,0 +1,22 @@
+#include "taskexecutor.h"
+
+TaskExecutor& TaskExecutor::instance()
+{
+    static TaskExecutor instance;
+    return instance;
+}
+
+TaskExecutor::TaskExecutor()
+{
+    m_pool.setMaxThreadCount(MAX_THREADS);
+    m_pool.setObjectName("gpclient-worker");
+
+    m_ioPool.setMaxThreadCount(1);
+    m_ioPool.setObjectName("gpclient-io");
+}
+
+void TaskExecutor::waitForDone()
+{
+    m_pool.waitForDone();
+    m_ioPool.waitForDone();
+}
@@ -0,0 +1,56 @@
+#ifndef TASKEXECUTOR_H
+#define TASKEXECUTOR_H
+
+#include <QFuture>
+#include <QThreadPool>
+#include <QtConcurrentRun>
+#include <utility>
+
+/*
+ * Runs the work that would stall the GUI thread: parsing the portal
+ * configuration, and the keychain access whose jobs spin an event loop until
+ * the secret service answers.
+ *
+ * The result is taken back on the GUI thread with a continuation bound to a
+ * receiver, dropped when the receiver is destroyed first:
+ *
+ *     TaskExecutor::instance().run([data]() { return parse(data); })
+ *         .then(this, [this](Result result) { ... });
+ *
+ * The keychain and settings I/O go through runIo(), one task at a time in
+ * the order they are submitted: a read sees the writes submitted before it.
+ */
+class TaskExecutor
+{
+public:
+    static TaskExecutor& instance();
+
+    template <typename Work>
+    auto run(Work &&work)
+    {
+        return QtConcurrent::run(&m_pool, std::forward<Work>(work));
+    }
+
+    template <typename Work>
+    auto runIo(Work &&work)
+    {
+        return QtConcurrent::run(&m_ioPool, std::forward<Work>(work));
+    }
+
+    // Before exit, so that no write is lost
+    void waitForDone();
+
+private:
+    TaskExecutor();
+    ~TaskExecutor() = default;
+
+    TaskExecutor(const TaskExecutor&) = delete;
+    TaskExecutor& operator=(const TaskExecutor&) = delete;
+
+    static constexpr int MAX_THREADS = 2;
+
+    QThreadPool m_pool;
+    QThreadPool m_ioPool;
+};
+
+#endif // TASKEXECUTOR_H
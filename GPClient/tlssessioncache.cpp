@@ -0,0 +1,197 @@
+#include "tlssessioncache.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <memory>
+#include "gphelper.h"
+#include "logging.h"
+
+using namespace gpclient::helper;
+
+static const QString keychainKey = "tlsSessionKey";
+
+TlsSessionCache::TlsSessionCache(const QString &path)
+    : m_path(path)
+{
+}
+
+void TlsSessionCache::load()
+{
+    m_entries.clear();
+
+    QFile file(m_path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    QByteArray plain;
+    if (!loadKey(false) || !decrypt(m_key, file.readAll(), plain)) {
+        LOGW << "Could not decrypt the saved TLS sessions, starting without them";
+        return;
+    }
+
+    const QDateTime now = QDateTime::currentDateTimeUtc();
+    const QJsonObject hosts = QJsonDocument::fromJson(plain).object();
+    for (auto it = hosts.constBegin(); it != hosts.constEnd(); ++it) {
+        const QJsonObject obj = it.value().toObject();
+
+        Entry entry;
+        entry.ticket = QByteArray::fromBase64(obj.value("ticket").toString().toLatin1());
+        entry.expiresAt = QDateTime::fromString(obj.value("expiresAt").toString(), Qt::ISODate);
+        if (!entry.ticket.isEmpty() && entry.expiresAt > now) {
+            m_entries.insert(it.key(), entry);
+        }
+    }
+
+    LOGI << "Loaded " << m_entries.size() << " saved TLS session(s)";
+}
+
+void TlsSessionCache::save()
+{
+    if (!loadKey(true)) {
+        LOGW << "No key for the TLS sessions in the keychain, not saving them";
+        return;
+    }
+
+    QJsonObject hosts;
+    for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
+        QJsonObject obj;
+        obj.insert("ticket", QString::fromLatin1(it->ticket.toBase64()));
+        obj.insert("expiresAt", it->expiresAt.toString(Qt::ISODate));
+        hosts.insert(it.key(), obj);
+    }
+
+    const QByteArray data = encrypt(m_key, QJsonDocument(hosts).toJson(QJsonDocument::Compact));
+    if (data.isEmpty()) {
+        return;
+    }
+
+    QDir().mkpath(QFileInfo(m_path).absolutePath());
+    QSaveFile file(m_path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        LOGW << "Could not write the TLS sessions to " << m_path;
+        return;
+    }
+    file.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+    file.write(data);
+    file.commit();
+}
+
+QByteArray TlsSessionCache::ticket(const QString &host) const
+{
+    auto it = m_entries.constFind(host);
+    if (it == m_entries.constEnd() || it->expiresAt <= QDateTime::currentDateTimeUtc()) {
+        return QByteArray();
+    }
+    return it->ticket;
+}
+
+bool TlsSessionCache::store(const QString &host, const QByteArray &ticket, int lifetimeHintSeconds)
+{
+    if (host.isEmpty() || ticket.isEmpty() || m_entries.value(host).ticket == ticket) {
+        return false;
+    }
+
+    Entry entry;
+    entry.ticket = ticket;
+    entry.expiresAt = QDateTime::currentDateTimeUtc().addSecs(lifetimeHintSeconds > 0 ? lifetimeHintSeconds : DEFAULT_LIFETIME_S);
+    m_entries.insert(host, entry);
+    return true;
+}
+
+void TlsSessionCache::merge(const TlsSessionCache &loaded)
+{
+    for (auto it = loaded.m_entries.cbegin(); it != loaded.m_entries.cend(); ++it) {
+        if (!m_entries.contains(it.key())) {
+            m_entries.insert(it.key(), it.value());
+        }
+    }
+    if (m_key.isEmpty()) {
+        m_key = loaded.m_key;
+    }
+}
+
+bool TlsSessionCache::loadKey(bool create)
+{
+    if (m_key.size() == KEY_SIZE) {
+        return true;
+    }
+
+    QString encoded;
+    if (settings::secureGet(keychainKey, encoded) && !encoded.isEmpty()) {
+        m_key = QByteArray::fromBase64(encoded.toLatin1());
+        return m_key.size() == KEY_SIZE;
+    }
+
+    if (!create) {
+        return false;
+    }
+
+    QByteArray key(KEY_SIZE, Qt::Uninitialized);
+    if (RAND_bytes(reinterpret_cast<unsigned char *>(key.data()), KEY_SIZE) != 1
+        || !settings::secureSave(keychainKey, QString::fromLatin1(key.toBase64()))) {
+        return false;
+    }
+
+    m_key = key;
+    return true;
+}
+
+// nonce | ciphertext | tag
+QByteArray TlsSessionCache::encrypt(const QByteArray &key, const QByteArray &plain)
+{
+    std::unique_ptr<EVP_CIPHER_CTX, decltype(&EVP_CIPHER_CTX_free)> ctx(EVP_CIPHER_CTX_new(), EVP_CIPHER_CTX_free);
+    QByteArray out(NONCE_SIZE + plain.size() + TAG_SIZE, Qt::Uninitialized);
+    auto *nonce = reinterpret_cast<unsigned char *>(out.data());
+    auto *cipher = nonce + NONCE_SIZE;
+    int length = 0;
+    int finalLength = 0;
+
+    if (!ctx
+        || RAND_bytes(nonce, NONCE_SIZE) != 1
+        || EVP_EncryptInit_ex(ctx.get(), EVP_aes_256_gcm(), nullptr,
+                              reinterpret_cast<const unsigned char *>(key.constData()), nonce) != 1
+        || EVP_EncryptUpdate(ctx.get(), cipher, &length,
+                             reinterpret_cast<const unsigned char *>(plain.constData()), int(plain.size())) != 1
+        || EVP_EncryptFinal_ex(ctx.get(), cipher + length, &finalLength) != 1
+        || EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_GET_TAG, TAG_SIZE, cipher + length + finalLength) != 1) {
+        LOGW << "Could not encrypt the TLS sessions";
+        return QByteArray();
+    }
+
+    return out;
+}
+
+bool TlsSessionCache::decrypt(const QByteArray &key, const QByteArray &data, QByteArray &plain)
+{
+    if (data.size() < NONCE_SIZE + TAG_SIZE) {
+        return false;
+    }
+
+    std::unique_ptr<EVP_CIPHER_CTX, decltype(&EVP_CIPHER_CTX_free)> ctx(EVP_CIPHER_CTX_new(), EVP_CIPHER_CTX_free);
+    const auto *nonce = reinterpret_cast<const unsigned char *>(data.constData());
+    const auto *cipher = nonce + NONCE_SIZE;
+    const int cipherLength = int(data.size()) - NONCE_SIZE - TAG_SIZE;
+    QByteArray tag = data.right(TAG_SIZE);
+    QByteArray out(cipherLength, Qt::Uninitialized);
+    int length = 0;
+    int finalLength = 0;
+
+    if (!ctx
+        || EVP_DecryptInit_ex(ctx.get(), EVP_aes_256_gcm(), nullptr,
+                              reinterpret_cast<const unsigned char *>(key.constData()), nonce) != 1
+        || EVP_DecryptUpdate(ctx.get(), reinterpret_cast<unsigned char *>(out.data()), &length, cipher, cipherLength) != 1
+        || EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_SET_TAG, TAG_SIZE, tag.data()) != 1
+        || EVP_DecryptFinal_ex(ctx.get(), reinterpret_cast<unsigned char *>(out.data()) + length, &finalLength) != 1) {
+        return false;
+    }
+
+    out.truncate(length + finalLength);
+    plain = out;
+    return true;
+}
@@ -0,0 +1,55 @@
+#ifndef TLSSESSIONCACHE_H
+#define TLSSESSIONCACHE_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QHash>
+#include <QString>
+
+/*
+ * The TLS sessions of the portal and gateways, kept on disk so the first
+ * connection after a restart resumes the session instead of running a
+ * full handshake.
+ *
+ * A session (QSslConfiguration::sessionTicket()) holds the master secret of
+ * the connection: the file is encrypted with AES-256-GCM under a random key
+ * kept in the keychain. Without the key, or when the file does not decrypt,
+ * the cache starts empty.
+ */
+class TlsSessionCache
+{
+public:
+    explicit TlsSessionCache(const QString &path);
+
+    void load();
+    void save();
+    QString path() const { return m_path; }
+
+    QByteArray ticket(const QString &host) const;
+    // Returns whether the ticket of the host changed
+    bool store(const QString &host, const QByteArray &ticket, int lifetimeHintSeconds);
+    // Takes the sessions and key of a cache loaded aside, the sessions stored since are kept
+    void merge(const TlsSessionCache &loaded);
+
+private:
+    // When the server gives no lifetime hint
+    static constexpr int DEFAULT_LIFETIME_S = 2 * 3600;
+    static constexpr int KEY_SIZE = 32;
+    static constexpr int NONCE_SIZE = 12;
+    static constexpr int TAG_SIZE = 16;
+
+    struct Entry {
+        QByteArray ticket;
+        QDateTime expiresAt;
+    };
+
+    QString m_path;
+    QByteArray m_key;
+    QHash<QString, Entry> m_entries;
+
+    bool loadKey(bool create);
+    static QByteArray encrypt(const QByteArray &key, const QByteArray &plain);
+    static bool decrypt(const QByteArray &key, const QByteArray &data, QByteArray &plain);
+};
+
+#endif // TLSSESSIONCACHE_H
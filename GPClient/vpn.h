@@ -2,6 +2,8 @@
 #define VPN_H
 #include <QtCore/QObject>
 #include <QtCore/QString>
+#include <QtCore/QJsonArray>
+#include <functional>
 
 class IVpn
 {
@@ -10,11 +12,17 @@ public:
 
     virtual void connect(const QString &preferredServer, const QList<QString> &servers, const QString &username, const QString &passwd) = 0;
     virtual void disconnect() = 0;
+    // Moves the running tunnel to another gateway, without going through a disconnect
+    virtual void switchGateway(const QString &server, const QString &username, const QString &passwd) = 0;
     virtual int status() = 0;
+    // The spans recorded by the tunnel backend for a trace, see Tracer, handed to handler once they arrive
+    virtual void traceEvents(const QString &traceId, const std::function<void(const QJsonArray &)> &handler) = 0;
 
 // signals: // SIGNALS
 //     virtual void connected();
 //     virtual void disconnected();
+//     virtual void switched(const QString &server);
+//     virtual void switchFailed(const QString &errorMessage);
 //     virtual void error(const QString &errorMessage);
 //     virtual void logAvailable(const QString &log);
 };
@@ -1,13 +1,101 @@
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+
 #include "vpn_dbus.h"
+#include "tracer.h"
+#include "gatewayresolver.h"
 
 void VpnDbus::connect(const QString &preferredServer, const QList<QString> &servers, const QString &username, const QString &passwd) {
-    inner->connect(preferredServer, username, passwd);
+    QVariantMap options;
+
+    // The service records its phases under the trace of the client
+    const QString traceId = Tracer::currentTrace();
+    if (!traceId.isEmpty()) {
+        options.insert("traceId", traceId);
+    }
+
+    // openconnect skips its own lookup of the gateways already resolved
+    const QStringList resolve = GatewayResolver::instance().resolveEntries(QStringList { preferredServer } + servers);
+    if (!resolve.isEmpty()) {
+        options.insert("resolve", resolve);
+    }
+
+    // The service goes on with the other gateways when the preferred one cannot be set up
+    QStringList candidates;
+    for (const QString &server : servers) {
+        if (!server.isEmpty() && server != preferredServer && !candidates.contains(server)) {
+            candidates << server;
+        }
+    }
+    if (!candidates.isEmpty()) {
+        options.insert("candidates", candidates);
+    }
+
+    if (options.isEmpty()) {
+        inner->connect(preferredServer, username, passwd);
+        return;
+    }
+    inner->connectWithOptions(preferredServer, username, passwd, options);
 }
 
 void VpnDbus::disconnect() {
     inner->disconnect();
 }
 
+void VpnDbus::switchGateway(const QString &server, const QString &username, const QString &passwd) {
+    inner->switchGateway(server, username, passwd);
+}
+
 int VpnDbus::status() {
     return inner->status();
 }
+
+void VpnDbus::traceEvents(const QString &traceId, const std::function<void(const QJsonArray &)> &handler) {
+    // Not waited for, the GUI thread keeps running while the service answers
+    auto *watcher = new QDBusPendingCallWatcher(inner->getTrace(traceId), this);
+    QObject::connect(watcher, &QDBusPendingCallWatcher::finished, this, [handler](QDBusPendingCallWatcher *call) {
+        QDBusPendingReply<QString> reply = *call;
+        call->deleteLater();
+        if (reply.isError()) {
+            handler(QJsonArray());
+            return;
+        }
+        handler(QJsonDocument::fromJson(reply.value().toUtf8()).object().value("traceEvents").toArray());
+    });
+}
+
+void VpnDbus::subscribeLogs() {
+    inner->subscribeLogs();
+    // Catch up with the history, e.g. after the client was restarted
+    fetchLogs();
+}
+
+void VpnDbus::fetchLogs() {
+    auto *watcher = new QDBusPendingCallWatcher(inner->getLogs(lastLogSeq, LOG_BATCH_SIZE), this);
+    QObject::connect(watcher, &QDBusPendingCallWatcher::finished, this, [this](QDBusPendingCallWatcher *call) {
+        QDBusPendingReply<QVariantMap> reply = *call;
+        call->deleteLater();
+        if (reply.isError()) {
+            return;
+        }
+
+        const QVariantMap batch = reply.value();
+        const QStringList lines = batch.value("lines").toStringList();
+        onLogsAvailable(batch.value("first").toULongLong(), lines);
+
+        if (!lines.isEmpty() && lastLogSeq < batch.value("latest").toULongLong()) {
+            fetchLogs();
+        }
+    });
+}
+
+void VpnDbus::onLogsAvailable(qulonglong firstSeq, const QStringList &lines) {
+    // The live batches and the history may overlap, skip what was already seen
+    for (int i = 0; i < lines.size(); i++) {
+        const qulonglong seq = firstSeq + i;
+        if (seq > lastLogSeq) {
+            lastLogSeq = seq;
+            emit logAvailable(lines.at(i));
+        }
+    }
+}
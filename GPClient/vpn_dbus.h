@@ -1,5 +1,7 @@
 #ifndef VPN_DBUS_H
 #define VPN_DBUS_H
+#include <QtDBus/QDBusServiceWatcher>
+#include <QtDBus/QDBusPendingCallWatcher>
 #include "vpn.h"
 #include "gpserviceinterface.h"
 
@@ -9,7 +11,18 @@ class VpnDbus : public QObject, public IVpn
   Q_INTERFACES(IVpn)
 
 private:
+  static const int LOG_BATCH_SIZE { 512 };
+
   com::pacha::qt::GPService *inner;
+  QDBusServiceWatcher *serviceWatcher;
+  // The sequence number of the last log entry received from the service
+  qulonglong lastLogSeq { 0 };
+
+  void subscribeLogs();
+  void fetchLogs();
+
+private slots:
+  void onLogsAvailable(qulonglong firstSeq, const QStringList &lines);
 
 public:
   VpnDbus(QObject *parent) : QObject(parent) {
@@ -20,18 +33,36 @@ public:
       QObject::connect(inner, &com::pacha::qt::GPService::connected, this, &VpnDbus::connected);
       QObject::connect(inner, &com::pacha::qt::GPService::disconnected, this, &VpnDbus::disconnected);
       QObject::connect(inner, &com::pacha::qt::GPService::error, this, &VpnDbus::error);
-      QObject::connect(inner, &com::pacha::qt::GPService::logAvailable, this, &VpnDbus::logAvailable);
+      QObject::connect(inner, &com::pacha::qt::GPService::gatewaySwitched, this, &VpnDbus::switched);
+      QObject::connect(inner, &com::pacha::qt::GPService::switchFailed, this, &VpnDbus::switchFailed);
+      QObject::connect(inner, &com::pacha::qt::GPService::failingOver, this, &VpnDbus::failingOver);
+      QObject::connect(inner, &com::pacha::qt::GPService::gatewayAuthRequired, this, &VpnDbus::authRequired);
+      QObject::connect(inner, &com::pacha::qt::GPService::logsAvailable, this, &VpnDbus::onLogsAvailable);
+      subscribeLogs();
     }
+
+    // The subscription and the log sequence do not survive a service restart
+    serviceWatcher = new QDBusServiceWatcher("com.qt.GPService", QDBusConnection::systemBus(), QDBusServiceWatcher::WatchForRegistration, this);
+    QObject::connect(serviceWatcher, &QDBusServiceWatcher::serviceRegistered, this, [this]() {
+      lastLogSeq = 0;
+      subscribeLogs();
+    });
   }
 
   void connect(const QString &preferredServer, const QList<QString> &servers, const QString &username, const QString &passwd);
   void disconnect();
+  void switchGateway(const QString &server, const QString &username, const QString &passwd);
   int status();
+  void traceEvents(const QString &traceId, const std::function<void(const QJsonArray &)> &handler);
 
 signals: // SIGNALS
   void connected();
   void disconnected();
   void error(QString errorMessage);
+  void switched(QString server);
+  void switchFailed(QString errorMessage);
+  void failingOver(QString server);
+  void authRequired(QString server);
   void logAvailable(QString log);
 };
 #endif
@@ -19,6 +19,21 @@ void VpnJson::connect(const QString &preferredServer, const QList<QString> &serv
 
 void VpnJson::disconnect() { /* nop */ }
 
+// The consumer of the JSON output owns the tunnel, it is handed the new gateway like a connect
+void VpnJson::switchGateway(const QString &server, const QString &username, const QString &passwd) {
+    QJsonObject j;
+    j["server"] = server;
+    j["availableServers"] = QJsonArray { server };
+    j["cookie"] = passwd;
+    QTextStream(stdout) << QJsonDocument(j).toJson(QJsonDocument::Compact) << "\n";
+    emit switched(server);
+}
+
 int VpnJson::status() {
     return 4; // disconnected
 }
+
+// The tunnel is not run by gpservice, there is nothing to add to the trace
+void VpnJson::traceEvents(const QString &traceId, const std::function<void(const QJsonArray &)> &handler) {
+    handler(QJsonArray());
+}
@@ -12,12 +12,16 @@ public:
 
   void connect(const QString &preferredServer, const QList<QString> &servers, const QString &username, const QString &passwd);
   void disconnect();
+  void switchGateway(const QString &server, const QString &username, const QString &passwd);
   int status();
+  void traceEvents(const QString &traceId, const std::function<void(const QJsonArray &)> &handler);
 
 signals: // SIGNALS
   void connected();
   void disconnected();
   void error(const QString &errorMessage);
+  void switched(const QString &server);
+  void switchFailed(const QString &errorMessage);
   void logAvailable(const QString &log);
 };
 #endif
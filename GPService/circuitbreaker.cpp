@@ -0,0 +1,55 @@
+#include "circuitbreaker.h"
+
+CircuitBreaker::CircuitBreaker()
+{
+    clock.start();
+}
+
+bool CircuitBreaker::allow(const QString &gateway)
+{
+    auto it = states.constFind(gateway);
+    if (it == states.constEnd() || it->openedAt < 0) {
+        return true;
+    }
+
+    return clock.elapsed() - it->openedAt >= COOLDOWN_MS;
+}
+
+qint64 CircuitBreaker::retryDelay(const QString &gateway)
+{
+    auto it = states.constFind(gateway);
+    if (it == states.constEnd() || it->openedAt < 0) {
+        return 0;
+    }
+
+    return qMax<qint64>(0, it->openedAt + COOLDOWN_MS - clock.elapsed());
+}
+
+void CircuitBreaker::recordFailure(const QString &gateway)
+{
+    State &state = states[gateway];
+    const qint64 now = clock.elapsed();
+
+    // A failure while half-open opens the circuit again right away
+    if (state.openedAt >= 0) {
+        state.openedAt = now;
+        return;
+    }
+
+    if (state.failures == 0 || now - state.windowStart > WINDOW_MS) {
+        state.failures = 0;
+        state.windowStart = now;
+    }
+
+    if (++state.failures >= FAILURE_THRESHOLD) {
+        state.openedAt = now;
+    }
+}
+
+void CircuitBreaker::recordSuccess(const QString &gateway)
+{
+    auto it = states.find(gateway);
+    if (it != states.end() && it->openedAt >= 0) {
+        states.erase(it);
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef CIRCUITBREAKER_H
+#define CIRCUITBREAKER_H
+
+#include <QtCore/QHash>
+#include <QtCore/QString>
+#include <QtCore/QElapsedTimer>
+
+/*
+ * Per-gateway circuit breaker for the automatic reconnects.
+ *
+ * Too many failures within the window open the circuit, and no reconnect is
+ * attempted until the cooldown has elapsed. After that, one attempt is let
+ * through (half-open): a success closes the circuit, a failure opens it again.
+ */
+class CircuitBreaker
+{
+public:
+    CircuitBreaker();
+
+    bool allow(const QString &gateway);
+    // Milliseconds until allow() lets an attempt through, 0 when it does now
+    qint64 retryDelay(const QString &gateway);
+    void recordFailure(const QString &gateway);
+    void recordSuccess(const QString &gateway);
+
+private:
+    struct State {
+        int failures { 0 };
+        qint64 windowStart { 0 };
+        qint64 openedAt { -1 };
+    };
+
+    static const int FAILURE_THRESHOLD { 5 };
+    static const qint64 WINDOW_MS { 2 * 60 * 1000 };
+    static const qint64 COOLDOWN_MS { 60 * 1000 };
+
+    QHash<QString, State> states;
+    QElapsedTimer clock;
+};
+
+#endif // CIRCUITBREAKER_H
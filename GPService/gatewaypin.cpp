@@ -0,0 +1,181 @@
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QVariant>
+#include <QtNetwork/QHostAddress>
+
+#include "gatewaypin.h"
+
+const QString GatewayPin::ipBinary = "ip";
+
+GatewayPin::GatewayPin(const QString &tunInterface, const QString &currentPeer, QObject *parent)
+    : QObject(parent)
+    , tunInterface(tunInterface)
+    , currentPeer(currentPeer)
+    , process(new QProcess(this))
+{
+    QObject::connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this, &GatewayPin::onProcessFinished);
+    QObject::connect(process, &QProcess::errorOccurred, this, &GatewayPin::onProcessError);
+}
+
+void GatewayPin::start(const QString &host)
+{
+    if (stage != Idle) {
+        return;
+    }
+
+    // The old tunnel is left alone when its device is unknown, there is nothing to route around
+    if (tunInterface.isEmpty()) {
+        emit message("The tunnel interface is unknown, the new gateway is not pinned");
+        done(true);
+        return;
+    }
+
+    stage = Lookup;
+    const QHostAddress literal(host);
+    if (!literal.isNull()) {
+        QHostInfo info;
+        info.setAddresses({ literal });
+        onLookedUp(info);
+        return;
+    }
+
+    // Through the system resolver, as openconnect will look the gateway up
+    QHostInfo::lookupHost(host, this, &GatewayPin::onLookedUp);
+}
+
+void GatewayPin::onLookedUp(const QHostInfo &info)
+{
+    if (stage != Lookup) {
+        return;
+    }
+
+    addresses.clear();
+    for (const QHostAddress &address : info.addresses()) {
+        const QString value = address.toString();
+        // The current gateway already has its route, it must not be released with the pin
+        if (value != currentPeer && !addresses.contains(value)) {
+            addresses << value;
+        }
+    }
+
+    if (info.error() != QHostInfo::NoError || addresses.isEmpty()) {
+        emit message("Could not resolve the new gateway: " + (info.error() != QHostInfo::NoError ? info.errorString() : QString("no address left to pin")));
+        done(info.error() == QHostInfo::NoError);
+        return;
+    }
+
+    run(RouteToGateway, { "-j", "route", "get", addresses.first() });
+}
+
+void GatewayPin::run(Stage next, const QStringList &args)
+{
+    stage = next;
+    process->start(ipBinary, args);
+
+    if (stage == Apply) {
+        QByteArray commands;
+        for (const QString &route : std::as_const(pinned)) {
+            commands += "route replace " + route.toUtf8() + '\n';
+        }
+        process->write(commands);
+        process->closeWriteChannel();
+    }
+}
+
+void GatewayPin::onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    const QByteArray output = process->readAllStandardOutput();
+
+    if (exitStatus != QProcess::NormalExit || exitCode != 0) {
+        emit message(QString("ip exited with code %1: %2").arg(exitCode).arg(QString::fromUtf8(process->readAllStandardError()).trimmed()));
+        // With -force the batch goes on after a failing line, the other addresses are pinned anyway
+        done(stage == Apply);
+        return;
+    }
+
+    const QJsonObject route = QJsonDocument::fromJson(output).array().at(0).toObject();
+
+    switch (stage) {
+    case RouteToGateway:
+        if (route.value("dev").toString() != tunInterface) {
+            // Split tunnel, the new gateway does not depend on the current tunnel
+            done(true);
+            break;
+        }
+        if (currentPeer.isEmpty()) {
+            emit message("The new gateway is only reachable through " + tunInterface + " and the underlay path is unknown");
+            done(false);
+            break;
+        }
+        run(Underlay, { "-j", "route", "get", currentPeer });
+        break;
+    case Underlay: {
+        const QString dev = route.value("dev").toString();
+        if (dev.isEmpty() || dev == tunInterface) {
+            emit message("No route to " + currentPeer + " outside of " + tunInterface);
+            done(false);
+            break;
+        }
+
+        const QString gateway = route.value("gateway").toString();
+        const bool gatewayIPv6 = gateway.contains(':');
+        for (const QString &address : std::as_const(addresses)) {
+            // The next hop only serves the addresses of its own family
+            if (!gateway.isEmpty() && address.contains(':') != gatewayIPv6) {
+                continue;
+            }
+            pinned << address + (gateway.isEmpty() ? QString() : " via " + gateway) + " dev " + dev;
+        }
+        if (pinned.isEmpty()) {
+            emit message("No address of the new gateway can be routed like " + currentPeer);
+            done(false);
+            break;
+        }
+
+        emit message("Pinning the new gateway to " + dev + ": " + pinned.join(", "));
+        run(Apply, { "-force", "-batch", "-" });
+        break;
+    }
+    case Apply:
+        done(true);
+        break;
+    case Idle:
+    case Lookup:
+        break;
+    }
+}
+
+void GatewayPin::onProcessError(QProcess::ProcessError error)
+{
+    if (error != QProcess::FailedToStart) {
+        return;
+    }
+
+    emit message("Could not run " + ipBinary + ": " + QVariant::fromValue(error).toString());
+    done(false);
+}
+
+void GatewayPin::done(bool ok)
+{
+    stage = Idle;
+    emit finished(ok);
+}
+
+void GatewayPin::release()
+{
+    releaseExcept(QString());
+}
+
+void GatewayPin::releaseExcept(const QString &address)
+{
+    // Compared as addresses, openconnect may print an IPv6 address in another form
+    const QHostAddress kept(address);
+    for (const QString &route : std::as_const(pinned)) {
+        const QStringList args = route.split(' ');
+        if (kept.isNull() || QHostAddress(args.first()) != kept) {
+            QProcess::startDetached(ipBinary, QStringList { "route", "del" } + args);
+        }
+    }
+    pinned.clear();
+}
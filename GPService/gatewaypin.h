@@ -0,0 +1,68 @@
+#ifndef GATEWAYPIN_H
+#define GATEWAYPIN_H
+
+#include <QtCore/QObject>
+#include <QtCore/QProcess>
+#include <QtCore/QStringList>
+#include <QtNetwork/QHostInfo>
+
+/*
+ * Pins the host routes of a gateway to the underlay, before a second tunnel
+ * to it is started during a gateway switch.
+ *
+ * In full tunnel setups the default route goes through the current tun
+ * device, so the new openconnect would reach its gateway through the tunnel
+ * it is about to replace, and lose its own connection once that tunnel is
+ * torn down. Every address of the new gateway is routed like the current
+ * gateway instead. Nothing is pinned when the new gateway is already reached
+ * outside of the tunnel (split tunnel).
+ *
+ * The route of the address the new tunnel connected to is taken over by its
+ * vpnc-script, releaseExcept() removes the others once it is up. release()
+ * removes them all when the switch is abandoned.
+ */
+class GatewayPin : public QObject
+{
+    Q_OBJECT
+public:
+    GatewayPin(const QString &tunInterface, const QString &currentPeer, QObject *parent = nullptr);
+
+    void start(const QString &host);
+    void release();
+    // Keeps the route of the address, the new tunnel owns it
+    void releaseExcept(const QString &address);
+
+signals:
+    void finished(bool ok);
+    void message(QString msg);
+
+private slots:
+    void onLookedUp(const QHostInfo &info);
+    void onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void onProcessError(QProcess::ProcessError error);
+
+private:
+    enum Stage {
+        Idle,
+        Lookup,
+        RouteToGateway,
+        Underlay,
+        Apply,
+    };
+
+    static const QString ipBinary;
+
+    QString tunInterface;
+    QString currentPeer;
+    QStringList addresses;
+    // The routes installed by the Apply stage, as "address via gateway dev device"
+    QStringList pinned;
+
+    QProcess *process;
+    Stage stage { Idle };
+
+    void run(Stage next, const QStringList &args);
+    void done(bool ok);
+};
+
+#endif // GATEWAYPIN_H
@@ -0,0 +1,227 @@
+#include <QtCore/QFileInfo>
+#include <QtCore/QSettings>
+#include <QtCore/QVariant>
+#include <algorithm>
+
+#include "gpconfig.h"
+
+GPConfig::GPConfig(const QString &path, QObject *parent)
+    : QObject(parent)
+    , path(path)
+    , table(std::make_shared<Table>())
+    , watcher(new QFileSystemWatcher(this))
+    , debounceTimer(new QTimer(this))
+{
+    // Editors usually save by writing a new file and renaming it over the old one,
+    // which generates several events and drops the watch on the file itself.
+    debounceTimer->setSingleShot(true);
+    debounceTimer->setInterval(500);
+    QObject::connect(debounceTimer, &QTimer::timeout, this, &GPConfig::reload);
+    QObject::connect(watcher, &QFileSystemWatcher::fileChanged, debounceTimer, QOverload<>::of(&QTimer::start));
+    QObject::connect(watcher, &QFileSystemWatcher::directoryChanged, debounceTimer, QOverload<>::of(&QTimer::start));
+}
+
+void GPConfig::reload()
+{
+    QString error;
+    std::shared_ptr<Table> parsed = parse(path, error);
+
+    watch();
+
+    if (!parsed) {
+        emit message("Failed to load " + path + ": " + error + ", keeping the previous configuration");
+        return;
+    }
+
+    table = parsed;
+    emit message(QString("Loaded %1 with %2 section(s)").arg(path).arg(parsed->sections.size()));
+    emit reloaded();
+}
+
+void GPConfig::watch()
+{
+    const QString dir = QFileInfo(path).absolutePath();
+    if (!watcher->directories().contains(dir) && QFileInfo::exists(dir)) {
+        watcher->addPath(dir);
+    }
+    if (!watcher->files().contains(path) && QFileInfo::exists(path)) {
+        watcher->addPath(path);
+    }
+}
+
+std::shared_ptr<GPConfig::Table> GPConfig::parse(const QString &path, QString &error)
+{
+    QSettings settings(path, QSettings::IniFormat);
+    if (settings.status() != QSettings::NoError) {
+        error = settings.status() == QSettings::FormatError ? "invalid format" : "access error";
+        return nullptr;
+    }
+
+    auto parsed = std::make_shared<Table>();
+    QList<int> globs;
+
+    const QStringList groups = settings.childGroups();
+    for (const QString &group : groups) {
+        Section section;
+        section.name = group;
+
+        settings.beginGroup(group);
+        const QStringList keys = settings.childKeys();
+        for (const QString &key : keys) {
+            // An unquoted value containing commas is read back as a list
+            const QVariant value = settings.value(key);
+            section.values.insert(key, value.typeId() == QMetaType::QStringList ? value.toStringList().join(",") : value.toString());
+        }
+        settings.endGroup();
+
+        section.openconnectArgs = splitCommand(section.values.value("openconnect-args"));
+
+        const int index = parsed->sections.size();
+        parsed->sections.append(section);
+
+        const QString name = group.toLower();
+        const bool isWildcard = name.contains('*') || name.contains('?') || name.contains('[');
+
+        if (name == "*") {
+            parsed->defaults = index;
+        } else if (!isWildcard) {
+            parsed->exact.insert(name, index);
+        } else if (name.startsWith("*.") && !QStringView(name).mid(1).contains('*') && !name.contains('?') && !name.contains('[')) {
+            parsed->suffixes.insert(name.mid(1), index);
+        } else {
+            globs.append(index);
+        }
+    }
+
+    // The most specific (longest) patterns are tried first
+    std::stable_sort(globs.begin(), globs.end(), [&parsed](int a, int b) {
+        return parsed->sections.at(a).name.size() > parsed->sections.at(b).name.size();
+    });
+
+    QStringList alternatives;
+    for (int index : std::as_const(globs)) {
+        const QString name = parsed->sections.at(index).name.toLower();
+        alternatives << "(" + QRegularExpression::wildcardToRegularExpression(name) + ")";
+    }
+
+    if (!alternatives.isEmpty()) {
+        parsed->globs = QRegularExpression(alternatives.join("|"), QRegularExpression::CaseInsensitiveOption);
+        parsed->globs.optimize();
+        parsed->globSections = globs;
+    }
+
+    return parsed;
+}
+
+const GPConfig::Section *GPConfig::match(const Table &table, const QString &gateway)
+{
+    const QString host = gateway.toLower();
+
+    auto exact = table.exact.constFind(host);
+    if (exact != table.exact.constEnd()) {
+        return &table.sections.at(*exact);
+    }
+
+    // Walking the dots from the left yields the longest suffix first
+    if (!table.suffixes.isEmpty()) {
+        for (qsizetype dot = host.indexOf('.'); dot >= 0; dot = host.indexOf('.', dot + 1)) {
+            auto suffix = table.suffixes.constFind(host.mid(dot));
+            if (suffix != table.suffixes.constEnd()) {
+                return &table.sections.at(*suffix);
+            }
+        }
+    }
+
+    if (!table.globSections.isEmpty()) {
+        QRegularExpressionMatch m = table.globs.match(host);
+        if (m.hasMatch()) {
+            // Only the group of the alternative that matched has captured
+            return &table.sections.at(table.globSections.at(m.lastCapturedIndex() - 1));
+        }
+    }
+
+    return table.defaults >= 0 ? &table.sections.at(table.defaults) : nullptr;
+}
+
+QStringList GPConfig::openconnectArgs(const QString &gateway) const
+{
+    std::shared_ptr<const Table> current = table;
+
+    const Section *section = match(*current, gateway);
+    if (section && !section->openconnectArgs.isEmpty()) {
+        return section->openconnectArgs;
+    }
+    if (current->defaults >= 0) {
+        return current->sections.at(current->defaults).openconnectArgs;
+    }
+    return QStringList();
+}
+
+QString GPConfig::value(const QString &gateway, const QString &key, const QString &defaultValue) const
+{
+    std::shared_ptr<const Table> current = table;
+
+    const Section *section = match(*current, gateway);
+    if (section) {
+        const QString v = section->values.value(key);
+        if (!v.isEmpty()) {
+            return v;
+        }
+    }
+    if (current->defaults >= 0) {
+        const QString v = current->sections.at(current->defaults).values.value(key);
+        if (!v.isEmpty()) {
+            return v;
+        }
+    }
+    return defaultValue;
+}
+
+QString GPConfig::sectionName(const QString &gateway) const
+{
+    std::shared_ptr<const Table> current = table;
+
+    const Section *section = match(*current, gateway);
+    return section ? section->name : "*";
+}
+
+/* Port from https://github.com/qt/qtbase/blob/11d1dcc6e263c5059f34b44d531c9ccdf7c0b1d6/src/corelib/io/qprocess.cpp#L2115 */
+QStringList GPConfig::splitCommand(const QString &command)
+{
+    QStringList args;
+    QString tmp;
+    int quoteCount = 0;
+    bool inQuote = false;
+
+    // handle quoting. tokens can be surrounded by double quotes
+    // "hello world". three consecutive double quotes represent
+    // the quote character itself.
+    for (int i = 0; i < command.size(); ++i) {
+        if (command.at(i) == QLatin1Char('"')) {
+            ++quoteCount;
+            if (quoteCount == 3) {
+                // third consecutive quote
+                quoteCount = 0;
+                tmp += command.at(i);
+            }
+            continue;
+        }
+        if (quoteCount) {
+            if (quoteCount == 1)
+                inQuote = !inQuote;
+            quoteCount = 0;
+        }
+        if (!inQuote && command.at(i).isSpace()) {
+            if (!tmp.isEmpty()) {
+                args += tmp;
+                tmp.clear();
+            }
+        } else {
+            tmp += command.at(i);
+        }
+    }
+    if (!tmp.isEmpty())
+        args += tmp;
+
+    return args;
+}
@@ -0,0 +1,76 @@
+#ifndef GPCONFIG_H
+#define GPCONFIG_H
+
+#include <QtCore/QObject>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QStringList>
+#include <QtCore/QRegularExpression>
+#include <QtCore/QFileSystemWatcher>
+#include <QtCore/QTimer>
+#include <memory>
+
+static const QString defaultConfigPath = "/etc/gpservice/gp.conf";
+
+/*
+ * In-memory view of gp.conf.
+ *
+ * The file is parsed once into a table of sections with pre-split argument
+ * vectors. A gateway is matched against, in order: the exact section name,
+ * the longest `*.suffix` section, the other wildcard sections (longest
+ * pattern first), and finally the [*] section. A key that is missing or empty in the matched
+ * section falls back to the [*] section.
+ *
+ * Reloading builds a new table and swaps it in one step, so a lookup never
+ * sees a half-parsed file and running tunnels keep the arguments they were
+ * started with.
+ */
+class GPConfig : public QObject
+{
+    Q_OBJECT
+public:
+    explicit GPConfig(const QString &path = defaultConfigPath, QObject *parent = nullptr);
+
+    QStringList openconnectArgs(const QString &gateway) const;
+    QString value(const QString &gateway, const QString &key, const QString &defaultValue = QString()) const;
+    // The name of the section used for the gateway, "*" for the default one
+    QString sectionName(const QString &gateway) const;
+
+    static QStringList splitCommand(const QString &command);
+
+public slots:
+    void reload();
+
+signals:
+    void reloaded();
+    void message(QString msg);
+
+private:
+    struct Section {
+        QString name;
+        QStringList openconnectArgs;
+        QHash<QString, QString> values;
+    };
+
+    struct Table {
+        QList<Section> sections;
+        QHash<QString, int> exact;
+        // Keyed by the suffix including the leading dot, e.g. ".eu.corp.example"
+        QHash<QString, int> suffixes;
+        // All the other wildcard sections, compiled into a single alternation
+        QRegularExpression globs;
+        QList<int> globSections;
+        int defaults { -1 };
+    };
+
+    QString path;
+    std::shared_ptr<const Table> table;
+    QFileSystemWatcher *watcher;
+    QTimer *debounceTimer;
+
+    static const Section *match(const Table &table, const QString &gateway);
+    void watch();
+    static std::shared_ptr<Table> parse(const QString &path, QString &error);
+};
+
+#endif // GPCONFIG_H
@@ -1,233 +1,298 @@
-#include <QtCore/QFileInfo>
 #include <QtCore/QDateTime>
 #include <QtCore/QVariant>
 #include <QtCore/QRegularExpression>
-#include <QtCore/QRegularExpressionMatch>
-#include <QtCore/QSettings>
 #include <QtDBus/QtDBus>
 
 #include "gpservice.h"
 #include "gpserviceadaptor.h"
+#include "tracer.h"
+
+const QString GPService::defaultSessionName = "default";
 
 GPService::GPService(QObject *parent)
     : QObject(parent)
-    , openconnect(new QProcess)
+    , probe(new OpenconnectProbe(this))
+    , config(new GPConfig(defaultConfigPath, this))
+    , logStream(new LogStream("/", "com.pacha.qt.GPService", this))
+    , metricsServer(new MetricsServer([this]() { return sessions.values(); }, this))
+    , scriptHandler(new ScriptHandler(this))
+    , routeMonitor(new RouteMonitor(this))
+    , sleepMonitor(new SleepMonitor(this))
 {
     // Register the DBus service
     new GPServiceAdaptor(this);
     QDBusConnection dbus = QDBusConnection::systemBus();
     dbus.registerObject("/", this);
-    dbus.registerService("com.qt.GPService");
 
-    // Setup the openconnect process
-    QObject::connect(openconnect, &QProcess::started, this, &GPService::onProcessStarted);
-    QObject::connect(openconnect, &QProcess::errorOccurred, this, &GPService::onProcessError);
-    QObject::connect(openconnect, &QProcess::readyReadStandardOutput, this, &GPService::onProcessStdout);
-    QObject::connect(openconnect, &QProcess::readyReadStandardError, this, &GPService::onProcessStderr);
-    QObject::connect(openconnect, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this, &GPService::onProcessFinished);
+    // Cheap while no client passes a trace id, see connectWithOptions()
+    Tracer::setProcessName("gpservice");
+    Tracer::setEnabled(true);
+
+    // Probe the openconnect binary in the background, so that connect() does not have to
+    QObject::connect(probe, &OpenconnectProbe::message, this, [this](const QString &msg) { log(msg); });
+    probe->refresh();
+
+    // Parse gp.conf once, it is reloaded when the file changes or on SIGHUP
+    QObject::connect(config, &GPConfig::message, this, [this](const QString &msg) { log(msg); });
+    config->reload();
+
+    // OpenMetrics endpoint for the monitoring agents, the socket path may change with gp.conf
+    QObject::connect(metricsServer, &MetricsServer::message, this, [this](const QString &msg) { log(msg); });
+    QObject::connect(config, &GPConfig::reloaded, this, &GPService::listenMetrics);
+    listenMetrics();
+
+    // The built-in vpnc-script, selected with vpnc-script=builtin
+    QObject::connect(scriptHandler, &ScriptHandler::message, this, [this](const QString &msg) { log(msg); });
+    scriptHandler->listen();
+
+    // The tunnels are restored at once on a new network and paused across a suspend
+    QObject::connect(routeMonitor, &RouteMonitor::message, this, [this](const QString &msg) { log(msg); });
+    QObject::connect(routeMonitor, &RouteMonitor::changed, this, [this]() {
+        for (VpnSession *session : std::as_const(sessions)) {
+            session->networkChanged();
+        }
+    });
+    routeMonitor->start();
+    QObject::connect(sleepMonitor, &SleepMonitor::message, this, [this](const QString &msg) { log(msg); });
+    QObject::connect(sleepMonitor, &SleepMonitor::aboutToSleep, this, &GPService::onAboutToSleep);
+    QObject::connect(sleepMonitor, &SleepMonitor::resumed, this, &GPService::onResumed);
+    sleepMonitor->start();
+
+    // The root object forwards the signals and logs of the default session
+    defaultSession = createSession(defaultSessionName);
+    QObject::connect(defaultSession, &VpnSession::connected, this, &GPService::connected);
+    QObject::connect(defaultSession, &VpnSession::disconnected, this, &GPService::disconnected);
+    QObject::connect(defaultSession, &VpnSession::error, this, &GPService::error);
+    QObject::connect(defaultSession, &VpnSession::vpnEvent, this, &GPService::vpnEvent);
+    QObject::connect(defaultSession, &VpnSession::switched, this, &GPService::gatewaySwitched);
+    QObject::connect(defaultSession, &VpnSession::switchFailed, this, &GPService::switchFailed);
+    QObject::connect(defaultSession, &VpnSession::failingOver, this, &GPService::failingOver);
+    QObject::connect(defaultSession, &VpnSession::authRequired, this, &GPService::gatewayAuthRequired);
+    QObject::connect(defaultSession, &VpnSession::logged, this, &GPService::log);
+
+    dbus.registerService("com.qt.GPService");
 }
 
 GPService::~GPService()
 {
-    delete openconnect;
 }
 
-QString GPService::findBinary()
+void GPService::quit()
 {
-    for (int i = 0; i < binaryPaths->length(); i++) {
-        if (QFileInfo::exists(binaryPaths[i])) {
-            return binaryPaths[i];
+    aboutToQuit = true;
+
+    bool running = false;
+    for (VpnSession *session : std::as_const(sessions)) {
+        if (session->isRunning()) {
+            running = true;
+            session->terminate();
         }
     }
-    return nullptr;
+
+    if (!running) {
+        exit(0);
+    }
 }
 
-QString GPService::extraOpenconnectArgs(const QString &gateway)
+void GPService::listenMetrics()
 {
-    QSettings settings("/etc/gpservice/gp.conf", QSettings::IniFormat);
-    
-    // Try gateway-specific args first, fall back to default section
-    settings.beginGroup(gateway);
-    QString extraArgs = settings.value("openconnect-args", QString()).toString();
-    settings.endGroup();
-    
-    if (extraArgs.isEmpty()) {
-        settings.beginGroup("*");
-        extraArgs = settings.value("openconnect-args", QString()).toString();
-        settings.endGroup();
-    }
+    const QString path = config->value(QString(), "metrics-socket", defaultMetricsSocket);
+    metricsServer->listen(path == "none" ? QString() : path);
+}
 
-    return extraArgs;
+void GPService::reloadConfig()
+{
+    config->reload();
 }
 
-/* Port from https://github.com/qt/qtbase/blob/11d1dcc6e263c5059f34b44d531c9ccdf7c0b1d6/src/corelib/io/qprocess.cpp#L2115 */
-QStringList GPService::splitCommand(const QString &command)
+VpnSession *GPService::createSession(const QString &name)
 {
-    QStringList args;
-    QString tmp;
-    int quoteCount = 0;
-    bool inQuote = false;
+    VpnSession *session = new VpnSession(name, probe, config, &breaker, scriptHandler, this);
+    sessions.insert(name, session);
 
-    // handle quoting. tokens can be surrounded by double quotes
-    // "hello world". three consecutive double quotes represent
-    // the quote character itself.
-    for (int i = 0; i < command.size(); ++i) {
-        if (command.at(i) == QLatin1Char('"')) {
-            ++quoteCount;
-            if (quoteCount == 3) {
-                // third consecutive quote
-                quoteCount = 0;
-                tmp += command.at(i);
-            }
-            continue;
-        }
-        if (quoteCount) {
-            if (quoteCount == 1)
-                inQuote = !inQuote;
-            quoteCount = 0;
-        }
-        if (!inQuote && command.at(i).isSpace()) {
-            if (!tmp.isEmpty()) {
-                args += tmp;
-                tmp.clear();
-            }
-        } else {
-            tmp += command.at(i);
-        }
-    }
-    if (!tmp.isEmpty())
-        args += tmp;
+    QDBusConnection::systemBus().registerObject(session->objectPath(), session,
+        QDBusConnection::ExportScriptableSlots | QDBusConnection::ExportScriptableSignals | QDBusConnection::ExportScriptableProperties);
+    QObject::connect(session, &VpnSession::disconnected, this, [this, session]() { onSessionDisconnected(session); });
+    QObject::connect(session, &VpnSession::pausedForSleep, this, [this, session]() { onSessionPaused(session); });
 
-    return args;
+    log("Created session " + name + " at " + session->objectPath());
+    return session;
 }
 
-void GPService::quit()
+void GPService::onSessionDisconnected(VpnSession *session)
 {
-    if (openconnect->state() == QProcess::NotRunning) {
+    // Not going to pause anymore
+    onSessionPaused(session);
+
+    if (aboutToQuit) {
+        for (VpnSession *s : std::as_const(sessions)) {
+            if (s->isRunning()) {
+                return;
+            }
+        }
         exit(0);
-    } else {
-        aboutToQuit = true;
-        openconnect->terminate();
     }
-}
 
-void GPService::connect(QString server, QString username, QString passwd)
-{
-    if (vpnStatus != GPService::VpnNotConnected) {
-        log("VPN status is: " + QVariant::fromValue(vpnStatus).toString());
+    if (session == defaultSession || session->isRunning()) {
         return;
     }
 
-    QString bin = findBinary();
-    if (bin == nullptr) {
-        log("Could not find openconnect binary, make sure openconnect is installed, exiting.");
-        emit error("The OpenConect CLI was not found, make sure it has been installed!");
-        return;
-    }
+    // The named sessions only live as long as their tunnel
+    log("Removing session " + session->name());
+    QDBusConnection::systemBus().unregisterObject(session->objectPath());
+    sessions.remove(session->name());
+    session->deleteLater();
+}
 
-    if (!isValidVersion(bin)) {
-        return;
+void GPService::onAboutToSleep()
+{
+    pausing.clear();
+    for (VpnSession *session : std::as_const(sessions)) {
+        if (session->pauseForSleep()) {
+            pausing.insert(session);
+        }
     }
 
-    const QString extraArgs = extraOpenconnectArgs(server);
-    log(QString("Got extra OpenConnect args for server: %1, %2").arg(server, extraArgs.isEmpty() ? "<empty>" : extraArgs));
-
-    QStringList args;
-    args << QCoreApplication::arguments().mid(1)
-         << "--protocol=gp"
-         << splitCommand(extraArgs)
-         << "-u" << username
-         << "--cookie-on-stdin"
-         << server;
-
-    log("Start process with arugments: " + args.join(", "));
-
-    openconnect->start(bin, args);
-    openconnect->write((passwd + "\n").toUtf8());
+    if (pausing.isEmpty()) {
+        sleepMonitor->release();
+    }
 }
 
-bool GPService::isValidVersion(QString &bin) {
-    QProcess p;
-    p.start(bin, QStringList("--version"));
-    p.waitForFinished();
-    QString output = p.readAllStandardError() + p.readAllStandardOutput();
-
-    QRegularExpression re("v(\\d+).*?(\\s|\\n)");
-    QRegularExpressionMatch match = re.match(output);
+void GPService::onResumed()
+{
+    pausing.clear();
+    for (VpnSession *session : std::as_const(sessions)) {
+        session->resumeAfterSleep();
+    }
+}
 
-    if (match.hasMatch()) {
-        log("Output of `openconnect --version`: " + output);
+void GPService::onSessionPaused(VpnSession *session)
+{
+    if (pausing.remove(session) && pausing.isEmpty()) {
+        log("The tunnels are paused, the system can suspend");
+        sleepMonitor->release();
+    }
+}
 
-        QString fullVersion = match.captured(0);
-        QString majorVersion = match.captured(1);
+void GPService::connect(QString server, QString username, QString passwd)
+{
+    defaultSession->connect(server, username, passwd);
+}
 
-        if (majorVersion.toInt() < 8) {
-            emit error("The OpenConnect version must greater than v8.0.0, got " + fullVersion);
-            return false;
+void GPService::connectWithOptions(QString server, QString username, QString passwd, QVariantMap options)
+{
+    const QString traceId = options.value("traceId").toString();
+    if (!traceId.isEmpty() && calledFromDBus()) {
+        traceOwners.append({ traceId, callerUid() });
+        if (traceOwners.size() > MAX_TRACE_OWNERS) {
+            traceOwners.removeFirst();
         }
-    } else {
-        log("Failed to parse the OpenConnect version from " + output);
     }
 
-    return true;
+    defaultSession->connectWithOptions(server, username, passwd, options);
 }
 
 void GPService::disconnect()
 {
-    if (openconnect->state() != QProcess::NotRunning) {
-        vpnStatus = GPService::VpnDisconnecting;
-        openconnect->terminate();
-    }
+    defaultSession->disconnect();
 }
 
 int GPService::status()
 {
-    return vpnStatus;
+    return defaultSession->status();
+}
+
+void GPService::switchGateway(QString server, QString username, QString passwd)
+{
+    defaultSession->switchGateway(server, username, passwd);
+}
+
+QVariantMap GPService::getLogs(qulonglong sinceSeq, int maxEntries)
+{
+    return logStream->entries(sinceSeq, maxEntries);
 }
 
-void GPService::onProcessStarted()
+void GPService::subscribeLogs()
 {
-    log("Openconnect started successfully, PID=" + QString::number(openconnect->processId()));
-    vpnStatus = GPService::VpnConnecting;
+    if (calledFromDBus()) {
+        logStream->subscribe(message().service());
+    }
 }
 
-void GPService::onProcessError(QProcess::ProcessError error)
+void GPService::unsubscribeLogs()
 {
-    log("Error occurred: " + QVariant::fromValue(error).toString());
-    vpnStatus = GPService::VpnNotConnected;
-    emit disconnected();
+    if (calledFromDBus()) {
+        logStream->unsubscribe(message().service());
+    }
 }
 
-void GPService::onProcessStdout()
+QString GPService::getTrace(QString traceId)
 {
-    QString output = openconnect->readAllStandardOutput();
+    if (traceId.isEmpty()) {
+        return QString();
+    }
 
-    log(output);
-    if (output.indexOf("Connected as") >= 0 ||
-        output.indexOf("Configured as") >= 0 ||
-        output.indexOf("Configurado como") >= 0) {
-        vpnStatus = GPService::VpnConnected;
-        emit connected();
+    // The spans name the gateways and time the login of a user
+    if (calledFromDBus()) {
+        const uint uid = callerUid();
+        bool allowed = uid == 0;
+        for (const auto &owner : std::as_const(traceOwners)) {
+            allowed = allowed || (owner.first == traceId && owner.second == uid);
+        }
+        if (!allowed) {
+            sendErrorReply(QDBusError::AccessDenied, "The trace was recorded for another user");
+            return QString();
+        }
     }
+
+    return QString::fromUtf8(Tracer::toJson(Tracer::events(traceId)));
 }
 
-void GPService::onProcessStderr()
+/* The uid of the D-Bus caller, -1 when the bus cannot tell */
+uint GPService::callerUid() const
 {
-    log(openconnect->readAllStandardError());
+    const QDBusReply<uint> reply = connection().interface()->serviceUid(message().service());
+    return reply.isValid() ? reply.value() : uint(-1);
 }
 
-void GPService::onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus)
+QStringList GPService::listSessions()
 {
-    log("Openconnect process exited with code " + QString::number(exitCode) + " and exit status " + QVariant::fromValue(exitStatus).toString());
-    vpnStatus = GPService::VpnNotConnected;
-    emit disconnected();
+    QStringList paths;
+    for (VpnSession *session : std::as_const(sessions)) {
+        paths << session->objectPath();
+    }
+    return paths;
+}
 
-    if (aboutToQuit) {
-        exit(0);
-    };
+QString GPService::connectSession(QString name, QString server, QString username, QString passwd)
+{
+    // The name becomes an element of the object path
+    static const QRegularExpression validName("^[A-Za-z0-9_]+$");
+    if (!validName.match(name).hasMatch()) {
+        if (calledFromDBus()) {
+            sendErrorReply(QDBusError::InvalidArgs, "The session name may only contain [A-Za-z0-9_]");
+        }
+        return QString();
+    }
+
+    VpnSession *session = sessions.value(name);
+    if (!session) {
+        session = createSession(name);
+    }
+
+    session->connect(server, username, passwd);
+    return session->objectPath();
+}
+
+void GPService::disconnectSession(QString name)
+{
+    VpnSession *session = sessions.value(name);
+    if (session) {
+        session->disconnect();
+    }
 }
 
 void GPService::log(QString msg)
 {
-    emit logAvailable(msg);
+    logStream->append(msg);
 }
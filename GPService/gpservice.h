@@ -2,18 +2,22 @@
 #define GLOBALPROTECTSERVICE_H
 
 #include <QtCore/QObject>
-#include <QtCore/QProcess>
-
-static const QString binaryPaths[] {
-    "/usr/local/bin/openconnect",
-    "/usr/local/sbin/openconnect",
-    "/usr/bin/openconnect",
-    "/usr/sbin/openconnect",
-    "/opt/bin/openconnect",
-    "/opt/sbin/openconnect"
-};
+#include <QtCore/QMap>
+#include <QtCore/QSet>
+#include <QtCore/QVariantMap>
+#include <QtDBus/QDBusContext>
+
+#include "openconnectprobe.h"
+#include "gpconfig.h"
+#include "logstream.h"
+#include "circuitbreaker.h"
+#include "metricsserver.h"
+#include "routemonitor.h"
+#include "scripthandler.h"
+#include "sleepmonitor.h"
+#include "vpnsession.h"
 
-class GPService : public QObject
+class GPService : public QObject, protected QDBusContext
 {
     Q_OBJECT
     Q_CLASSINFO("D-Bus Interface", "com.pacha.qt.GPService")
@@ -22,42 +26,75 @@ public:
     ~GPService();
 
     void quit();
-
-    enum VpnStatus {
-        VpnNotConnected,
-        VpnConnecting,
-        VpnConnected,
-        VpnDisconnecting,
-    };
+    void reloadConfig();
 
 signals:
     void connected();
     void disconnected();
     void error(QString errorMessage);
-    void logAvailable(QString log);
+    // Only delivered to the subscribers, see subscribeLogs()
+    void logsAvailable(qulonglong firstSeq, QStringList lines);
+    void vpnEvent(QString event, qlonglong timestamp, QString message);
+    void gatewaySwitched(QString server);
+    void switchFailed(QString errorMessage);
+    // The gateway connecting failed during the setup, the connection goes on with server
+    void failingOver(QString server);
+    // The gateway failed over to rejected the cookie, see VpnSession::authRequired()
+    void gatewayAuthRequired(QString server);
 
 public slots:
+    // The default session, kept for the single tunnel clients
     void connect(QString server, QString username, QString passwd);
+    // options: "traceId" to record the phases of the connection, see getTrace(),
+    // "resolve" the "host:address" of the gateways resolved by the client,
+    // "candidates" the gateways to fail over to, in the order of preference
+    void connectWithOptions(QString server, QString username, QString passwd, QVariantMap options);
     void disconnect();
     int status();
+    // Make-before-break: the current tunnel stays up until the new one is configured
+    void switchGateway(QString server, QString username, QString passwd);
 
-private slots:
-    void onProcessStarted();
-    void onProcessError(QProcess::ProcessError error);
-    void onProcessStdout();
-    void onProcessStderr();
-    void onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    QVariantMap getLogs(qulonglong sinceSeq, int maxEntries);
+    void subscribeLogs();
+    void unsubscribeLogs();
+    // The spans recorded for the trace, in the Chrome trace-event JSON format, only for root and
+    // the user that connected with the trace id
+    QString getTrace(QString traceId);
+
+    // Named sessions, each one exported on its own object path
+    QStringList listSessions();
+    QString connectSession(QString name, QString server, QString username, QString passwd);
+    void disconnectSession(QString name);
 
 private:
-    QProcess *openconnect;
+    static const QString defaultSessionName;
+    static const int MAX_TRACE_OWNERS { 32 };
+
+    OpenconnectProbe *probe;
+    GPConfig *config;
+    LogStream *logStream;
+    // Shared by the sessions, so that two tunnels to the same gateway trip the same breaker
+    CircuitBreaker breaker;
+    MetricsServer *metricsServer;
+    ScriptHandler *scriptHandler;
+    RouteMonitor *routeMonitor;
+    SleepMonitor *sleepMonitor;
+    QMap<QString, VpnSession *> sessions;
+    // The sessions the suspend waits for, see SleepMonitor
+    QSet<VpnSession *> pausing;
+    VpnSession *defaultSession;
     bool aboutToQuit = false;
-    int vpnStatus = GPService::VpnNotConnected;
+    // The trace ids of the last connects and the uid of their callers, see getTrace()
+    QList<QPair<QString, uint>> traceOwners;
 
     void log(QString msg);
-    bool isValidVersion(QString &bin);
-    static QString findBinary();
-    static QString extraOpenconnectArgs(const QString &gateway);
-    static QStringList splitCommand(const QString &command);
+    uint callerUid() const;
+    void listenMetrics();
+    VpnSession *createSession(const QString &name);
+    void onSessionDisconnected(VpnSession *session);
+    void onAboutToSleep();
+    void onResumed();
+    void onSessionPaused(VpnSession *session);
 };
 
 #endif // GLOBALPROTECTSERVICE_H
@@ -0,0 +1,275 @@
+#include <QtCore/QStringList>
+#include <cerrno>
+#include <cstdarg>
+#include <mutex>
+#include <unistd.h>
+
+extern "C" {
+#include <openconnect.h>
+}
+
+#include "libopenconnecttunnel.h"
+
+LibOpenconnectTunnel::LibOpenconnectTunnel(QObject *parent)
+    : QObject(parent)
+{
+}
+
+LibOpenconnectTunnel::~LibOpenconnectTunnel()
+{
+    if (worker) {
+        cancel();
+        worker->wait();
+    }
+    release();
+}
+
+bool LibOpenconnectTunnel::start(const QString &server, const SecureBuffer &cookie, const QString &script)
+{
+    // The previous run may not have delivered its finished() yet, it is dropped, see generation
+    if (worker) {
+        worker->wait();
+        release();
+    }
+
+    static std::once_flag sslInitialized;
+    std::call_once(sslInitialized, []() { openconnect_init_ssl(); });
+
+    if (cookie.isEmpty()) {
+        emit progress("No cookie to connect with");
+        return false;
+    }
+
+    vpninfo = openconnect_vpninfo_new("PAN GlobalProtect", validatePeerCert, nullptr, nullptr, progressHandler, this);
+    if (!vpninfo) {
+        emit progress("Failed to allocate the libopenconnect session");
+        return false;
+    }
+
+    openconnect_set_loglevel(vpninfo, PRG_INFO);
+
+    if (openconnect_set_protocol(vpninfo, "gp") != 0 || openconnect_parse_url(vpninfo, server.toUtf8().constData()) != 0) {
+        emit progress("Invalid gateway for libopenconnect: " + server);
+        release();
+        return false;
+    }
+
+    // Copied by the library, the buffer is NUL terminated
+    openconnect_set_cookie(vpninfo, cookie.constData());
+
+    openconnect_set_setup_tun_handler(vpninfo, setupTun);
+    openconnect_set_reconnected_handler(vpninfo, reconnectedHandler);
+    openconnect_set_stats_handler(vpninfo, statsHandler);
+    commandFd = openconnect_setup_cmd_pipe(vpninfo);
+
+    vpncScript = script;
+    cancelled = false;
+    pauseRequested = false;
+    reconnectRequested = false;
+    pauseSent = false;
+    exitCode = 1;
+
+    const quint64 started = ++generation;
+    worker = QThread::create([this]() { run(); });
+    QObject::connect(worker, &QThread::finished, this, [this, started]() {
+        // Queued by a run that start() already waited for and released
+        if (started != generation) {
+            return;
+        }
+
+        const int code = exitCode;
+        release();
+        emit finished(code);
+    });
+    worker->start();
+    return true;
+}
+
+bool LibOpenconnectTunnel::isRunning() const
+{
+    return worker && worker->isRunning();
+}
+
+void LibOpenconnectTunnel::cancel()
+{
+    cancelled = true;
+
+    if (pauseRequested) {
+        // No mainloop to tell, wake up the worker so that it exits
+        QMutexLocker locker(&resumeMutex);
+        resumeCondition.wakeAll();
+        return;
+    }
+    sendCommand(OC_CMD_CANCEL);
+}
+
+void LibOpenconnectTunnel::pause()
+{
+    if (!isRunning() || pauseRequested) {
+        return;
+    }
+
+    pauseRequested = true;
+    sendPause();
+}
+
+void LibOpenconnectTunnel::resume()
+{
+    QMutexLocker locker(&resumeMutex);
+    pauseRequested = false;
+    resumeCondition.wakeAll();
+}
+
+void LibOpenconnectTunnel::reconnect()
+{
+    if (!isRunning() || pauseRequested) {
+        return;
+    }
+
+    // The worker connects again as soon as the mainloop returns, without waiting for resume()
+    reconnectRequested = true;
+    sendPause();
+}
+
+/*
+ * pause() and reconnect() share one OC_CMD_PAUSE: the mainloop returns once for
+ * both flags, a second command would be left in the pipe and end the next mainloop.
+ */
+void LibOpenconnectTunnel::sendPause()
+{
+    if (!pauseSent.exchange(true)) {
+        sendCommand(OC_CMD_PAUSE);
+    }
+}
+
+void LibOpenconnectTunnel::requestStats()
+{
+    if (isRunning() && !pauseRequested) {
+        sendCommand(OC_CMD_STATS);
+    }
+}
+
+void LibOpenconnectTunnel::sendCommand(char command)
+{
+    if (commandFd >= 0) {
+        ssize_t unused = ::write(commandFd, &command, 1);
+        (void)unused;
+    }
+}
+
+/* Runs on the worker thread */
+void LibOpenconnectTunnel::run()
+{
+    int ret = openconnect_make_cstp_connection(vpninfo);
+
+    if (ret == 0) {
+        if (openconnect_setup_dtls(vpninfo, DTLS_ATTEMPT_PERIOD_S) != 0) {
+            emit progress("ESP is not available, the tunnel goes over HTTPS");
+        }
+
+        for (;;) {
+            ret = openconnect_mainloop(vpninfo, RECONNECT_TIMEOUT_S, RECONNECT_INTERVAL_S);
+            // Cleared before the flags are read, a later pause() or reconnect() sends a new command
+            pauseSent = false;
+            // The mainloop only returns 0 for a pause command, one without a flag is a reconnect
+            const bool restart = reconnectRequested.exchange(false) || (ret == 0 && !pauseRequested);
+            if (cancelled || (!pauseRequested && !restart)) {
+                break;
+            }
+
+            // Paused: the connection is closed but the session is kept, wait for resume() or cancel()
+            {
+                QMutexLocker locker(&resumeMutex);
+                if (pauseRequested && !cancelled) {
+                    emit paused();
+                }
+                while (pauseRequested && !cancelled) {
+                    resumeCondition.wait(&resumeMutex);
+                }
+            }
+            if (cancelled) {
+                break;
+            }
+
+            ret = openconnect_make_cstp_connection(vpninfo);
+            if (ret != 0) {
+                break;
+            }
+            openconnect_setup_dtls(vpninfo, DTLS_ATTEMPT_PERIOD_S);
+            emit reconnected();
+        }
+    }
+
+    if (cancelled) {
+        exitCode = 0;
+    } else if (ret == -EPERM) {
+        exitCode = 2;
+    } else {
+        exitCode = 1;
+    }
+}
+
+void LibOpenconnectTunnel::release()
+{
+    if (worker) {
+        // finished() is queued before run() has fully returned, a running QThread must not be destroyed
+        worker->wait();
+        delete worker;
+        worker = nullptr;
+    }
+
+    if (vpninfo) {
+        // Also closes the command pipe
+        openconnect_vpninfo_free(vpninfo);
+        vpninfo = nullptr;
+    }
+    commandFd = -1;
+}
+
+int LibOpenconnectTunnel::validatePeerCert(void *privdata, const char *reason)
+{
+    auto *self = static_cast<LibOpenconnectTunnel *>(privdata);
+    emit self->progress(QString("Rejecting the gateway certificate: %1").arg(QString::fromUtf8(reason)));
+    return 1;
+}
+
+void LibOpenconnectTunnel::progressHandler(void *privdata, int level, const char *fmt, ...)
+{
+    if (level > PRG_INFO) {
+        return;
+    }
+
+    va_list args;
+    va_start(args, fmt);
+    const QString text = QString::vasprintf(fmt, args);
+    va_end(args);
+
+    auto *self = static_cast<LibOpenconnectTunnel *>(privdata);
+    const QStringList lines = text.split('\n', Qt::SkipEmptyParts);
+    for (const QString &line : lines) {
+        emit self->progress(line);
+    }
+}
+
+void LibOpenconnectTunnel::setupTun(void *privdata)
+{
+    auto *self = static_cast<LibOpenconnectTunnel *>(privdata);
+    const QByteArray script = self->vpncScript.toUtf8();
+
+    if (openconnect_setup_tun_device(self->vpninfo, script.isEmpty() ? nullptr : script.constData(), nullptr) != 0) {
+        emit self->progress("Failed to set up the tun device");
+        return;
+    }
+
+    emit self->configured(QString::fromUtf8(openconnect_get_ifname(self->vpninfo)));
+}
+
+void LibOpenconnectTunnel::reconnectedHandler(void *privdata)
+{
+    emit static_cast<LibOpenconnectTunnel *>(privdata)->reconnected();
+}
+
+void LibOpenconnectTunnel::statsHandler(void *privdata, const struct oc_stats *stats)
+{
+    emit static_cast<LibOpenconnectTunnel *>(privdata)->statsReceived(stats->rx_bytes, stats->tx_bytes, stats->rx_pkts, stats->tx_pkts);
+}
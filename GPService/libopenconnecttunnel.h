@@ -0,0 +1,91 @@
+#ifndef LIBOPENCONNECTTUNNEL_H
+#define LIBOPENCONNECTTUNNEL_H
+
+#include <QtCore/QObject>
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+#include <QtCore/QWaitCondition>
+#include <atomic>
+
+#include "securebuffer.h"
+
+struct openconnect_info;
+struct oc_stats;
+
+/*
+ * A tunnel run in-process through libopenconnect.
+ *
+ * The connection and openconnect_mainloop() run on a dedicated worker
+ * thread; the library callbacks are turned into queued signals, so the
+ * state transitions reach the session without any text parsing. The
+ * command pipe of the library is used to cancel (log off), pause (drop the
+ * connection but keep the session), reconnect at once (a pause followed by
+ * a new connection, e.g. after a network change) and to ask for the traffic
+ * statistics.
+ *
+ * Only the gp.conf keys understood by the library apply, the
+ * openconnect-args of the CLI backend are ignored.
+ */
+class LibOpenconnectTunnel : public QObject
+{
+    Q_OBJECT
+public:
+    explicit LibOpenconnectTunnel(QObject *parent = nullptr);
+    ~LibOpenconnectTunnel();
+
+    bool start(const QString &server, const SecureBuffer &cookie, const QString &vpncScript);
+    bool isRunning() const;
+
+    void cancel();
+    void pause();
+    void resume();
+    // Drops the connection and makes a new one now, instead of waiting for the dead peer detection
+    void reconnect();
+    void requestStats();
+
+signals:
+    void progress(QString line);
+    // The tun device is up and configured by the vpnc-script
+    void configured(QString interfaceName);
+    // Also after resume() and reconnect()
+    void reconnected();
+    // The connection is closed after pause(), the session is kept
+    void paused();
+    void statsReceived(quint64 rxBytes, quint64 txBytes, quint64 rxPackets, quint64 txPackets);
+    // Same codes as the CLI: 0 after cancel(), 2 when the cookie was rejected, 1 otherwise
+    void finished(int exitCode);
+
+private:
+    static const int RECONNECT_TIMEOUT_S { 300 };
+    static const int RECONNECT_INTERVAL_S { 10 };
+    static const int DTLS_ATTEMPT_PERIOD_S { 60 };
+
+    struct openconnect_info *vpninfo { nullptr };
+    int commandFd { -1 };
+    QThread *worker { nullptr };
+    // Counts the runs: the worker of the next one may be allocated where the previous one was
+    quint64 generation { 0 };
+    QString vpncScript;
+
+    std::atomic<bool> cancelled { false };
+    std::atomic<bool> pauseRequested { false };
+    std::atomic<bool> reconnectRequested { false };
+    // An OC_CMD_PAUSE is in the command pipe, not yet consumed by the mainloop
+    std::atomic<bool> pauseSent { false };
+    std::atomic<int> exitCode { 0 };
+    QMutex resumeMutex;
+    QWaitCondition resumeCondition;
+
+    void run();
+    void sendCommand(char command);
+    void sendPause();
+    void release();
+
+    static int validatePeerCert(void *privdata, const char *reason);
+    static void progressHandler(void *privdata, int level, const char *fmt, ...);
+    static void setupTun(void *privdata);
+    static void reconnectedHandler(void *privdata);
+    static void statsHandler(void *privdata, const struct oc_stats *stats);
+};
+
+#endif // LIBOPENCONNECTTUNNEL_H
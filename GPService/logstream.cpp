@@ -0,0 +1,116 @@
+#include <QtCore/QDateTime>
+#include <QtCore/QStringList>
+#include <QtDBus/QDBusConnection>
+#include <QtDBus/QDBusMessage>
+
+#include "logstream.h"
+
+LogStream::LogStream(const QString &objectPath, const QString &interface, QObject *parent)
+    : QObject(parent)
+    , objectPath(objectPath)
+    , interface(interface)
+    , subscriberWatcher(new QDBusServiceWatcher(this))
+    , flushTimer(new QTimer(this))
+{
+    ring.reserve(CAPACITY);
+
+    flushTimer->setSingleShot(true);
+    flushTimer->setInterval(FLUSH_INTERVAL_MS);
+    QObject::connect(flushTimer, &QTimer::timeout, this, &LogStream::flush);
+
+    // Forget the subscribers that left the bus without unsubscribing
+    subscriberWatcher->setConnection(QDBusConnection::systemBus());
+    subscriberWatcher->setWatchMode(QDBusServiceWatcher::WatchForUnregistration);
+    QObject::connect(subscriberWatcher, &QDBusServiceWatcher::serviceUnregistered, this, &LogStream::unsubscribe);
+}
+
+quint64 LogStream::append(const QString &message)
+{
+    Entry entry { nextSeq++, QDateTime::currentMSecsSinceEpoch(), message };
+
+    if (ring.size() < CAPACITY) {
+        ring.append(entry);
+    } else {
+        ring[(entry.seq - 1) % CAPACITY] = entry;
+    }
+
+    if (!subscribers.isEmpty() && !flushTimer->isActive()) {
+        flushTimer->start();
+    }
+
+    return entry.seq;
+}
+
+quint64 LogStream::firstSeq() const
+{
+    return nextSeq > quint64(CAPACITY) ? nextSeq - CAPACITY : 1;
+}
+
+quint64 LogStream::lastSeq() const
+{
+    return nextSeq - 1;
+}
+
+QVariantMap LogStream::entries(quint64 sinceSeq, int maxEntries) const
+{
+    const quint64 from = qMax(sinceSeq + 1, firstSeq());
+    const quint64 to = maxEntries > 0 ? qMin(lastSeq(), from + maxEntries - 1) : lastSeq();
+
+    QStringList lines;
+    QVariantList timestamps;
+    for (quint64 seq = from; seq <= to; seq++) {
+        const Entry &entry = ring.at((seq - 1) % CAPACITY);
+        lines << entry.message;
+        timestamps << entry.timestamp;
+    }
+
+    QVariantMap result;
+    result.insert("first", from);
+    result.insert("last", lines.isEmpty() ? from - 1 : to);
+    result.insert("latest", lastSeq());
+    result.insert("lines", lines);
+    result.insert("timestamps", timestamps);
+    return result;
+}
+
+void LogStream::subscribe(const QString &service)
+{
+    if (service.isEmpty() || subscribers.contains(service)) {
+        return;
+    }
+
+    // Live delivery starts from now, the history is fetched with entries()
+    subscribers.insert(service, lastSeq());
+    subscriberWatcher->addWatchedService(service);
+}
+
+void LogStream::unsubscribe(const QString &service)
+{
+    subscribers.remove(service);
+    subscriberWatcher->removeWatchedService(service);
+}
+
+void LogStream::flush()
+{
+    bool pending = false;
+
+    for (auto it = subscribers.begin(); it != subscribers.end(); ++it) {
+        const QVariantMap batch = entries(it.value(), MAX_BATCH_SIZE);
+        const QStringList lines = batch.value("lines").toStringList();
+        if (lines.isEmpty()) {
+            continue;
+        }
+
+        QDBusMessage msg = QDBusMessage::createTargetedSignal(it.key(), objectPath, interface, "logsAvailable");
+        msg << batch.value("first") << lines;
+        QDBusConnection::systemBus().send(msg);
+
+        it.value() = batch.value("last").toULongLong();
+        pending = pending || it.value() < lastSeq();
+    }
+
+    // Rate limit: the remaining entries go out with the next flush
+    if (pending) {
+        flushTimer->start();
+    }
+}
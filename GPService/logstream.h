@@ -0,0 +1,63 @@
+#ifndef LOGSTREAM_H
+#define LOGSTREAM_H
+
+#include <QtCore/QObject>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QTimer>
+#include <QtCore/QVariantMap>
+#include <QtDBus/QDBusServiceWatcher>
+
+/*
+ * Bounded, sequenced log buffer with pull-based retrieval.
+ *
+ * Every entry gets a sequence number, so a client can fetch the history it
+ * missed with entries(sinceSeq, maxEntries). Live delivery is opt-in: only the
+ * subscribed bus names receive the logsAvailable signal, addressed to them
+ * directly, with the new entries coalesced into at most one batch per flush
+ * interval.
+ */
+class LogStream : public QObject
+{
+    Q_OBJECT
+public:
+    explicit LogStream(const QString &objectPath, const QString &interface, QObject *parent = nullptr);
+
+    quint64 append(const QString &message);
+    quint64 lastSeq() const;
+
+    // Keys: "first", "last" and "latest" (qulonglong), "lines" (QStringList), "timestamps" (QVariantList)
+    QVariantMap entries(quint64 sinceSeq, int maxEntries) const;
+
+    void subscribe(const QString &service);
+    void unsubscribe(const QString &service);
+
+private slots:
+    void flush();
+
+private:
+    struct Entry {
+        quint64 seq;
+        qint64 timestamp;
+        QString message;
+    };
+
+    static const int CAPACITY { 8192 };
+    static const int MAX_BATCH_SIZE { 256 };
+    static const int FLUSH_INTERVAL_MS { 250 };
+
+    QString objectPath;
+    QString interface;
+
+    QList<Entry> ring;
+    quint64 nextSeq { 1 };
+
+    // The last sequence number delivered to each subscriber
+    QHash<QString, quint64> subscribers;
+    QDBusServiceWatcher *subscriberWatcher;
+    QTimer *flushTimer;
+
+    quint64 firstSeq() const;
+};
+
+#endif // LOGSTREAM_H
@@ -3,10 +3,12 @@
 #include <QtCore/QSocketNotifier>
 #include <QtDBus/QtDBus>
 #include <csignal>
+#include <cstring>
 #include <sys/socket.h>
 #include <unistd.h>
 
 #include "gpservice.h"
+#include "scripthandler.h"
 #include "version.h"
 
 // Simple signal handler for the service
@@ -19,6 +21,11 @@ static void signalHandler(int signal) {
 
 int main(int argc, char *argv[])
 {
+    // Run by openconnect as its script, see ScriptHandler
+    if (argc == 3 && strcmp(argv[1], "--script-helper") == 0) {
+        return ScriptHandler::forward(argv[2]);
+    }
+
     QCoreApplication app(argc, argv);
     app.setApplicationName("gpservice");
     app.setApplicationVersion(QString::fromLocal8Bit(VERSION));
@@ -44,7 +51,12 @@ int main(int argc, char *argv[])
             notifier->setEnabled(false);
             int signal;
             if (::read(s_signalFd[1], &signal, sizeof(signal)) == sizeof(signal)) {
-                service.quit();
+                if (signal == SIGHUP) {
+                    // Reload gp.conf, running tunnels are not affected
+                    service.reloadConfig();
+                } else {
+                    service.quit();
+                }
             }
             notifier->setEnabled(true);
         });
@@ -0,0 +1,169 @@
+#include <QtCore/QDir>
+#include <QtCore/QFileInfo>
+#include <QtCore/QTimer>
+#include <QtNetwork/QLocalSocket>
+
+#include "metricsserver.h"
+#include "vpnsession.h"
+
+MetricsServer::MetricsServer(SessionList sessions, QObject *parent)
+    : QObject(parent)
+    , sessions(sessions)
+    , server(new QLocalServer(this))
+{
+    // The counters are not secret, but the gateway names are: the socket is created by gpservice, as
+    // root:root, so only root and the root group can read it
+    server->setSocketOptions(QLocalServer::UserAccessOption | QLocalServer::GroupAccessOption);
+    QObject::connect(server, &QLocalServer::newConnection, this, &MetricsServer::onNewConnection);
+}
+
+void MetricsServer::listen(const QString &newPath)
+{
+    if (newPath == path && (path.isEmpty() || server->isListening())) {
+        return;
+    }
+
+    server->close();
+    path = newPath;
+    if (path.isEmpty()) {
+        return;
+    }
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QLocalServer::removeServer(path);
+
+    if (server->listen(path)) {
+        emit message("Serving the metrics on " + path);
+    } else {
+        emit message("Failed to serve the metrics on " + path + ": " + server->errorString());
+    }
+}
+
+void MetricsServer::onNewConnection()
+{
+    while (QLocalSocket *socket = server->nextPendingConnection()) {
+        QObject::connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+        QTimer::singleShot(REQUEST_TIMEOUT_MS, socket, [socket]() { socket->abort(); });
+
+        QObject::connect(socket, &QLocalSocket::readyRead, this, [this, socket]() {
+            // Nothing in the request matters, wait for the end of the headers and answer
+            const QByteArray request = socket->peek(MAX_REQUEST_SIZE);
+            if (!request.contains("\r\n\r\n") && !request.contains("\n\n")) {
+                if (request.size() >= MAX_REQUEST_SIZE) {
+                    socket->abort();
+                }
+                return;
+            }
+            QObject::disconnect(socket, &QLocalSocket::readyRead, this, nullptr);
+            socket->readAll();
+
+            const bool isGet = request.startsWith("GET ");
+            const QByteArray body = isGet ? render() : QByteArray();
+            QByteArray response = isGet
+                ? "HTTP/1.1 200 OK\r\n"
+                  "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+                : "HTTP/1.1 405 Method Not Allowed\r\n"
+                  "Allow: GET\r\n";
+            response += "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                        "Connection: close\r\n\r\n";
+            response += body;
+
+            socket->write(response);
+            socket->disconnectFromServer();
+        });
+    }
+}
+
+QString MetricsServer::escapeLabel(const QString &value)
+{
+    QString escaped = value;
+    escaped.replace('\\', "\\\\").replace('"', "\\\"").replace('\n', "\\n");
+    return escaped;
+}
+
+QByteArray MetricsServer::render() const
+{
+    struct Family {
+        const char *name;
+        const char *type;
+        const char *help;
+        std::function<quint64(const TunnelMetrics::Counters &)> value;
+    };
+
+    static const QList<Family> counterFamilies {
+        { "gpservice_tunnel_receive_bytes", "counter", "Bytes received on the tunnel interface.",
+          [](const TunnelMetrics::Counters &c) { return c.rxBytes; } },
+        { "gpservice_tunnel_transmit_bytes", "counter", "Bytes sent on the tunnel interface.",
+          [](const TunnelMetrics::Counters &c) { return c.txBytes; } },
+        { "gpservice_tunnel_receive_packets", "counter", "Packets received on the tunnel interface.",
+          [](const TunnelMetrics::Counters &c) { return c.rxPackets; } },
+        { "gpservice_tunnel_transmit_packets", "counter", "Packets sent on the tunnel interface.",
+          [](const TunnelMetrics::Counters &c) { return c.txPackets; } },
+        { "gpservice_tunnel_receive_errors", "counter", "Receive errors on the tunnel interface.",
+          [](const TunnelMetrics::Counters &c) { return c.rxErrors; } },
+        { "gpservice_tunnel_transmit_errors", "counter", "Transmit errors on the tunnel interface.",
+          [](const TunnelMetrics::Counters &c) { return c.txErrors; } },
+        { "gpservice_tunnel_receive_drops", "counter", "Received packets dropped on the tunnel interface.",
+          [](const TunnelMetrics::Counters &c) { return c.rxDropped; } },
+        { "gpservice_tunnel_transmit_drops", "counter", "Sent packets dropped on the tunnel interface.",
+          [](const TunnelMetrics::Counters &c) { return c.txDropped; } },
+    };
+
+    const QList<VpnSession *> list = sessions();
+    QString out;
+
+    auto labels = [](VpnSession *session) {
+        return QString("session=\"%1\",server=\"%2\",interface=\"%3\"")
+            .arg(escapeLabel(session->name()), escapeLabel(session->server()), escapeLabel(session->interfaceName()));
+    };
+
+    for (const Family &family : counterFamilies) {
+        out += QString("# TYPE %1 %2\n# HELP %1 %3\n").arg(family.name, family.type, family.help);
+        for (VpnSession *session : list) {
+            out += QString("%1_total{%2} %3\n").arg(family.name, labels(session)).arg(family.value(session->metrics()->counters()));
+        }
+    }
+
+    out += "# TYPE gpservice_session_status stateset\n"
+           "# HELP gpservice_session_status Current status of the session.\n";
+    for (VpnSession *session : list) {
+        for (int status = VpnSession::VpnNotConnected; status <= VpnSession::VpnDisconnecting; status++) {
+            out += QString("gpservice_session_status{%1,gpservice_session_status=\"%2\"} %3\n")
+                .arg(labels(session), VpnSession::statusName(status)).arg(session->status() == status ? 1 : 0);
+        }
+    }
+
+    out += "# TYPE gpservice_session_status_seconds counter\n"
+           "# HELP gpservice_session_status_seconds Time spent by the session in each status.\n";
+    for (VpnSession *session : list) {
+        for (int status = VpnSession::VpnNotConnected; status <= VpnSession::VpnDisconnecting; status++) {
+            out += QString("gpservice_session_status_seconds_total{%1,status=\"%2\"} %3\n")
+                .arg(labels(session), VpnSession::statusName(status))
+                .arg(session->metrics()->timeInStatus(status) / 1000.0, 0, 'f', 3);
+        }
+    }
+
+    out += "# TYPE gpservice_session_uptime_seconds gauge\n"
+           "# HELP gpservice_session_uptime_seconds Time since the tunnel came up, including the automatic reconnects.\n";
+    for (VpnSession *session : list) {
+        out += QString("gpservice_session_uptime_seconds{%1} %2\n")
+            .arg(labels(session)).arg(session->metrics()->uptime() / 1000.0, 0, 'f', 3);
+    }
+
+    out += "# TYPE gpservice_session_reconnects counter\n"
+           "# HELP gpservice_session_reconnects Automatic reconnects since the session was connected.\n";
+    for (VpnSession *session : list) {
+        out += QString("gpservice_session_reconnects_total{%1} %2\n").arg(labels(session)).arg(session->reconnectCount());
+    }
+
+    out += "# TYPE gpservice_session_restore_seconds summary\n"
+           "# HELP gpservice_session_restore_seconds Time to the restored tunnel after a network change or a resume.\n";
+    for (VpnSession *session : list) {
+        out += QString("gpservice_session_restore_seconds_count{%1} %2\n").arg(labels(session)).arg(session->metrics()->restoreCount());
+        out += QString("gpservice_session_restore_seconds_sum{%1} %2\n")
+            .arg(labels(session)).arg(session->metrics()->restoreTime() / 1000.0, 0, 'f', 3);
+    }
+
+    out += "# EOF\n";
+    return out.toUtf8();
+}
@@ -0,0 +1,49 @@
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <QtCore/QObject>
+#include <QtCore/QList>
+#include <QtNetwork/QLocalServer>
+#include <functional>
+
+class VpnSession;
+
+static const QString defaultMetricsSocket = "/run/gpservice/metrics.sock";
+
+/*
+ * OpenMetrics text exposition of the sessions on a local unix socket.
+ *
+ * Speaks just enough HTTP/1.1 for a scraper (or curl --unix-socket) to GET
+ * the metrics: every request is answered with the current values and the
+ * connection is closed.
+ */
+class MetricsServer : public QObject
+{
+    Q_OBJECT
+public:
+    using SessionList = std::function<QList<VpnSession *>()>;
+
+    MetricsServer(SessionList sessions, QObject *parent = nullptr);
+
+    // An empty path disables the endpoint
+    void listen(const QString &path);
+    QByteArray render() const;
+
+signals:
+    void message(QString msg);
+
+private slots:
+    void onNewConnection();
+
+private:
+    static const int MAX_REQUEST_SIZE { 8192 };
+    static const int REQUEST_TIMEOUT_MS { 5000 };
+
+    SessionList sessions;
+    QLocalServer *server;
+    QString path;
+
+    static QString escapeLabel(const QString &value);
+};
+
+#endif // METRICSSERVER_H
@@ -0,0 +1,338 @@
+#include <arpa/inet.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "netlinkbatch.h"
+
+// A kernel that does not answer in this time will not answer at all
+static const int RECEIVE_TIMEOUT_S = 2;
+
+/* The address in network byte order, 4 or 16 bytes */
+static QByteArray addressBytes(const QHostAddress &address)
+{
+    if (address.protocol() == QAbstractSocket::IPv4Protocol) {
+        const quint32 value = htonl(address.toIPv4Address());
+        return QByteArray(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    const Q_IPV6ADDR value = address.toIPv6Address();
+    return QByteArray(reinterpret_cast<const char *>(value.c), sizeof(value.c));
+}
+
+static int familyOf(const QHostAddress &address)
+{
+    return address.protocol() == QAbstractSocket::IPv4Protocol ? AF_INET : AF_INET6;
+}
+
+NetlinkBatch::NetlinkBatch()
+{
+    fd = ::socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (fd < 0) {
+        return;
+    }
+
+    struct timeval timeout { RECEIVE_TIMEOUT_S, 0 };
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    // Extended acknowledgements would copy every failed request back, the header is enough
+    const int capped = 1;
+    ::setsockopt(fd, SOL_NETLINK, NETLINK_CAP_ACK, &capped, sizeof(capped));
+}
+
+NetlinkBatch::~NetlinkBatch()
+{
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+bool NetlinkBatch::isValid() const
+{
+    return fd >= 0;
+}
+
+int NetlinkBatch::size() const
+{
+    return offsets.size();
+}
+
+void NetlinkBatch::appendRequest(quint16 type, quint16 flags, const void *payload, int payloadLength)
+{
+    const int offset = buffer.size();
+    buffer.append(NLMSG_SPACE(payloadLength), '\0');
+
+    auto *header = reinterpret_cast<struct nlmsghdr *>(buffer.data() + offset);
+    header->nlmsg_len = NLMSG_LENGTH(payloadLength);
+    header->nlmsg_type = type;
+    header->nlmsg_flags = NLM_F_REQUEST | flags;
+    header->nlmsg_seq = ++sequence;
+    memcpy(NLMSG_DATA(header), payload, payloadLength);
+
+    offsets.append(offset);
+}
+
+/* Appended to the last request */
+void NetlinkBatch::appendAttribute(quint16 type, const void *data, int length)
+{
+    const int offset = buffer.size();
+    buffer.append(RTA_SPACE(length), '\0');
+
+    auto *attribute = reinterpret_cast<struct rtattr *>(buffer.data() + offset);
+    attribute->rta_type = type;
+    attribute->rta_len = RTA_LENGTH(length);
+    memcpy(RTA_DATA(attribute), data, length);
+
+    auto *header = reinterpret_cast<struct nlmsghdr *>(buffer.data() + offsets.last());
+    header->nlmsg_len = buffer.size() - offsets.last();
+}
+
+void NetlinkBatch::setLink(int ifindex, int mtu, bool up)
+{
+    struct ifinfomsg info;
+    memset(&info, 0, sizeof(info));
+    info.ifi_family = AF_UNSPEC;
+    info.ifi_index = ifindex;
+    info.ifi_change = IFF_UP;
+    info.ifi_flags = up ? IFF_UP : 0;
+    appendRequest(RTM_NEWLINK, 0, &info, sizeof(info));
+
+    if (mtu > 0) {
+        const quint32 value = quint32(mtu);
+        appendAttribute(IFLA_MTU, &value, sizeof(value));
+    }
+}
+
+void NetlinkBatch::addAddress(int ifindex, const QHostAddress &address, int prefixLength)
+{
+    appendAddress(RTM_NEWADDR, NLM_F_CREATE | NLM_F_REPLACE, ifindex, address, prefixLength);
+}
+
+void NetlinkBatch::deleteAddress(int ifindex, const QHostAddress &address, int prefixLength)
+{
+    appendAddress(RTM_DELADDR, 0, ifindex, address, prefixLength);
+}
+
+void NetlinkBatch::appendAddress(quint16 type, quint16 flags, int ifindex, const QHostAddress &address, int prefixLength)
+{
+    struct ifaddrmsg info;
+    memset(&info, 0, sizeof(info));
+    info.ifa_family = familyOf(address);
+    info.ifa_prefixlen = prefixLength;
+    info.ifa_scope = RT_SCOPE_UNIVERSE;
+    info.ifa_index = ifindex;
+    appendRequest(type, flags, &info, sizeof(info));
+
+    const QByteArray bytes = addressBytes(address);
+    appendAttribute(IFA_LOCAL, bytes.constData(), bytes.size());
+    appendAttribute(IFA_ADDRESS, bytes.constData(), bytes.size());
+}
+
+void NetlinkBatch::appendRoute(quint16 type, quint16 flags, int ifindex, const QHostAddress &destination, int prefixLength, const QHostAddress &gateway)
+{
+    struct rtmsg route;
+    memset(&route, 0, sizeof(route));
+    route.rtm_family = familyOf(destination);
+    route.rtm_dst_len = prefixLength;
+    route.rtm_table = RT_TABLE_MAIN;
+    if (type == RTM_NEWROUTE) {
+        route.rtm_protocol = RTPROT_STATIC;
+        route.rtm_scope = gateway.isNull() ? RT_SCOPE_LINK : RT_SCOPE_UNIVERSE;
+        route.rtm_type = RTN_UNICAST;
+    } else {
+        route.rtm_scope = RT_SCOPE_NOWHERE;
+    }
+    appendRequest(type, flags, &route, sizeof(route));
+
+    if (prefixLength > 0) {
+        const QByteArray bytes = addressBytes(destination);
+        appendAttribute(RTA_DST, bytes.constData(), bytes.size());
+    }
+    if (!gateway.isNull()) {
+        const QByteArray bytes = addressBytes(gateway);
+        appendAttribute(RTA_GATEWAY, bytes.constData(), bytes.size());
+    }
+    if (ifindex > 0) {
+        const quint32 value = quint32(ifindex);
+        appendAttribute(RTA_OIF, &value, sizeof(value));
+    }
+}
+
+void NetlinkBatch::addRoute(int ifindex, const QHostAddress &destination, int prefixLength, const QHostAddress &gateway)
+{
+    appendRoute(RTM_NEWROUTE, NLM_F_CREATE | NLM_F_REPLACE, ifindex, destination, prefixLength, gateway);
+}
+
+void NetlinkBatch::deleteRoute(int ifindex, const QHostAddress &destination, int prefixLength, const QHostAddress &gateway)
+{
+    appendRoute(RTM_DELROUTE, 0, ifindex, destination, prefixLength, gateway);
+}
+
+int NetlinkBatch::commit(QStringList *errors)
+{
+    int failures = 0;
+
+    if (fd < 0) {
+        failures = offsets.size();
+        if (errors && failures > 0) {
+            *errors << "No rtnetlink socket";
+        }
+    } else {
+        int first = 0;
+        while (first < offsets.size()) {
+            // As many whole requests as fit in one datagram, at least one
+            int last = first;
+            while (last + 1 < offsets.size() && requestEnd(last + 1) - offsets.at(first) <= MAX_DATAGRAM_SIZE) {
+                last++;
+            }
+
+            if (!sendDatagram(first, last, failures, errors)) {
+                failures += offsets.size() - first;
+                break;
+            }
+            first = last + 1;
+        }
+    }
+
+    buffer.clear();
+    offsets.clear();
+    return failures;
+}
+
+int NetlinkBatch::requestEnd(int index) const
+{
+    return index + 1 < offsets.size() ? offsets.at(index + 1) : buffer.size();
+}
+
+bool NetlinkBatch::sendDatagram(int first, int last, int &failures, QStringList *errors)
+{
+    const int begin = offsets.at(first);
+    const int end = requestEnd(last);
+
+    auto *lastHeader = reinterpret_cast<struct nlmsghdr *>(buffer.data() + offsets.at(last));
+    lastHeader->nlmsg_flags |= NLM_F_ACK;
+    const quint32 lastSequence = lastHeader->nlmsg_seq;
+
+    struct sockaddr_nl kernel;
+    memset(&kernel, 0, sizeof(kernel));
+    kernel.nl_family = AF_NETLINK;
+
+    if (::sendto(fd, buffer.constData() + begin, end - begin, 0, reinterpret_cast<struct sockaddr *>(&kernel), sizeof(kernel)) < 0) {
+        if (errors) {
+            *errors << QString("rtnetlink send failed: %1").arg(QString::fromLocal8Bit(strerror(errno)));
+        }
+        return false;
+    }
+
+    alignas(struct nlmsghdr) char reply[16384];
+    for (;;) {
+        const ssize_t length = ::recv(fd, reply, sizeof(reply), 0);
+        if (length <= 0) {
+            if (errors) {
+                *errors << QString("rtnetlink receive failed: %1").arg(QString::fromLocal8Bit(strerror(errno)));
+            }
+            return false;
+        }
+
+        int remaining = int(length);
+        for (struct nlmsghdr *header = reinterpret_cast<struct nlmsghdr *>(reply);
+             NLMSG_OK(header, remaining);
+             header = NLMSG_NEXT(header, remaining)) {
+            if (header->nlmsg_type != NLMSG_ERROR) {
+                continue;
+            }
+
+            const auto *error = static_cast<const struct nlmsgerr *>(NLMSG_DATA(header));
+            const int code = -error->error;
+            const bool tolerated = code == 0
+                || (code == ESRCH && error->msg.nlmsg_type == RTM_DELROUTE)
+                || (code == EADDRNOTAVAIL && error->msg.nlmsg_type == RTM_DELADDR)
+                || (code == EEXIST && error->msg.nlmsg_type == RTM_NEWADDR);
+            if (!tolerated) {
+                failures++;
+                if (errors) {
+                    *errors << QString("rtnetlink request %1 (type %2) failed: %3")
+                        .arg(error->msg.nlmsg_seq).arg(error->msg.nlmsg_type).arg(QString::fromLocal8Bit(strerror(code)));
+                }
+            }
+
+            if (header->nlmsg_seq == lastSequence) {
+                return true;
+            }
+        }
+    }
+}
+
+bool NetlinkBatch::lookupRoute(const QHostAddress &destination, QHostAddress &gateway, int &ifindex)
+{
+    if (fd < 0 || destination.isNull()) {
+        return false;
+    }
+
+    const QByteArray bytes = addressBytes(destination);
+    const quint32 requestSequence = ++sequence;
+
+    struct {
+        struct nlmsghdr header;
+        struct rtmsg route;
+        char attributes[RTA_SPACE(16)];
+    } request;
+    memset(&request, 0, sizeof(request));
+    request.header.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg)) + RTA_SPACE(bytes.size());
+    request.header.nlmsg_type = RTM_GETROUTE;
+    request.header.nlmsg_flags = NLM_F_REQUEST;
+    request.header.nlmsg_seq = requestSequence;
+    request.route.rtm_family = familyOf(destination);
+    request.route.rtm_dst_len = bytes.size() * 8;
+
+    auto *attribute = reinterpret_cast<struct rtattr *>(request.attributes);
+    attribute->rta_type = RTA_DST;
+    attribute->rta_len = RTA_LENGTH(bytes.size());
+    memcpy(RTA_DATA(attribute), bytes.constData(), bytes.size());
+
+    if (::send(fd, &request, request.header.nlmsg_len, 0) < 0) {
+        return false;
+    }
+
+    alignas(struct nlmsghdr) char reply[4096];
+    const ssize_t length = ::recv(fd, reply, sizeof(reply), 0);
+    if (length <= 0) {
+        return false;
+    }
+
+    int remaining = int(length);
+    for (struct nlmsghdr *header = reinterpret_cast<struct nlmsghdr *>(reply);
+         NLMSG_OK(header, remaining);
+         header = NLMSG_NEXT(header, remaining)) {
+        if (header->nlmsg_type != RTM_NEWROUTE || header->nlmsg_seq != requestSequence) {
+            continue;
+        }
+
+        auto *route = static_cast<struct rtmsg *>(NLMSG_DATA(header));
+        gateway = QHostAddress();
+        ifindex = 0;
+
+        int attributesLength = int(RTM_PAYLOAD(header));
+        for (struct rtattr *a = RTM_RTA(route); RTA_OK(a, attributesLength); a = RTA_NEXT(a, attributesLength)) {
+            if (a->rta_type == RTA_OIF && RTA_PAYLOAD(a) >= sizeof(quint32)) {
+                quint32 value;
+                memcpy(&value, RTA_DATA(a), sizeof(value));
+                ifindex = int(value);
+            } else if (a->rta_type == RTA_GATEWAY && RTA_PAYLOAD(a) == 4) {
+                quint32 value;
+                memcpy(&value, RTA_DATA(a), sizeof(value));
+                gateway = QHostAddress(ntohl(value));
+            } else if (a->rta_type == RTA_GATEWAY && RTA_PAYLOAD(a) == 16) {
+                gateway = QHostAddress(static_cast<const quint8 *>(RTA_DATA(a)));
+            }
+        }
+        return ifindex > 0;
+    }
+
+    return false;
+}
@@ -0,0 +1,65 @@
+#ifndef NETLINKBATCH_H
+#define NETLINKBATCH_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QList>
+#include <QtCore/QStringList>
+#include <QtNetwork/QHostAddress>
+
+/*
+ * rtnetlink requests queued and sent to the kernel in as few send() calls
+ * as possible.
+ *
+ * Only the last request of each datagram asks for an acknowledgement: the
+ * kernel handles the requests of a datagram in order and reports every
+ * failure on its own, so the acknowledgement of the last one tells that the
+ * whole datagram was processed. Installing thousands of routes costs a
+ * handful of system calls instead of one ip(8) process per route.
+ *
+ * The routes and addresses are added with NLM_F_REPLACE and a missing route
+ * or address is not an error on delete, so a batch can be applied again.
+ */
+class NetlinkBatch
+{
+public:
+    NetlinkBatch();
+    ~NetlinkBatch();
+
+    NetlinkBatch(const NetlinkBatch &) = delete;
+    NetlinkBatch &operator=(const NetlinkBatch &) = delete;
+
+    bool isValid() const;
+    int size() const;
+
+    void setLink(int ifindex, int mtu, bool up);
+    void addAddress(int ifindex, const QHostAddress &address, int prefixLength);
+    void deleteAddress(int ifindex, const QHostAddress &address, int prefixLength);
+    // Without a gateway the route is on-link, through the device
+    void addRoute(int ifindex, const QHostAddress &destination, int prefixLength, const QHostAddress &gateway = QHostAddress());
+    void deleteRoute(int ifindex, const QHostAddress &destination, int prefixLength, const QHostAddress &gateway = QHostAddress());
+
+    // Sends the queued requests, returns the number of requests that failed
+    int commit(QStringList *errors = nullptr);
+
+    // The next hop the kernel would use for the address (RTM_GETROUTE), the gateway is null when on-link
+    bool lookupRoute(const QHostAddress &destination, QHostAddress &gateway, int &ifindex);
+
+private:
+    // A datagram never exceeds this, the acknowledgements of one datagram fit the receive buffer
+    static const int MAX_DATAGRAM_SIZE { 32768 };
+
+    int fd { -1 };
+    quint32 sequence { 0 };
+    QByteArray buffer;
+    // Offset of each queued request in the buffer
+    QList<int> offsets;
+
+    void appendRequest(quint16 type, quint16 flags, const void *payload, int payloadLength);
+    void appendAddress(quint16 type, quint16 flags, int ifindex, const QHostAddress &address, int prefixLength);
+    void appendRoute(quint16 type, quint16 flags, int ifindex, const QHostAddress &destination, int prefixLength, const QHostAddress &gateway);
+    void appendAttribute(quint16 type, const void *data, int length);
+    int requestEnd(int index) const;
+    bool sendDatagram(int first, int last, int &failures, QStringList *errors);
+};
+
+#endif // NETLINKBATCH_H
@@ -0,0 +1,96 @@
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QMetaEnum>
+
+#include "openconnectparser.h"
+
+OpenconnectParser::OpenconnectParser(QObject *parent)
+    : QObject(parent)
+{
+}
+
+const QList<OpenconnectParser::Rule> &OpenconnectParser::rules()
+{
+    // The first matching rule wins, so the more specific needles come first
+    static const QList<Rule> table {
+        { QByteArrayMatcher("Connected as"), TunnelConfigured },
+        { QByteArrayMatcher("Configured as"), TunnelConfigured },
+        { QByteArrayMatcher("Configurado como"), TunnelConfigured },
+        { QByteArrayMatcher("Cookie was rejected"), AuthExpired },
+        { QByteArrayMatcher("Cookie is no longer valid"), AuthExpired },
+        { QByteArrayMatcher("Invalid cookie"), AuthExpired },
+        { QByteArrayMatcher("auth-failed"), AuthExpired },
+        { QByteArrayMatcher("using HTTPS instead"), HttpsFallback },
+        { QByteArrayMatcher("ESP session established"), EspUp },
+        { QByteArrayMatcher("ESP tunnel connected"), EspUp },
+        { QByteArrayMatcher("Established DTLS connection"), EspUp },
+        { QByteArrayMatcher("detected dead peer"), DpdTimeout },
+        { QByteArrayMatcher("GlobalProtect rekey"), Rekey },
+        { QByteArrayMatcher("Rekey due"), Rekey },
+        { QByteArrayMatcher("Attempting to reconnect"), Reconnecting },
+        { QByteArrayMatcher("Reconnecting"), Reconnecting },
+        { QByteArrayMatcher("Connected to "), PeerConnected },
+    };
+    return table;
+}
+
+void OpenconnectParser::feed(const QByteArray &data)
+{
+    buffer.append(data);
+
+    qsizetype start = 0;
+    qsizetype newline;
+    while ((newline = buffer.indexOf('\n', start)) >= 0) {
+        processLine(buffer.constData() + start, newline - start);
+        start = newline + 1;
+    }
+    buffer.remove(0, start);
+
+    if (buffer.size() > MAX_LINE_LENGTH) {
+        flush();
+    }
+}
+
+void OpenconnectParser::flush()
+{
+    if (!buffer.isEmpty()) {
+        processLine(buffer.constData(), buffer.size());
+        buffer.clear();
+    }
+}
+
+void OpenconnectParser::reset()
+{
+    buffer.clear();
+}
+
+void OpenconnectParser::processLine(const char *data, qsizetype length)
+{
+    if (length > 0 && data[length - 1] == '\r') {
+        length--;
+    }
+    if (length == 0) {
+        return;
+    }
+
+    const QString line = QString::fromUtf8(data, length);
+    emit lineReceived(line);
+
+    for (const Rule &rule : rules()) {
+        if (rule.matcher.indexIn(data, length) >= 0) {
+            emit eventDetected(rule.event, monotonicTimestamp(), line);
+            return;
+        }
+    }
+}
+
+QString OpenconnectParser::eventName(Event event)
+{
+    return QString::fromLatin1(QMetaEnum::fromType<Event>().valueToKey(event));
+}
+
+qint64 OpenconnectParser::monotonicTimestamp()
+{
+    QElapsedTimer timer;
+    timer.start();
+    return timer.msecsSinceReference();
+}
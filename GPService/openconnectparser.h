@@ -0,0 +1,64 @@
+#ifndef OPENCONNECTPARSER_H
+#define OPENCONNECTPARSER_H
+
+#include <QtCore/QObject>
+#include <QtCore/QByteArray>
+#include <QtCore/QByteArrayMatcher>
+#include <QtCore/QList>
+
+/*
+ * Incremental, line-framed tokenizer for the openconnect output.
+ *
+ * The pipe reads do not respect line boundaries, so the bytes are buffered
+ * until a full line is available and every complete line is matched once
+ * against a table of precompiled needles. One parser instance is needed per
+ * stream (stdout and stderr), because each stream is framed independently.
+ */
+class OpenconnectParser : public QObject
+{
+    Q_OBJECT
+public:
+    enum Event {
+        TunnelConfigured,
+        EspUp,
+        HttpsFallback,
+        Rekey,
+        DpdTimeout,
+        Reconnecting,
+        AuthExpired,
+        PeerConnected,
+    };
+    Q_ENUM(Event)
+
+    explicit OpenconnectParser(QObject *parent = nullptr);
+
+    // Feed a raw chunk read from the pipe, emits the events of every complete line
+    void feed(const QByteArray &data);
+    // Process the trailing partial line, if any (e.g. when the process exited)
+    void flush();
+    void reset();
+
+    static QString eventName(Event event);
+    // Milliseconds of the monotonic clock, comparable across processes on the same host
+    static qint64 monotonicTimestamp();
+
+signals:
+    void lineReceived(const QString &line);
+    void eventDetected(OpenconnectParser::Event event, qint64 timestamp, const QString &line);
+
+private:
+    struct Rule {
+        QByteArrayMatcher matcher;
+        Event event;
+    };
+
+    // Guard against a stream that never sends a newline
+    static const int MAX_LINE_LENGTH { 64 * 1024 };
+
+    QByteArray buffer;
+
+    static const QList<Rule> &rules();
+    void processLine(const char *data, qsizetype length);
+};
+
+#endif // OPENCONNECTPARSER_H
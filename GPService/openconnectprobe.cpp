@@ -0,0 +1,179 @@
+#include <QtCore/QFileInfo>
+#include <QtCore/QDir>
+#include <QtCore/QSet>
+#include <QtCore/QVariant>
+#include <QtCore/QRegularExpression>
+#include <QtCore/QRegularExpressionMatch>
+#include <sys/stat.h>
+
+#include "openconnectprobe.h"
+
+OpenconnectProbe::OpenconnectProbe(QObject *parent)
+    : QObject(parent)
+    , process(new QProcess(this))
+    , watcher(new QFileSystemWatcher(this))
+    , debounceTimer(new QTimer(this))
+{
+    QObject::connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this, &OpenconnectProbe::onProcessFinished);
+    QObject::connect(process, &QProcess::errorOccurred, this, &OpenconnectProbe::onProcessError);
+
+    // Package upgrades touch the directories several times in a row, probe once they settle
+    debounceTimer->setSingleShot(true);
+    debounceTimer->setInterval(1000);
+    QObject::connect(debounceTimer, &QTimer::timeout, this, &OpenconnectProbe::refresh);
+
+    QSet<QString> dirs;
+    for (const QString &path : binaryPaths) {
+        const QString dir = QFileInfo(path).absolutePath();
+        if (!dirs.contains(dir) && QFileInfo::exists(dir)) {
+            dirs.insert(dir);
+            watcher->addPath(dir);
+        }
+    }
+    QObject::connect(watcher, &QFileSystemWatcher::directoryChanged, debounceTimer, QOverload<>::of(&QTimer::start));
+    QObject::connect(watcher, &QFileSystemWatcher::fileChanged, debounceTimer, QOverload<>::of(&QTimer::start));
+}
+
+bool OpenconnectProbe::lookup(Result &result)
+{
+    for (const QString &path : binaryPaths) {
+        struct stat st;
+        if (::stat(path.toLocal8Bit().constData(), &st) == 0 && S_ISREG(st.st_mode)) {
+            result.path = path;
+            result.inode = st.st_ino;
+            result.mtime = qint64(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool OpenconnectProbe::sameBinary(const Result &a, const Result &b)
+{
+    return a.path == b.path && a.inode == b.inode && a.mtime == b.mtime;
+}
+
+bool OpenconnectProbe::isReady() const
+{
+    if (stage != Idle || !hasResult) {
+        return false;
+    }
+
+    Result current;
+    if (!lookup(current)) {
+        return cached.path.isEmpty();
+    }
+    return sameBinary(cached, current);
+}
+
+const OpenconnectProbe::Result &OpenconnectProbe::result() const
+{
+    return cached;
+}
+
+void OpenconnectProbe::refresh()
+{
+    if (stage != Idle) {
+        return;
+    }
+
+    Result current;
+    if (!lookup(current)) {
+        if (!hasResult || !cached.path.isEmpty()) {
+            emit message("Could not find the openconnect binary in any of the known locations");
+        }
+        cached = current;
+        cached.error = "The OpenConect CLI was not found, make sure it has been installed!";
+        hasResult = true;
+        emit finished();
+        return;
+    }
+
+    if (hasResult && sameBinary(cached, current)) {
+        emit finished();
+        return;
+    }
+
+    emit message("Probing the openconnect binary at " + current.path);
+
+    probing = current;
+    stage = Version;
+    process->start(probing.path, QStringList("--version"));
+}
+
+void OpenconnectProbe::onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    Q_UNUSED(exitCode)
+    Q_UNUSED(exitStatus)
+
+    QString output = process->readAllStandardError() + process->readAllStandardOutput();
+
+    if (stage == Version) {
+        parseVersion(output);
+        stage = Help;
+        process->start(probing.path, QStringList("--help"));
+    } else if (stage == Help) {
+        probing.resolveSupported = output.contains("--resolve");
+        finish();
+    }
+}
+
+void OpenconnectProbe::onProcessError(QProcess::ProcessError error)
+{
+    // The other errors are followed by the finished signal
+    if (error != QProcess::FailedToStart || stage == Idle) {
+        return;
+    }
+
+    emit message("Failed to run " + probing.path + ": " + QVariant::fromValue(error).toString());
+    if (stage == Version) {
+        probing.valid = false;
+        probing.error = "Failed to run the OpenConnect CLI at " + probing.path;
+    }
+    finish();
+}
+
+void OpenconnectProbe::parseVersion(const QString &output)
+{
+    QRegularExpression re("v(\\d+).*?(\\s|\\n)");
+    QRegularExpressionMatch match = re.match(output);
+
+    if (match.hasMatch()) {
+        emit message("Output of `openconnect --version`: " + output);
+
+        probing.version = match.captured(0).trimmed();
+        probing.majorVersion = match.captured(1).toInt();
+
+        if (probing.majorVersion < MIN_MAJOR_VERSION) {
+            probing.valid = false;
+            probing.error = "The OpenConnect version must greater than v8.0.0, got " + probing.version;
+            return;
+        }
+    } else {
+        emit message("Failed to parse the OpenConnect version from " + output);
+    }
+
+    QRegularExpression featuresRe("Features present:([^\\n]*)");
+    QRegularExpressionMatch features = featuresRe.match(output);
+    probing.espSupported = features.hasMatch() && features.captured(1).contains("ESP");
+    probing.valid = true;
+}
+
+void OpenconnectProbe::finish()
+{
+    if (!cached.path.isEmpty() && cached.path != probing.path) {
+        watcher->removePath(cached.path);
+    }
+    if (!watcher->files().contains(probing.path)) {
+        watcher->addPath(probing.path);
+    }
+
+    cached = probing;
+    hasResult = true;
+    stage = Idle;
+
+    emit message(QString("OpenConnect probe finished: path=%1, version=%2, esp=%3, resolve=%4")
+                 .arg(cached.path, cached.version.isEmpty() ? "<unknown>" : cached.version,
+                      cached.espSupported ? "yes" : "no", cached.resolveSupported ? "yes" : "no"));
+    emit finished();
+}
@@ -0,0 +1,86 @@
+#ifndef OPENCONNECTPROBE_H
+#define OPENCONNECTPROBE_H
+
+#include <QtCore/QObject>
+#include <QtCore/QProcess>
+#include <QtCore/QFileSystemWatcher>
+#include <QtCore/QTimer>
+
+static const QString binaryPaths[] {
+    "/usr/local/bin/openconnect",
+    "/usr/local/sbin/openconnect",
+    "/usr/bin/openconnect",
+    "/usr/sbin/openconnect",
+    "/opt/bin/openconnect",
+    "/opt/sbin/openconnect"
+};
+
+/*
+ * Discovers the openconnect binary and probes its version and features.
+ *
+ * The result is cached by the binary's path, inode and mtime. The probe runs
+ * asynchronously at startup and again only when one of the candidate
+ * directories changes (inotify through QFileSystemWatcher) and the cache key
+ * no longer matches, so a connect never has to spawn the probe process.
+ */
+class OpenconnectProbe : public QObject
+{
+    Q_OBJECT
+public:
+    struct Result {
+        QString path;
+        quint64 inode { 0 };
+        qint64 mtime { 0 };
+
+        QString version;
+        int majorVersion { 0 };
+        bool espSupported { false };
+        bool resolveSupported { false };
+
+        // The binary exists and the version is acceptable
+        bool valid { false };
+        QString error;
+    };
+
+    explicit OpenconnectProbe(QObject *parent = nullptr);
+
+    // Start probing if the cache is stale, emits finished() in any case
+    void refresh();
+
+    // True when no probe is running and the cache matches the binary on disk
+    bool isReady() const;
+    const Result &result() const;
+
+signals:
+    void finished();
+    void message(QString msg);
+
+private slots:
+    void onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void onProcessError(QProcess::ProcessError error);
+
+private:
+    enum Stage {
+        Idle,
+        Version,
+        Help,
+    };
+
+    static const int MIN_MAJOR_VERSION { 8 };
+
+    QProcess *process;
+    QFileSystemWatcher *watcher;
+    QTimer *debounceTimer;
+
+    Result cached;
+    Result probing;
+    bool hasResult { false };
+    Stage stage { Idle };
+
+    static bool lookup(Result &result);
+    static bool sameBinary(const Result &a, const Result &b);
+    void parseVersion(const QString &output);
+    void finish();
+};
+
+#endif // OPENCONNECTPROBE_H
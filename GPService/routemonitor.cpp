@@ -0,0 +1,279 @@
+#include <arpa/inet.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <QtCore/QFileInfo>
+#include <QtCore/QMap>
+#include <QtNetwork/QHostAddress>
+
+#include "routemonitor.h"
+
+// A kernel that does not answer a dump in this time will not answer at all
+static const int RECEIVE_TIMEOUT_S = 2;
+
+static QHostAddress addressOf(const struct rtattr *attribute)
+{
+    if (RTA_PAYLOAD(attribute) == 4) {
+        quint32 value;
+        memcpy(&value, RTA_DATA(attribute), sizeof(value));
+        return QHostAddress(ntohl(value));
+    }
+    if (RTA_PAYLOAD(attribute) == 16) {
+        return QHostAddress(static_cast<const quint8 *>(RTA_DATA(attribute)));
+    }
+    return QHostAddress();
+}
+
+RouteMonitor::RouteMonitor(QObject *parent)
+    : QObject(parent)
+    , settleTimer(new QTimer(this))
+{
+    settleTimer->setSingleShot(true);
+    settleTimer->setInterval(SETTLE_DELAY_MS);
+    QObject::connect(settleTimer, &QTimer::timeout, this, &RouteMonitor::onSettled);
+}
+
+RouteMonitor::~RouteMonitor()
+{
+    if (monitorFd >= 0) {
+        ::close(monitorFd);
+    }
+    if (queryFd >= 0) {
+        ::close(queryFd);
+    }
+}
+
+void RouteMonitor::start()
+{
+    if (monitorFd >= 0) {
+        return;
+    }
+
+    monitorFd = ::socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_ROUTE);
+    queryFd = ::socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (monitorFd < 0 || queryFd < 0) {
+        emit message(QString("Cannot watch the network changes: %1").arg(QString::fromLocal8Bit(strerror(errno))));
+        return;
+    }
+
+    struct sockaddr_nl local;
+    memset(&local, 0, sizeof(local));
+    local.nl_family = AF_NETLINK;
+    local.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR | RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE;
+    if (::bind(monitorFd, reinterpret_cast<struct sockaddr *>(&local), sizeof(local)) < 0) {
+        emit message(QString("Cannot watch the network changes: %1").arg(QString::fromLocal8Bit(strerror(errno))));
+        ::close(monitorFd);
+        monitorFd = -1;
+        return;
+    }
+
+    struct timeval timeout { RECEIVE_TIMEOUT_S, 0 };
+    ::setsockopt(queryFd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    notifier = new QSocketNotifier(monitorFd, QSocketNotifier::Read, this);
+    QObject::connect(notifier, &QSocketNotifier::activated, this, &RouteMonitor::onReadable);
+
+    readRoutes(current);
+    routeLost = current.isEmpty();
+    emit message("Default route: " + (current.isEmpty() ? "none" : route()));
+}
+
+QString RouteMonitor::route() const
+{
+    return current.join("; ");
+}
+
+void RouteMonitor::onReadable()
+{
+    // The content does not matter, the routes are read again once it settles
+    alignas(struct nlmsghdr) char buffer[8192];
+    for (;;) {
+        const ssize_t length = ::recv(monitorFd, buffer, sizeof(buffer), 0);
+        // ENOBUFS: notifications were lost, which is a change as well
+        if (length > 0 || (length < 0 && (errno == EINTR || errno == ENOBUFS))) {
+            continue;
+        }
+        if (length < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            emit message(QString("Reading the network changes failed: %1").arg(QString::fromLocal8Bit(strerror(errno))));
+        }
+        break;
+    }
+
+    settleTimer->start();
+}
+
+void RouteMonitor::onSettled()
+{
+    QStringList routes;
+    if (!readRoutes(routes)) {
+        // Half a picture would look like a change
+        emit message("Reading the routes failed, keeping the previous ones");
+        return;
+    }
+
+    // A full tunnel replaces the default route with its own device, and the vpnc-script puts the
+    // saved one back when the tunnel goes down: only a way out other than the last one is a change
+    if (routes.isEmpty()) {
+        if (!routeLost) {
+            routeLost = true;
+            emit message("No default route outside of the tunnels, waiting for a network");
+        }
+        return;
+    }
+    routeLost = false;
+    if (routes == current) {
+        return;
+    }
+
+    current = routes;
+    emit message("The default route changed: " + route());
+    emit changed(route());
+}
+
+/* The default routes of the main table, with the global addresses of their interfaces */
+bool RouteMonitor::readRoutes(QStringList &routes)
+{
+    routes.clear();
+
+    // Interface index to the gateways of its default routes
+    QMap<int, QStringList> gateways;
+    const bool routesRead = dump(RTM_GETROUTE, [&gateways](const struct nlmsghdr *header) {
+        if (header->nlmsg_type != RTM_NEWROUTE) {
+            return;
+        }
+
+        const auto *route = static_cast<const struct rtmsg *>(NLMSG_DATA(header));
+        if (route->rtm_dst_len != 0 || route->rtm_type != RTN_UNICAST) {
+            return;
+        }
+
+        int table = route->rtm_table;
+        int ifindex = 0;
+        QHostAddress gateway;
+        int attributesLength = int(RTM_PAYLOAD(header));
+        for (const struct rtattr *a = RTM_RTA(route); RTA_OK(a, attributesLength); a = RTA_NEXT(a, attributesLength)) {
+            if (a->rta_type == RTA_TABLE && RTA_PAYLOAD(a) >= sizeof(quint32)) {
+                quint32 value;
+                memcpy(&value, RTA_DATA(a), sizeof(value));
+                table = int(value);
+            } else if (a->rta_type == RTA_OIF && RTA_PAYLOAD(a) >= sizeof(quint32)) {
+                quint32 value;
+                memcpy(&value, RTA_DATA(a), sizeof(value));
+                ifindex = int(value);
+            } else if (a->rta_type == RTA_GATEWAY) {
+                gateway = addressOf(a);
+            }
+        }
+
+        if (table == RT_TABLE_MAIN && ifindex > 0) {
+            gateways[ifindex] << (gateway.isNull() ? "on-link" : gateway.toString());
+        }
+    });
+
+    // The tunnels, ours or not, are not a way out
+    for (auto it = gateways.begin(); it != gateways.end();) {
+        char name[IF_NAMESIZE] = {};
+        if (!if_indextoname(unsigned(it.key()), name) || isTunnel(QString::fromLocal8Bit(name))) {
+            it = gateways.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if (!routesRead || gateways.isEmpty()) {
+        return routesRead;
+    }
+
+    // A new network may keep the same gateway address, e.g. 192.168.1.1 everywhere
+    QMap<int, QStringList> addresses;
+    const bool addressesRead = dump(RTM_GETADDR, [&gateways, &addresses](const struct nlmsghdr *header) {
+        if (header->nlmsg_type != RTM_NEWADDR) {
+            return;
+        }
+
+        const auto *info = static_cast<const struct ifaddrmsg *>(NLMSG_DATA(header));
+        if (info->ifa_scope != RT_SCOPE_UNIVERSE || !gateways.contains(int(info->ifa_index))) {
+            return;
+        }
+
+        QHostAddress address;
+        int attributesLength = int(IFA_PAYLOAD(header));
+        for (const struct rtattr *a = IFA_RTA(info); RTA_OK(a, attributesLength); a = RTA_NEXT(a, attributesLength)) {
+            // IFA_LOCAL is the address of the interface on point-to-point links, IFA_ADDRESS the peer
+            if (a->rta_type == IFA_LOCAL || (a->rta_type == IFA_ADDRESS && address.isNull())) {
+                address = addressOf(a);
+            }
+        }
+        if (!address.isNull()) {
+            addresses[int(info->ifa_index)] << address.toString();
+        }
+    });
+
+    for (auto it = gateways.cbegin(); it != gateways.cend(); ++it) {
+        char name[IF_NAMESIZE] = {};
+        if_indextoname(unsigned(it.key()), name);
+
+        QStringList via = it.value();
+        QStringList local = addresses.value(it.key());
+        via.sort();
+        local.sort();
+        routes << QString("%1 via %2 (%3)").arg(QString::fromLocal8Bit(name), via.join(", "), local.join(", "));
+    }
+    routes.sort();
+    return addressesRead;
+}
+
+bool RouteMonitor::dump(quint16 type, const std::function<void(const struct nlmsghdr *)> &handler)
+{
+    const quint32 requestSequence = ++sequence;
+
+    struct {
+        struct nlmsghdr header;
+        struct rtgenmsg family;
+    } request;
+    memset(&request, 0, sizeof(request));
+    request.header.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtgenmsg));
+    request.header.nlmsg_type = type;
+    request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    request.header.nlmsg_seq = requestSequence;
+    request.family.rtgen_family = AF_UNSPEC;
+
+    if (::send(queryFd, &request, request.header.nlmsg_len, 0) < 0) {
+        return false;
+    }
+
+    alignas(struct nlmsghdr) char reply[32768];
+    for (;;) {
+        const ssize_t length = ::recv(queryFd, reply, sizeof(reply), 0);
+        if (length <= 0) {
+            return false;
+        }
+
+        int remaining = int(length);
+        for (const struct nlmsghdr *header = reinterpret_cast<const struct nlmsghdr *>(reply);
+             NLMSG_OK(header, remaining);
+             header = NLMSG_NEXT(header, remaining)) {
+            if (header->nlmsg_seq != requestSequence) {
+                continue;
+            }
+            if (header->nlmsg_type == NLMSG_DONE) {
+                return true;
+            }
+            if (header->nlmsg_type == NLMSG_ERROR) {
+                return false;
+            }
+            handler(header);
+        }
+    }
+}
+
+/* The tun and tap devices, openconnect's included */
+bool RouteMonitor::isTunnel(const QString &interfaceName)
+{
+    return QFileInfo::exists("/sys/class/net/" + interfaceName + "/tun_flags");
+}
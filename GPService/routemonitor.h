@@ -0,0 +1,62 @@
+#ifndef ROUTEMONITOR_H
+#define ROUTEMONITOR_H
+
+#include <QtCore/QObject>
+#include <QtCore/QSocketNotifier>
+#include <QtCore/QStringList>
+#include <QtCore/QTimer>
+#include <functional>
+
+struct nlmsghdr;
+
+/*
+ * Tells when the way out to the network changed, e.g. a new Wi-Fi network
+ * or a cable plugged in.
+ *
+ * The rtnetlink link, address and route multicast groups are watched. The
+ * notifications only start a settle timer: once the kernel is quiet, the
+ * default routes and the global addresses of their interfaces are read
+ * again, and changed() is emitted when they differ from the last ones that
+ * were not empty. The tun devices are left out, and a default route that
+ * disappears and comes back the same is not a change, so the tunnels coming
+ * up or going down (a full tunnel replaces the default route) never count.
+ */
+class RouteMonitor : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RouteMonitor(QObject *parent = nullptr);
+    ~RouteMonitor();
+
+    void start();
+    // The default routes and their addresses, e.g. "wlan0 via 192.168.1.1 (192.168.1.20)"
+    QString route() const;
+
+signals:
+    // Only a new way out, losing the default route is not reported
+    void changed(QString route);
+    void message(QString msg);
+
+private slots:
+    void onReadable();
+    void onSettled();
+
+private:
+    // A new network is announced in a burst of link, address and route changes
+    static const int SETTLE_DELAY_MS { 1000 };
+
+    int monitorFd { -1 };
+    int queryFd { -1 };
+    quint32 sequence { 0 };
+    QSocketNotifier *notifier = nullptr;
+    QTimer *settleTimer;
+    // The last default routes outside of the tunnels, kept while there is none
+    QStringList current;
+    bool routeLost = false;
+
+    bool readRoutes(QStringList &routes);
+    bool dump(quint16 type, const std::function<void(const struct nlmsghdr *)> &handler);
+    static bool isTunnel(const QString &interfaceName);
+};
+
+#endif // ROUTEMONITOR_H
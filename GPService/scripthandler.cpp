@@ -0,0 +1,668 @@
+#include <QtCore/QCoreApplication>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDir>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QRegularExpression>
+#include <QtCore/QSaveFile>
+#include <QtCore/QTimer>
+#include <QtDBus/QDBusArgument>
+#include <QtDBus/QDBusConnection>
+#include <QtDBus/QDBusMessage>
+#include <QtDBus/QDBusMetaType>
+#include <QtDBus/QDBusPendingCallWatcher>
+#include <QtDBus/QDBusPendingReply>
+#include <QtNetwork/QLocalSocket>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <net/if.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "scripthandler.h"
+#include "netlinkbatch.h"
+
+extern char **environ;
+
+// The variables of openconnect the handler needs, nothing else leaves the helper
+static const char *const forwardedPrefixes[] {
+    "reason=",
+    "TUNDEV=",
+    "VPNGATEWAY=",
+    "VPNPID=",
+    "INTERNAL_IP4_",
+    "INTERNAL_IP6_",
+    "CISCO_",
+};
+
+/* The a(iay) and a(sb) arguments of the systemd-resolved link calls */
+struct ResolvedDnsServer {
+    qint32 family;
+    QByteArray address;
+};
+Q_DECLARE_METATYPE(ResolvedDnsServer)
+
+struct ResolvedDomain {
+    QString domain;
+    bool routingOnly;
+};
+Q_DECLARE_METATYPE(ResolvedDomain)
+
+QDBusArgument &operator<<(QDBusArgument &argument, const ResolvedDnsServer &server)
+{
+    argument.beginStructure();
+    argument << server.family << server.address;
+    argument.endStructure();
+    return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, ResolvedDnsServer &server)
+{
+    argument.beginStructure();
+    argument >> server.family >> server.address;
+    argument.endStructure();
+    return argument;
+}
+
+QDBusArgument &operator<<(QDBusArgument &argument, const ResolvedDomain &domain)
+{
+    argument.beginStructure();
+    argument << domain.domain << domain.routingOnly;
+    argument.endStructure();
+    return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, ResolvedDomain &domain)
+{
+    argument.beginStructure();
+    argument >> domain.domain >> domain.routingOnly;
+    argument.endStructure();
+    return argument;
+}
+
+ScriptHandler::ScriptHandler(QObject *parent)
+    : QObject(parent)
+    , server(new QLocalServer(this))
+{
+    qDBusRegisterMetaType<ResolvedDnsServer>();
+    qDBusRegisterMetaType<QList<ResolvedDnsServer>>();
+    qDBusRegisterMetaType<ResolvedDomain>();
+    qDBusRegisterMetaType<QList<ResolvedDomain>>();
+
+    // Only openconnect, run by root, has anything to say here
+    server->setSocketOptions(QLocalServer::UserAccessOption);
+    QObject::connect(server, &QLocalServer::newConnection, this, &ScriptHandler::onNewConnection);
+}
+
+void ScriptHandler::listen(const QString &newPath)
+{
+    server->close();
+    path = newPath;
+    statePath = QFileInfo(path).absolutePath() + "/script.state";
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QLocalServer::removeServer(path);
+    loadState();
+
+    if (!server->listen(path)) {
+        emit message("Failed to listen for the built-in vpnc-script on " + path + ": " + server->errorString());
+    }
+}
+
+bool ScriptHandler::isListening() const
+{
+    return server->isListening();
+}
+
+QString ScriptHandler::command() const
+{
+    // Run by openconnect through /bin/sh -c
+    auto quote = [](QString value) { return "'" + value.replace("'", "'\\''") + "'"; };
+    return quote(QCoreApplication::applicationFilePath()) + " --script-helper " + quote(path);
+}
+
+void ScriptHandler::onNewConnection()
+{
+    while (QLocalSocket *socket = server->nextPendingConnection()) {
+        QObject::connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+        QTimer::singleShot(REQUEST_TIMEOUT_MS, socket, [socket]() { socket->abort(); });
+
+        struct ucred peer;
+        socklen_t length = sizeof(peer);
+        if (::getsockopt(int(socket->socketDescriptor()), SOL_SOCKET, SO_PEERCRED, &peer, &length) != 0 || peer.uid != 0) {
+            emit message("Rejecting a vpnc-script request not coming from root");
+            socket->abort();
+            continue;
+        }
+
+        QObject::connect(socket, &QLocalSocket::readyRead, this, [this, socket]() {
+            // The request is a list of NUL terminated variables, closed by an empty one
+            const QByteArray request = socket->peek(MAX_REQUEST_SIZE);
+            const bool complete = request == QByteArray(1, '\0') || request.endsWith(QByteArray(2, '\0'));
+            if (!complete) {
+                if (request.size() >= MAX_REQUEST_SIZE) {
+                    socket->abort();
+                }
+                return;
+            }
+            QObject::disconnect(socket, &QLocalSocket::readyRead, this, nullptr);
+            socket->readAll();
+
+            QString error;
+            const bool ok = handle(parseEnvironment(request), error);
+            socket->write(ok ? QByteArray("ok\n") : "error: " + error.toUtf8() + "\n");
+            socket->disconnectFromServer();
+        });
+    }
+}
+
+QHash<QString, QString> ScriptHandler::parseEnvironment(const QByteArray &data)
+{
+    QHash<QString, QString> env;
+    for (const QByteArray &entry : data.split('\0')) {
+        const int separator = entry.indexOf('=');
+        if (separator > 0) {
+            env.insert(QString::fromUtf8(entry.left(separator)), QString::fromUtf8(entry.mid(separator + 1)));
+        }
+    }
+    return env;
+}
+
+bool ScriptHandler::handle(const QHash<QString, QString> &env, QString &error)
+{
+    const QString reason = env.value("reason");
+
+    if (reason == "connect" || reason == "reconnect") {
+        return configure(env, error);
+    }
+    if (reason == "disconnect") {
+        teardown(keyOf(env));
+        return true;
+    }
+
+    // pre-init and attempt-reconnect have nothing to set up
+    return true;
+}
+
+bool ScriptHandler::configure(const QHash<QString, QString> &env, QString &error)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    const QString device = env.value("TUNDEV");
+    const int ifindex = int(if_nametoindex(device.toLocal8Bit().constData()));
+    if (ifindex == 0) {
+        error = "No such device: " + device;
+        return false;
+    }
+
+    NetlinkBatch batch;
+    if (!batch.isValid()) {
+        error = "Cannot open the rtnetlink socket";
+        return false;
+    }
+
+    // The configuration applied last time is only still in place when the device survived
+    const QString key = keyOf(env);
+    Tunnel previous = tunnels.take(key);
+    const bool sameDevice = previous.device == device && previous.ifindex == ifindex;
+    if (!sameDevice) {
+        previous.addresses.clear();
+        previous.routes.clear();
+        previous.dnsKey.clear();
+    }
+    // The last configuration failed part way, any entry of it may be missing
+    const bool reapply = sameDevice && previous.hash.isEmpty();
+
+    Tunnel tunnel;
+    tunnel.device = device;
+    tunnel.ifindex = ifindex;
+    tunnel.mtu = env.value("INTERNAL_IP4_MTU").toInt();
+
+    // The next hop outside of the tunnel, looked up before anything new goes through it
+    auto underlayRoute = [&](Route route) {
+        if (batch.lookupRoute(route.destination, route.gateway, route.ifindex) && route.ifindex != ifindex) {
+            tunnel.underlay.insert(route);
+            return;
+        }
+        // On a reconnect the lookup goes through the tunnel, the route installed before still holds
+        for (const Route &installed : std::as_const(previous.underlay)) {
+            if (installed.destination == route.destination && installed.prefixLength == route.prefixLength) {
+                tunnel.underlay.insert(installed);
+                return;
+            }
+        }
+    };
+
+    const QHostAddress address4(env.value("INTERNAL_IP4_ADDRESS"));
+    if (!address4.isNull()) {
+        tunnel.addresses.insert(Route { address4, 32, QHostAddress(), ifindex });
+    }
+
+    QHostAddress address6;
+    int prefix6 = 128;
+    if (env.contains("INTERNAL_IP6_NETMASK")) {
+        const auto subnet = QHostAddress::parseSubnet(env.value("INTERNAL_IP6_NETMASK"));
+        address6 = QHostAddress(env.value("INTERNAL_IP6_ADDRESS", subnet.first.toString()));
+        prefix6 = subnet.second < 0 ? 128 : subnet.second;
+    } else if (env.contains("INTERNAL_IP6_ADDRESS")) {
+        address6 = QHostAddress(env.value("INTERNAL_IP6_ADDRESS"));
+    }
+    if (!address6.isNull()) {
+        tunnel.addresses.insert(Route { address6, prefix6, QHostAddress(), ifindex });
+    }
+
+    const QHostAddress gateway(env.value("VPNGATEWAY"));
+    if (!gateway.isNull()) {
+        underlayRoute(Route { gateway, gateway.protocol() == QAbstractSocket::IPv4Protocol ? 32 : 128, QHostAddress(), 0 });
+    }
+
+    const QList<Route> exclusions = splitRoutes(env, "CISCO_SPLIT_EXC") + splitRoutes(env, "CISCO_IPV6_SPLIT_EXC");
+    for (const Route &route : exclusions) {
+        underlayRoute(route);
+    }
+
+    QList<Route> inclusions = splitRoutes(env, "CISCO_SPLIT_INC");
+    const bool fullTunnel4 = inclusions.isEmpty();
+    if (fullTunnel4 && !address4.isNull()) {
+        inclusions << Route { QHostAddress(QHostAddress::AnyIPv4), 0, QHostAddress(), 0 };
+    }
+
+    const QList<Route> inclusions6 = splitRoutes(env, "CISCO_IPV6_SPLIT_INC");
+    if (inclusions6.isEmpty() && !address6.isNull()) {
+        inclusions << Route { QHostAddress(QHostAddress::AnyIPv6), 0, QHostAddress(), 0 };
+    }
+    inclusions += inclusions6;
+
+    tunnel.routes.reserve(inclusions.size() + 2);
+    for (const Route &route : std::as_const(inclusions)) {
+        if (route.prefixLength == 0) {
+            // Two halves, more specific than the default route, which is left alone
+            const bool v4 = route.destination.protocol() == QAbstractSocket::IPv4Protocol;
+            tunnel.routes.insert(Route { QHostAddress(v4 ? "0.0.0.0" : "::"), 1, QHostAddress(), ifindex });
+            tunnel.routes.insert(Route { QHostAddress(v4 ? "128.0.0.0" : "8000::"), 1, QHostAddress(), ifindex });
+        } else {
+            tunnel.routes.insert(Route { route.destination, route.prefixLength, QHostAddress(), ifindex });
+        }
+    }
+
+    tunnel.dnsKey = dnsSettings(env, fullTunnel4);
+    tunnel.hash = hashOf(tunnel);
+
+    // The gateway almost always pushes the same policy again
+    if (sameDevice && tunnel.hash == previous.hash) {
+        tunnels.insert(key, previous);
+        emit message("The configuration of " + device + " is unchanged, nothing to apply");
+        return true;
+    }
+
+    if (!sameDevice || tunnel.mtu != previous.mtu) {
+        batch.setLink(ifindex, tunnel.mtu, true);
+    }
+
+    // The new entries go in before the stale ones go away, so that nothing is left without a route
+    for (const Route &address : std::as_const(tunnel.addresses)) {
+        if (reapply || !previous.addresses.contains(address)) {
+            batch.addAddress(ifindex, address.destination, address.prefixLength);
+        }
+    }
+    for (const Route &route : std::as_const(tunnel.underlay)) {
+        if (reapply || !previous.underlay.contains(route)) {
+            batch.addRoute(route.ifindex, route.destination, route.prefixLength, route.gateway);
+        }
+    }
+    for (const Route &route : std::as_const(tunnel.routes)) {
+        if (reapply || !previous.routes.contains(route)) {
+            batch.addRoute(ifindex, route.destination, route.prefixLength);
+        }
+    }
+    for (const Route &route : std::as_const(previous.routes)) {
+        if (!tunnel.routes.contains(route)) {
+            batch.deleteRoute(ifindex, route.destination, route.prefixLength);
+        }
+    }
+    for (const Route &route : std::as_const(previous.underlay)) {
+        if (!tunnel.underlay.contains(route)) {
+            batch.deleteRoute(route.ifindex, route.destination, route.prefixLength, route.gateway);
+        }
+    }
+    for (const Route &address : std::as_const(previous.addresses)) {
+        if (!tunnel.addresses.contains(address)) {
+            batch.deleteAddress(ifindex, address.destination, address.prefixLength);
+        }
+    }
+
+    const int requests = batch.size();
+    QStringList errors;
+    const int failures = batch.commit(&errors);
+    for (const QString &line : std::as_const(errors)) {
+        emit message(line);
+    }
+
+    emit message(QString("Configured %1 with %2 rtnetlink requests (%3 routes, %4) in %5 ms, %6 failed")
+        .arg(device).arg(requests).arg(tunnel.routes.size())
+        .arg(sameDevice && !reapply ? "incremental" : "full").arg(timer.elapsed()).arg(failures));
+
+    if (tunnel.dnsKey != previous.dnsKey) {
+        configureDns(ifindex, env, fullTunnel4);
+    }
+
+    if (failures > 0) {
+        // Not known which entries made it: the stale ones are kept to be deleted later, and the
+        // empty hash has the next configuration add every entry again
+        tunnel.hash.clear();
+        tunnel.addresses.unite(previous.addresses);
+        tunnel.routes.unite(previous.routes);
+        tunnel.underlay.unite(previous.underlay);
+        tunnel.dnsKey.clear();
+        tunnels.insert(key, tunnel);
+        saveState();
+        error = QString("%1 of %2 rtnetlink requests failed").arg(failures).arg(requests);
+        return false;
+    }
+
+    tunnels.insert(key, tunnel);
+    saveState();
+    return true;
+}
+
+QString ScriptHandler::dnsSettings(const QHash<QString, QString> &env, bool fullTunnel)
+{
+    return QStringList {
+        env.value("INTERNAL_IP4_DNS"),
+        env.value("INTERNAL_IP6_DNS"),
+        env.value("CISCO_DEF_DOMAIN"),
+        env.value("CISCO_SPLIT_DNS"),
+        fullTunnel ? "full" : "split",
+    }.join('\n');
+}
+
+/* Independent of the order the gateway sent the entries in */
+QByteArray ScriptHandler::hashOf(const Tunnel &tunnel)
+{
+    auto lines = [](const QSet<Route> &routes) {
+        QStringList result;
+        result.reserve(routes.size());
+        for (const Route &route : routes) {
+            result << QString("%1/%2 %3 %4").arg(route.destination.toString()).arg(route.prefixLength)
+                                            .arg(route.gateway.toString()).arg(route.ifindex);
+        }
+        result.sort();
+        return result.join('\n');
+    };
+
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(QByteArray::number(tunnel.mtu));
+    hash.addData(lines(tunnel.addresses).toUtf8());
+    hash.addData(lines(tunnel.underlay).toUtf8());
+    hash.addData(lines(tunnel.routes).toUtf8());
+    hash.addData(tunnel.dnsKey.toUtf8());
+    return hash.result();
+}
+
+/*
+ * Per gateway, so that the tunnel openconnect brings up again on a new device, e.g.
+ * after being killed without a disconnect, finds the underlay routes the old one left.
+ * A second tunnel to the gateway while the first one is up gets a key of its own.
+ */
+QString ScriptHandler::keyOf(const QHash<QString, QString> &env) const
+{
+    const QString gateway = env.value("VPNGATEWAY");
+    const QString device = env.value("TUNDEV");
+    if (gateway.isEmpty()) {
+        return device;
+    }
+
+    const QString perDevice = gateway + " " + device;
+    if (tunnels.contains(perDevice)) {
+        return perDevice;
+    }
+
+    auto it = tunnels.constFind(gateway);
+    if (it != tunnels.constEnd() && it->device != device
+        && int(if_nametoindex(it->device.toLocal8Bit().constData())) == it->ifindex) {
+        return perDevice;
+    }
+    return gateway;
+}
+
+void ScriptHandler::teardown(const QString &key)
+{
+    const Tunnel tunnel = tunnels.take(key);
+    saveState();
+    if (tunnel.underlay.isEmpty()) {
+        return;
+    }
+
+    // The routes through the device are gone with it, only the underlay is cleaned up
+    NetlinkBatch batch;
+    for (const Route &route : tunnel.underlay) {
+        batch.deleteRoute(route.ifindex, route.destination, route.prefixLength, route.gateway);
+    }
+
+    QStringList errors;
+    batch.commit(&errors);
+    for (const QString &line : std::as_const(errors)) {
+        emit message(line);
+    }
+}
+
+/*
+ * Only the underlay is saved: the rest goes away with the tun device, which does not survive
+ * gpservice. The loaded entries have no hash, they are applied in full if the device did.
+ */
+void ScriptHandler::saveState()
+{
+    if (statePath.isEmpty()) {
+        return;
+    }
+
+    QJsonObject state;
+    for (auto it = tunnels.constBegin(); it != tunnels.constEnd(); ++it) {
+        QJsonArray underlay;
+        for (const Route &route : it->underlay) {
+            underlay.append(QJsonArray { route.destination.toString(), route.prefixLength, route.gateway.toString(), route.ifindex });
+        }
+        state.insert(it.key(), QJsonObject { { "device", it->device }, { "ifindex", it->ifindex }, { "underlay", underlay } });
+    }
+
+    QSaveFile file(statePath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(QJsonDocument(state).toJson(QJsonDocument::Compact)) < 0 || !file.commit()) {
+        emit message("Failed to save the vpnc-script state to " + statePath + ": " + file.errorString());
+    }
+}
+
+void ScriptHandler::loadState()
+{
+    QFile file(statePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    const QJsonObject state = QJsonDocument::fromJson(file.readAll()).object();
+    for (auto it = state.constBegin(); it != state.constEnd(); ++it) {
+        const QJsonObject entry = it.value().toObject();
+        Tunnel tunnel;
+        tunnel.device = entry.value("device").toString();
+        tunnel.ifindex = entry.value("ifindex").toInt();
+        for (const QJsonValue &value : entry.value("underlay").toArray()) {
+            const QJsonArray route = value.toArray();
+            tunnel.underlay.insert(Route { QHostAddress(route.at(0).toString()), route.at(1).toInt(),
+                                           QHostAddress(route.at(2).toString()), route.at(3).toInt() });
+        }
+        tunnels.insert(it.key(), tunnel);
+    }
+
+    if (!tunnels.isEmpty()) {
+        emit message(QString("Loaded the vpnc-script state of %1 tunnel(s) from %2").arg(tunnels.size()).arg(statePath));
+    }
+}
+
+void ScriptHandler::configureDns(int ifindex, const QHash<QString, QString> &env, bool fullTunnel)
+{
+    QList<ResolvedDnsServer> servers;
+    const QStringList addresses = env.value("INTERNAL_IP4_DNS").split(' ', Qt::SkipEmptyParts)
+                                + env.value("INTERNAL_IP6_DNS").split(' ', Qt::SkipEmptyParts);
+    for (const QString &value : addresses) {
+        const QHostAddress address(value);
+        if (address.protocol() == QAbstractSocket::IPv4Protocol) {
+            const quint32 bytes = htonl(address.toIPv4Address());
+            servers << ResolvedDnsServer { AF_INET, QByteArray(reinterpret_cast<const char *>(&bytes), sizeof(bytes)) };
+        } else if (address.protocol() == QAbstractSocket::IPv6Protocol) {
+            const Q_IPV6ADDR bytes = address.toIPv6Address();
+            servers << ResolvedDnsServer { AF_INET6, QByteArray(reinterpret_cast<const char *>(bytes.c), sizeof(bytes.c)) };
+        }
+    }
+    if (servers.isEmpty()) {
+        return;
+    }
+
+    QList<ResolvedDomain> domains;
+    const QStringList search = env.value("CISCO_DEF_DOMAIN").split(QRegularExpression("[ ,;]"), Qt::SkipEmptyParts);
+    for (const QString &domain : search) {
+        domains << ResolvedDomain { domain, false };
+    }
+    const QStringList split = env.value("CISCO_SPLIT_DNS").split(',', Qt::SkipEmptyParts);
+    for (const QString &domain : split) {
+        domains << ResolvedDomain { domain.trimmed(), true };
+    }
+    if (fullTunnel) {
+        // Every query goes to the servers of the tunnel
+        domains << ResolvedDomain { ".", true };
+    }
+
+    auto call = [this, ifindex](const QString &method, const QVariant &argument) {
+        QDBusMessage request = QDBusMessage::createMethodCall("org.freedesktop.resolve1", "/org/freedesktop/resolve1",
+                                                              "org.freedesktop.resolve1.Manager", method);
+        request << ifindex << argument;
+
+        auto *watcher = new QDBusPendingCallWatcher(QDBusConnection::systemBus().asyncCall(request), this);
+        QObject::connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, method](QDBusPendingCallWatcher *call) {
+            QDBusPendingReply<> reply = *call;
+            call->deleteLater();
+            if (reply.isError()) {
+                emit message("systemd-resolved " + method + " failed, the DNS of the tunnel is not configured: " + reply.error().message());
+            }
+        });
+    };
+
+    // Queued back to back on the bus, nothing waits for the answers
+    call("SetLinkDNS", QVariant::fromValue(servers));
+    call("SetLinkDomains", QVariant::fromValue(domains));
+}
+
+int ScriptHandler::prefixLength(const QHash<QString, QString> &env, const QString &key)
+{
+    if (env.contains(key + "_MASKLEN")) {
+        return env.value(key + "_MASKLEN").toInt();
+    }
+
+    const QHostAddress mask(env.value(key + "_MASK"));
+    if (mask.protocol() != QAbstractSocket::IPv4Protocol) {
+        return -1;
+    }
+    return __builtin_popcount(mask.toIPv4Address());
+}
+
+QList<ScriptHandler::Route> ScriptHandler::splitRoutes(const QHash<QString, QString> &env, const QString &prefix)
+{
+    QList<Route> routes;
+    const int count = env.value(prefix).toInt();
+    routes.reserve(count);
+
+    for (int i = 0; i < count; i++) {
+        const QString key = QString("%1_%2").arg(prefix).arg(i);
+        const int length = prefixLength(env, key);
+        if (length < 0) {
+            continue;
+        }
+
+        // The kernel rejects a destination with host bits set
+        const auto subnet = QHostAddress::parseSubnet(env.value(key + "_ADDR") + "/" + QString::number(length));
+        if (subnet.first.isNull()) {
+            continue;
+        }
+        routes << Route { subnet.first, subnet.second, QHostAddress(), 0 };
+    }
+    return routes;
+}
+
+static bool writeAll(int fd, const char *data, size_t length)
+{
+    while (length > 0) {
+        const ssize_t written = ::write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        length -= size_t(written);
+    }
+    return true;
+}
+
+/* Runs in the helper process started by openconnect, without Qt */
+int ScriptHandler::forward(const char *socketPath)
+{
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("gpservice: socket");
+        return 1;
+    }
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketPath, sizeof(address.sun_path) - 1);
+
+    if (::connect(fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0) {
+        fprintf(stderr, "gpservice: cannot reach the vpnc-script handler at %s: %s\n", socketPath, strerror(errno));
+        ::close(fd);
+        return 1;
+    }
+
+    std::string request;
+    for (char **variable = environ; *variable; variable++) {
+        for (const char *prefix : forwardedPrefixes) {
+            if (strncmp(*variable, prefix, strlen(prefix)) == 0) {
+                request.append(*variable);
+                request.push_back('\0');
+                break;
+            }
+        }
+    }
+    request.push_back('\0');
+
+    if (!writeAll(fd, request.data(), request.size())) {
+        perror("gpservice: write");
+        ::close(fd);
+        return 1;
+    }
+
+    std::string reply;
+    char buffer[512];
+    ssize_t length;
+    while ((length = ::read(fd, buffer, sizeof(buffer))) > 0 || (length < 0 && errno == EINTR)) {
+        if (length > 0) {
+            reply.append(buffer, size_t(length));
+        }
+    }
+    ::close(fd);
+
+    if (reply.compare(0, 2, "ok") == 0) {
+        return 0;
+    }
+
+    fprintf(stderr, "gpservice: vpnc-script %s", reply.empty() ? "handler closed the connection\n" : reply.c_str());
+    return 1;
+}
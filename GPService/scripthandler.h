@@ -0,0 +1,116 @@
+#ifndef SCRIPTHANDLER_H
+#define SCRIPTHANDLER_H
+
+#include <QtCore/QObject>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QSet>
+#include <QtNetwork/QHostAddress>
+#include <QtNetwork/QLocalServer>
+
+static const QString defaultScriptSocket = "/run/gpservice/script.sock";
+
+/*
+ * Built-in replacement of vpnc-script, selected with vpnc-script=builtin in
+ * gp.conf.
+ *
+ * openconnect runs "gpservice --script-helper <socket>" as its script; the
+ * helper forwards the environment set by openconnect (reason, TUNDEV,
+ * INTERNAL_IP4_*, CISCO_SPLIT_INC_*, ...) over a unix socket and exits with
+ * the result. The handler programs the device, addresses and routes in
+ * batched rtnetlink transactions (see NetlinkBatch) and hands the DNS
+ * servers and domains of the link to systemd-resolved over D-Bus, instead
+ * of forking ip(8) once per route.
+ *
+ * The routes through the tun device go away with the device; the routes
+ * added to the underlay (the gateway host route and the split exclusions)
+ * are remembered per gateway, across restarts of gpservice, and removed on
+ * disconnect.
+ *
+ * The configuration applied for a gateway is kept with a hash of it. When
+ * openconnect reconnects on the same device, an identical policy is not
+ * applied again, and a changed one only adds and removes the entries that
+ * differ: the routes that did not change are never taken down. After a
+ * configuration that failed part way, every entry it may have installed is
+ * still remembered, and the next one is applied in full.
+ */
+class ScriptHandler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ScriptHandler(QObject *parent = nullptr);
+
+    void listen(const QString &path = defaultScriptSocket);
+    bool isListening() const;
+    // The --script argument of openconnect running the helper
+    QString command() const;
+
+    // The helper side, run by main() before anything else: forwards the environment and returns the exit code
+    static int forward(const char *socketPath);
+
+signals:
+    void message(QString msg);
+
+private slots:
+    void onNewConnection();
+
+private:
+    static const int MAX_REQUEST_SIZE { 4 * 1024 * 1024 };
+    static const int REQUEST_TIMEOUT_MS { 30000 };
+
+    struct Route {
+        QHostAddress destination;
+        int prefixLength;
+        QHostAddress gateway;
+        int ifindex;
+
+        bool operator==(const Route &other) const
+        {
+            return destination == other.destination && prefixLength == other.prefixLength
+                && gateway == other.gateway && ifindex == other.ifindex;
+        }
+
+        friend size_t qHash(const Route &route, size_t seed = 0)
+        {
+            return qHashMulti(seed, route.destination, route.prefixLength, route.gateway, route.ifindex);
+        }
+    };
+
+    struct Tunnel {
+        QString device;
+        int ifindex { 0 };
+        int mtu { 0 };
+        // The addresses of the device, as destination and prefix length
+        QSet<Route> addresses;
+        // Routes through the device
+        QSet<Route> routes;
+        // Routes added outside of the tun device
+        QSet<Route> underlay;
+        QString dnsKey;
+        // Of all the above, see hashOf()
+        QByteArray hash;
+    };
+
+    QLocalServer *server;
+    QString path;
+    // Next to the socket, the underlay routes left by the tunnels survive a restart of gpservice
+    QString statePath;
+    // By gateway, see keyOf()
+    QHash<QString, Tunnel> tunnels;
+
+    bool handle(const QHash<QString, QString> &env, QString &error);
+    bool configure(const QHash<QString, QString> &env, QString &error);
+    QString keyOf(const QHash<QString, QString> &env) const;
+    void teardown(const QString &key);
+    void saveState();
+    void loadState();
+    void configureDns(int ifindex, const QHash<QString, QString> &env, bool fullTunnel);
+
+    static QString dnsSettings(const QHash<QString, QString> &env, bool fullTunnel);
+    static QByteArray hashOf(const Tunnel &tunnel);
+    static QHash<QString, QString> parseEnvironment(const QByteArray &data);
+    static QList<Route> splitRoutes(const QHash<QString, QString> &env, const QString &prefix);
+    static int prefixLength(const QHash<QString, QString> &env, const QString &key);
+};
+
+#endif // SCRIPTHANDLER_H
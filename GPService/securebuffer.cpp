@@ -0,0 +1,74 @@
+#include <QtCore/QByteArray>
+#include <utility>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "securebuffer.h"
+
+SecureBuffer::~SecureBuffer()
+{
+    release();
+}
+
+void SecureBuffer::assign(const QString &secret)
+{
+    QByteArray bytes = secret.toUtf8();
+
+    if (size_t(bytes.size()) >= capacity) {
+        release();
+
+        const size_t pageSize = size_t(sysconf(_SC_PAGESIZE));
+        const size_t size = (size_t(bytes.size()) / pageSize + 1) * pageSize;
+
+        void *pages = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (pages == MAP_FAILED) {
+            explicit_bzero(bytes.data(), bytes.size());
+            return;
+        }
+
+        // Best effort, both fail without CAP_IPC_LOCK or on old kernels
+        mlock(pages, size);
+        madvise(pages, size, MADV_DONTDUMP);
+
+        data = static_cast<char *>(pages);
+        capacity = size;
+    }
+
+    memcpy(data, bytes.constData(), bytes.size());
+    // The buffer is always larger than the secret, so it stays NUL terminated for the C APIs
+    explicit_bzero(data + bytes.size(), capacity - size_t(bytes.size()));
+    length = bytes.size();
+
+    explicit_bzero(bytes.data(), bytes.size());
+}
+
+void SecureBuffer::clear()
+{
+    if (data) {
+        explicit_bzero(data, capacity);
+    }
+    length = 0;
+}
+
+void SecureBuffer::swap(SecureBuffer &other) noexcept
+{
+    std::swap(data, other.data);
+    std::swap(capacity, other.capacity);
+    std::swap(length, other.length);
+}
+
+void SecureBuffer::release()
+{
+    if (!data) {
+        return;
+    }
+
+    explicit_bzero(data, capacity);
+    munlock(data, capacity);
+    munmap(data, capacity);
+
+    data = nullptr;
+    capacity = 0;
+    length = 0;
+}
@@ -0,0 +1,37 @@
+#ifndef SECUREBUFFER_H
+#define SECUREBUFFER_H
+
+#include <QtCore/QString>
+
+/*
+ * Holds a secret (the gateway cookie) in locked, non-dumpable memory.
+ *
+ * The pages are mlock()ed so they are never swapped out, excluded from core
+ * dumps, and wiped with explicit_bzero() before they are released.
+ */
+class SecureBuffer
+{
+public:
+    SecureBuffer() = default;
+    ~SecureBuffer();
+
+    SecureBuffer(const SecureBuffer &) = delete;
+    SecureBuffer &operator=(const SecureBuffer &) = delete;
+
+    void assign(const QString &secret);
+    void clear();
+    void swap(SecureBuffer &other) noexcept;
+
+    bool isEmpty() const { return length == 0; }
+    const char *constData() const { return data; }
+    qsizetype size() const { return qsizetype(length); }
+
+private:
+    char *data { nullptr };
+    size_t capacity { 0 };
+    size_t length { 0 };
+
+    void release();
+};
+
+#endif // SECUREBUFFER_H
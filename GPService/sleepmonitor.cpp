@@ -0,0 +1,77 @@
+#include <QtDBus/QDBusConnection>
+#include <QtDBus/QDBusMessage>
+#include <QtDBus/QDBusPendingCallWatcher>
+#include <QtDBus/QDBusPendingReply>
+
+#include "sleepmonitor.h"
+
+static const QString logindService = "org.freedesktop.login1";
+static const QString logindPath = "/org/freedesktop/login1";
+static const QString logindInterface = "org.freedesktop.login1.Manager";
+
+SleepMonitor::SleepMonitor(QObject *parent)
+    : QObject(parent)
+    , releaseTimer(new QTimer(this))
+{
+    releaseTimer->setSingleShot(true);
+    releaseTimer->setInterval(MAX_DELAY_MS);
+    QObject::connect(releaseTimer, &QTimer::timeout, this, [this]() {
+        emit message("The tunnels are not paused yet, letting the suspend go on");
+        release();
+    });
+}
+
+void SleepMonitor::start()
+{
+    const bool subscribed = QDBusConnection::systemBus().connect(logindService, logindPath, logindInterface, "PrepareForSleep",
+                                                                 this, SLOT(onPrepareForSleep(bool)));
+    if (!subscribed) {
+        emit message("Cannot watch the suspend and resume, systemd-logind is not available");
+        return;
+    }
+    inhibit();
+}
+
+void SleepMonitor::release()
+{
+    releaseTimer->stop();
+    if (inhibitor.isValid()) {
+        // Closing the descriptor releases the lock
+        inhibitor = QDBusUnixFileDescriptor();
+    }
+}
+
+void SleepMonitor::onPrepareForSleep(bool start)
+{
+    if (start) {
+        emit message("The system is about to suspend");
+        releaseTimer->start();
+        emit aboutToSleep();
+        return;
+    }
+
+    emit message("The system resumed");
+    inhibit();
+    emit resumed();
+}
+
+void SleepMonitor::inhibit()
+{
+    if (inhibitor.isValid()) {
+        return;
+    }
+
+    QDBusMessage request = QDBusMessage::createMethodCall(logindService, logindPath, logindInterface, "Inhibit");
+    request << QString("sleep") << QString("gpservice") << QString("Pausing the VPN tunnels") << QString("delay");
+
+    auto *watcher = new QDBusPendingCallWatcher(QDBusConnection::systemBus().asyncCall(request), this);
+    QObject::connect(watcher, &QDBusPendingCallWatcher::finished, this, [this](QDBusPendingCallWatcher *call) {
+        QDBusPendingReply<QDBusUnixFileDescriptor> reply = *call;
+        call->deleteLater();
+        if (reply.isError()) {
+            emit message("Cannot delay the suspend, the tunnels will not be paused first: " + reply.error().message());
+            return;
+        }
+        inhibitor = reply.value();
+    });
+}
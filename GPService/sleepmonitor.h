@@ -0,0 +1,44 @@
+#ifndef SLEEPMONITOR_H
+#define SLEEPMONITOR_H
+
+#include <QtCore/QObject>
+#include <QtCore/QTimer>
+#include <QtDBus/QDBusUnixFileDescriptor>
+
+/*
+ * Suspend and resume, as announced by systemd-logind (PrepareForSleep).
+ *
+ * A delay inhibitor lock is held while the system is awake, so that logind
+ * waits for the tunnels to be paused before it suspends: aboutToSleep() is
+ * emitted, and the lock is dropped by release() once they are, or after
+ * MAX_DELAY_MS at the latest. It is taken again on resume.
+ */
+class SleepMonitor : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SleepMonitor(QObject *parent = nullptr);
+
+    void start();
+    // Lets the suspend go on
+    void release();
+
+signals:
+    void aboutToSleep();
+    void resumed();
+    void message(QString msg);
+
+private slots:
+    void onPrepareForSleep(bool start);
+
+private:
+    // logind does not wait longer than InhibitDelayMaxSec (5 s by default) anyway
+    static const int MAX_DELAY_MS { 4000 };
+
+    QDBusUnixFileDescriptor inhibitor;
+    QTimer *releaseTimer;
+
+    void inhibit();
+};
+
+#endif // SLEEPMONITOR_H
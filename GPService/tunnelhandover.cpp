@@ -0,0 +1,122 @@
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QVariant>
+
+#include "tunnelhandover.h"
+
+const QString TunnelHandover::ipBinary = "ip";
+
+TunnelHandover::TunnelHandover(const QString &fromInterface, const QString &toInterface, QObject *parent)
+    : QObject(parent)
+    , fromInterface(fromInterface)
+    , toInterface(toInterface)
+    , process(new QProcess(this))
+{
+    QObject::connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this, &TunnelHandover::onProcessFinished);
+    QObject::connect(process, &QProcess::errorOccurred, this, &TunnelHandover::onProcessError);
+}
+
+void TunnelHandover::start()
+{
+    if (stage != Idle) {
+        return;
+    }
+
+    if (fromInterface.isEmpty() || toInterface.isEmpty()) {
+        emit message("The tunnel interfaces are unknown, leaving the routes to vpnc-script");
+        emit finished(false);
+        return;
+    }
+
+    commands.clear();
+    run(ListIPv4, { "-j", "-4", "route", "show", "dev", fromInterface });
+}
+
+void TunnelHandover::run(Stage next, const QStringList &args)
+{
+    stage = next;
+    process->start(ipBinary, args);
+
+    if (stage == Apply) {
+        process->write(commands.join('\n').toUtf8() + '\n');
+        process->closeWriteChannel();
+    }
+}
+
+void TunnelHandover::onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    const QByteArray output = process->readAllStandardOutput();
+
+    if (exitStatus != QProcess::NormalExit || exitCode != 0) {
+        const Stage failed = stage;
+        stage = Idle;
+        emit message(QString("ip exited with code %1: %2").arg(exitCode).arg(QString::fromUtf8(process->readAllStandardError()).trimmed()));
+        // With -force the batch goes on after a failing line, the other routes are moved anyway
+        emit finished(failed == Apply);
+        return;
+    }
+
+    switch (stage) {
+    case ListIPv4:
+        parseRoutes(output);
+        run(ListIPv6, { "-j", "-6", "route", "show", "dev", fromInterface });
+        break;
+    case ListIPv6:
+        parseRoutes(output);
+        if (commands.isEmpty()) {
+            stage = Idle;
+            emit finished(true);
+            break;
+        }
+        emit message(QString("Moving %1 routes from %2 to %3").arg(commands.size()).arg(fromInterface, toInterface));
+        run(Apply, { "-force", "-batch", "-" });
+        break;
+    case Apply:
+        stage = Idle;
+        emit finished(true);
+        break;
+    case Idle:
+        break;
+    }
+}
+
+void TunnelHandover::onProcessError(QProcess::ProcessError error)
+{
+    if (error != QProcess::FailedToStart) {
+        return;
+    }
+
+    stage = Idle;
+    emit message("Could not run " + ipBinary + ": " + QVariant::fromValue(error).toString());
+    emit finished(false);
+}
+
+void TunnelHandover::parseRoutes(const QByteArray &json)
+{
+    const QJsonArray routes = QJsonDocument::fromJson(json).array();
+
+    for (const QJsonValue &value : routes) {
+        const QJsonObject route = value.toObject();
+
+        // The prefix route of the tunnel address belongs to the device itself
+        if (route.value("protocol").toString() == "kernel") {
+            continue;
+        }
+        if (route.contains("type") && route.value("type").toString() != "unicast") {
+            continue;
+        }
+
+        // Restored by the vpnc-script of the old tunnel, see the class comment
+        const QString dst = route.value("dst").toString();
+        if (dst.isEmpty() || dst == "default") {
+            continue;
+        }
+
+        QString command = QString("route replace %1 dev %2").arg(dst, toInterface);
+        if (route.contains("metric")) {
+            command += " metric " + QString::number(route.value("metric").toInt());
+        }
+        commands << command;
+    }
+}
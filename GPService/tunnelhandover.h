@@ -0,0 +1,58 @@
+#ifndef TUNNELHANDOVER_H
+#define TUNNELHANDOVER_H
+
+#include <QtCore/QObject>
+#include <QtCore/QProcess>
+#include <QtCore/QStringList>
+
+/*
+ * Moves the routes of one tun device onto another, for a gateway switch.
+ *
+ * Every route installed on the old device is replaced with the same route on
+ * the new device in a single `ip -batch` run. `ip route replace` swaps each
+ * route in place, so there is no window where the destination is unrouted.
+ *
+ * The default route is left out: the new tunnel is configured by the
+ * built-in handler, whose two /1 halves already take the traffic, and the
+ * vpnc-script of the old tunnel puts back the default route it saved.
+ * The new gateway was pinned to the underlay before its tunnel was started,
+ * see GatewayPin.
+ */
+class TunnelHandover : public QObject
+{
+    Q_OBJECT
+public:
+    TunnelHandover(const QString &fromInterface, const QString &toInterface, QObject *parent = nullptr);
+
+    void start();
+
+signals:
+    void finished(bool ok);
+    void message(QString msg);
+
+private slots:
+    void onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void onProcessError(QProcess::ProcessError error);
+
+private:
+    enum Stage {
+        Idle,
+        ListIPv4,
+        ListIPv6,
+        Apply,
+    };
+
+    static const QString ipBinary;
+
+    QString fromInterface;
+    QString toInterface;
+
+    QProcess *process;
+    Stage stage { Idle };
+    QStringList commands;
+
+    void run(Stage next, const QStringList &args);
+    void parseRoutes(const QByteArray &json);
+};
+
+#endif // TUNNELHANDOVER_H
@@ -0,0 +1,255 @@
+#include <linux/if_link.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "tunnelmetrics.h"
+
+// The statuses are the VpnSession ones: 0 is disconnected and 2 is connected
+static const int STATUS_NOT_CONNECTED = 0;
+static const int STATUS_CONNECTED = 2;
+
+TunnelMetrics::Counters &TunnelMetrics::Counters::operator+=(const Counters &other)
+{
+    rxBytes += other.rxBytes;
+    txBytes += other.txBytes;
+    rxPackets += other.rxPackets;
+    txPackets += other.txPackets;
+    rxErrors += other.rxErrors;
+    txErrors += other.txErrors;
+    rxDropped += other.rxDropped;
+    txDropped += other.txDropped;
+    return *this;
+}
+
+bool TunnelMetrics::Counters::operator==(const Counters &other) const
+{
+    return rxBytes == other.rxBytes && txBytes == other.txBytes
+        && rxPackets == other.rxPackets && txPackets == other.txPackets
+        && rxErrors == other.rxErrors && txErrors == other.txErrors
+        && rxDropped == other.rxDropped && txDropped == other.txDropped;
+}
+
+TunnelMetrics::TunnelMetrics(int statusCount, QObject *parent)
+    : QObject(parent)
+    , sampleTimer(new QTimer(this))
+    , statusTime(statusCount, 0)
+{
+    clock.start();
+
+    netlinkFd = ::socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+
+    sampleTimer->setInterval(DEFAULT_INTERVAL_MS);
+    QObject::connect(sampleTimer, &QTimer::timeout, this, &TunnelMetrics::sample);
+}
+
+TunnelMetrics::~TunnelMetrics()
+{
+    if (netlinkFd >= 0) {
+        ::close(netlinkFd);
+    }
+}
+
+void TunnelMetrics::reset()
+{
+    carried = Counters();
+    current = Counters();
+    restores = 0;
+    restoreTotal = 0;
+    lastRestore = 0;
+    emit sampled();
+}
+
+void TunnelMetrics::setInterface(const QString &name)
+{
+    if (name == interface) {
+        return;
+    }
+
+    // Last look at the old device, if it is still there
+    if (!interface.isEmpty()) {
+        sample();
+        carried += current;
+        current = Counters();
+    }
+
+    interface = name;
+    if (interface.isEmpty()) {
+        sampleTimer->stop();
+        return;
+    }
+
+    sample();
+    sampleTimer->start();
+}
+
+void TunnelMetrics::setInterval(int msec)
+{
+    sampleTimer->setInterval(msec > 0 ? msec : DEFAULT_INTERVAL_MS);
+}
+
+void TunnelMetrics::setBackendCounts(bool enabled)
+{
+    backendCounts = enabled;
+}
+
+void TunnelMetrics::update(quint64 rxBytes, quint64 txBytes, quint64 rxPackets, quint64 txPackets)
+{
+    Counters counters = current;
+    counters.rxBytes = rxBytes;
+    counters.txBytes = txBytes;
+    counters.rxPackets = rxPackets;
+    counters.txPackets = txPackets;
+
+    if (!(counters == current)) {
+        current = counters;
+        emit sampled();
+    }
+}
+
+void TunnelMetrics::recordRestore(qint64 msec)
+{
+    restores++;
+    restoreTotal += msec;
+    lastRestore = msec;
+}
+
+void TunnelMetrics::setStatus(int newStatus)
+{
+    if (newStatus == status || newStatus < 0 || newStatus >= statusTime.size()) {
+        return;
+    }
+
+    const qint64 now = clock.elapsed();
+    statusTime[status] += now - statusSince;
+    statusSince = now;
+    status = newStatus;
+
+    // The uptime covers the automatic reconnects, it ends when the session is down
+    if (status == STATUS_CONNECTED && upSince < 0) {
+        upSince = now;
+    } else if (status == STATUS_NOT_CONNECTED) {
+        upSince = -1;
+    }
+}
+
+TunnelMetrics::Counters TunnelMetrics::counters() const
+{
+    Counters total = carried;
+    total += current;
+    return total;
+}
+
+qint64 TunnelMetrics::uptime() const
+{
+    return upSince < 0 ? 0 : clock.elapsed() - upSince;
+}
+
+qint64 TunnelMetrics::timeInStatus(int which) const
+{
+    if (which < 0 || which >= statusTime.size()) {
+        return 0;
+    }
+
+    qint64 time = statusTime.at(which);
+    if (which == status) {
+        time += clock.elapsed() - statusSince;
+    }
+    return time;
+}
+
+void TunnelMetrics::sample()
+{
+    if (backendCounts) {
+        emit sampleRequested();
+    }
+
+    Counters counters;
+    if (interface.isEmpty() || !readCounters(interface, counters)) {
+        return;
+    }
+
+    // The errors and drops are only known to the device
+    if (backendCounts) {
+        counters.rxBytes = current.rxBytes;
+        counters.txBytes = current.txBytes;
+        counters.rxPackets = current.rxPackets;
+        counters.txPackets = current.txPackets;
+    }
+
+    if (!(counters == current)) {
+        current = counters;
+        emit sampled();
+    }
+}
+
+/* A single RTM_GETLINK request, answered by the kernel before send() returns */
+bool TunnelMetrics::readCounters(const QString &name, Counters &counters)
+{
+    if (netlinkFd < 0) {
+        return false;
+    }
+
+    const unsigned int index = if_nametoindex(name.toLocal8Bit().constData());
+    if (index == 0) {
+        return false;
+    }
+
+    struct {
+        struct nlmsghdr header;
+        struct ifinfomsg info;
+    } request;
+    memset(&request, 0, sizeof(request));
+    request.header.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+    request.header.nlmsg_type = RTM_GETLINK;
+    request.header.nlmsg_flags = NLM_F_REQUEST;
+    request.header.nlmsg_seq = index;
+    request.info.ifi_family = AF_UNSPEC;
+    request.info.ifi_index = int(index);
+
+    if (::send(netlinkFd, &request, request.header.nlmsg_len, 0) < 0) {
+        return false;
+    }
+
+    alignas(struct nlmsghdr) char buffer[16384];
+    const ssize_t length = ::recv(netlinkFd, buffer, sizeof(buffer), MSG_DONTWAIT);
+    if (length <= 0) {
+        return false;
+    }
+
+    int remaining = int(length);
+    for (struct nlmsghdr *header = reinterpret_cast<struct nlmsghdr *>(buffer);
+         NLMSG_OK(header, remaining);
+         header = NLMSG_NEXT(header, remaining)) {
+        if (header->nlmsg_type != RTM_NEWLINK || header->nlmsg_seq != index) {
+            continue;
+        }
+
+        struct ifinfomsg *info = static_cast<struct ifinfomsg *>(NLMSG_DATA(header));
+        int attributesLength = int(IFLA_PAYLOAD(header));
+        for (struct rtattr *attribute = IFLA_RTA(info);
+             RTA_OK(attribute, attributesLength);
+             attribute = RTA_NEXT(attribute, attributesLength)) {
+            if (attribute->rta_type != IFLA_STATS64 || RTA_PAYLOAD(attribute) < sizeof(struct rtnl_link_stats64)) {
+                continue;
+            }
+
+            struct rtnl_link_stats64 stats;
+            memcpy(&stats, RTA_DATA(attribute), sizeof(stats));
+            counters.rxBytes = stats.rx_bytes;
+            counters.txBytes = stats.tx_bytes;
+            counters.rxPackets = stats.rx_packets;
+            counters.txPackets = stats.tx_packets;
+            counters.rxErrors = stats.rx_errors;
+            counters.txErrors = stats.tx_errors;
+            counters.rxDropped = stats.rx_dropped;
+            counters.txDropped = stats.tx_dropped;
+            return true;
+        }
+    }
+
+    return false;
+}
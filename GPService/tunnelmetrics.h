@@ -0,0 +1,93 @@
+#ifndef TUNNELMETRICS_H
+#define TUNNELMETRICS_H
+
+#include <QtCore/QObject>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QList>
+#include <QtCore/QTimer>
+
+/*
+ * Traffic and health counters of one session.
+ *
+ * The tun device counters are sampled over rtnetlink (RTM_GETLINK,
+ * IFLA_STATS64) at a fixed interval. A reconnect brings up a new device with
+ * fresh counters, so the totals of the previous devices are carried over and
+ * the counters only restart with a new connect(). The time spent in each
+ * status and the uptime of the connection are tracked on the monotonic clock,
+ * as is the time the tunnel took to be restored after a network change or a
+ * resume.
+ */
+class TunnelMetrics : public QObject
+{
+    Q_OBJECT
+public:
+    struct Counters {
+        quint64 rxBytes { 0 };
+        quint64 txBytes { 0 };
+        quint64 rxPackets { 0 };
+        quint64 txPackets { 0 };
+        quint64 rxErrors { 0 };
+        quint64 txErrors { 0 };
+        quint64 rxDropped { 0 };
+        quint64 txDropped { 0 };
+
+        Counters &operator+=(const Counters &other);
+        bool operator==(const Counters &other) const;
+    };
+
+    TunnelMetrics(int statusCount, QObject *parent = nullptr);
+    ~TunnelMetrics();
+
+    // Starts a new set of counters, e.g. on connect()
+    void reset();
+    void setInterface(const QString &name);
+    void setInterval(int msec);
+    void setStatus(int status);
+    // The backend reports the byte and packet counts itself, see update()
+    void setBackendCounts(bool enabled);
+    void update(quint64 rxBytes, quint64 txBytes, quint64 rxPackets, quint64 txPackets);
+    void recordRestore(qint64 msec);
+
+    Counters counters() const;
+    // Milliseconds since the tunnel first came up, 0 when it is down
+    qint64 uptime() const;
+    qint64 timeInStatus(int status) const;
+    int restoreCount() const { return restores; }
+    // Milliseconds, the sum of every restore and the last one
+    qint64 restoreTime() const { return restoreTotal; }
+    qint64 lastRestoreTime() const { return lastRestore; }
+
+signals:
+    // The counters changed since the previous sample
+    void sampled();
+    // Emitted on every tick, for the backends that report their own counts
+    void sampleRequested();
+
+private slots:
+    void sample();
+
+private:
+    static const int DEFAULT_INTERVAL_MS { 5000 };
+
+    int netlinkFd { -1 };
+    QString interface;
+    QTimer *sampleTimer;
+    bool backendCounts { false };
+
+    // Totals of the previous tun devices of this session
+    Counters carried;
+    Counters current;
+
+    QElapsedTimer clock;
+    qint64 upSince { -1 };
+    int status { 0 };
+    qint64 statusSince { 0 };
+    QList<qint64> statusTime;
+    int restores { 0 };
+    qint64 restoreTotal { 0 };
+    qint64 lastRestore { 0 };
+
+    bool readCounters(const QString &name, Counters &counters);
+};
+
+#endif // TUNNELMETRICS_H
@@ -0,0 +1,1193 @@
+#include <signal.h>
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QRandomGenerator>
+#include <QtCore/QRegularExpression>
+#include <QtCore/QUrl>
+#include <QtCore/QVariant>
+#include <QtDBus/QDBusConnection>
+#include <QtDBus/QDBusMessage>
+#include <QtNetwork/QHostAddress>
+
+#include "vpnsession.h"
+#ifdef HAVE_LIBOPENCONNECT
+#include "libopenconnecttunnel.h"
+#endif
+
+// Where the distributions install vpnc-script, used by the library backend
+static const QString vpncScriptPaths[] {
+    "/usr/share/vpnc-scripts/vpnc-script",
+    "/etc/vpnc/vpnc-script",
+    "/usr/libexec/vpnc-scripts/vpnc-script",
+};
+
+VpnSession::VpnSession(const QString &name, OpenconnectProbe *probe, GPConfig *config, CircuitBreaker *breaker, ScriptHandler *scripts, QObject *parent)
+    : QObject(parent)
+    , sessionName(name)
+    , openconnect(new QProcess(this))
+    , stdoutParser(new OpenconnectParser(this))
+    , stderrParser(new OpenconnectParser(this))
+    , standbyStdoutParser(new OpenconnectParser(this))
+    , standbyStderrParser(new OpenconnectParser(this))
+    , switchTimer(new QTimer(this))
+    , setupTimer(new QTimer(this))
+    , probe(probe)
+    , config(config)
+    , logStream(new LogStream(pathFor(name), "com.pacha.qt.GPService.Session", this))
+    , breaker(breaker)
+    , scripts(scripts)
+    , killTimer(new QTimer(this))
+    , reconnectTimer(new QTimer(this))
+    , tunnelMetrics(new TunnelMetrics(VpnSession::VpnDisconnecting + 1, this))
+    , propertiesTimer(new QTimer(this))
+{
+    attachProcess(openconnect, stdoutParser, stderrParser);
+
+    QObject::connect(probe, &OpenconnectProbe::finished, this, &VpnSession::onProbeFinished);
+
+    killTimer->setSingleShot(true);
+    killTimer->setInterval(TERMINATE_TIMEOUT_MS);
+    QObject::connect(killTimer, &QTimer::timeout, this, [this]() {
+        if (openconnect->state() != QProcess::NotRunning) {
+            log("Openconnect did not exit in time, killing it");
+            openconnect->kill();
+        }
+    });
+
+    reconnectTimer->setSingleShot(true);
+    QObject::connect(reconnectTimer, &QTimer::timeout, this, &VpnSession::onReconnectTimeout);
+
+    QObject::connect(tunnelMetrics, &TunnelMetrics::sampled, this, &VpnSession::onMetricsSampled);
+
+    propertiesTimer->setSingleShot(true);
+    propertiesTimer->setInterval(PROPERTIES_CHANGED_DELAY_MS);
+    QObject::connect(propertiesTimer, &QTimer::timeout, this, &VpnSession::flushPropertiesChanged);
+
+    setupTimer->setSingleShot(true);
+    QObject::connect(setupTimer, &QTimer::timeout, this, [this]() {
+        log(currentServer + " was not configured in time, trying the next gateway");
+        abandonSetup();
+    });
+
+    switchTimer->setSingleShot(true);
+    switchTimer->setInterval(SWITCH_TIMEOUT_MS);
+    QObject::connect(switchTimer, &QTimer::timeout, this, [this]() {
+        abortSwitch("The new tunnel was not configured in time");
+    });
+}
+
+/* Wires the process and the output parsers of the active tunnel to the session */
+void VpnSession::attachProcess(QProcess *process, OpenconnectParser *out, OpenconnectParser *err)
+{
+    QObject::connect(process, &QProcess::started, this, &VpnSession::onProcessStarted);
+    QObject::connect(process, &QProcess::errorOccurred, this, &VpnSession::onProcessError);
+    QObject::connect(process, &QProcess::readyReadStandardOutput, this, &VpnSession::onProcessStdout);
+    QObject::connect(process, &QProcess::readyReadStandardError, this, &VpnSession::onProcessStderr);
+    QObject::connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this, &VpnSession::onProcessFinished);
+
+    // One parser per stream, so that each one is framed independently
+    QObject::connect(out, &OpenconnectParser::eventDetected, this, &VpnSession::onParserEvent);
+    QObject::connect(err, &OpenconnectParser::eventDetected, this, &VpnSession::onParserEvent);
+    QObject::connect(out, &OpenconnectParser::lineReceived, this, &VpnSession::log);
+    QObject::connect(err, &OpenconnectParser::lineReceived, this, &VpnSession::log);
+}
+
+VpnSession::~VpnSession()
+{
+    cookie.clear();
+    standbyCookie.clear();
+}
+
+QString VpnSession::pathFor(const QString &name)
+{
+    return "/sessions/" + name;
+}
+
+QString VpnSession::objectPath() const
+{
+    return pathFor(sessionName);
+}
+
+bool VpnSession::isRunning() const
+{
+#ifdef HAVE_LIBOPENCONNECT
+    if (library && library->isRunning()) {
+        return true;
+    }
+#endif
+    return openconnect->state() != QProcess::NotRunning;
+}
+
+void VpnSession::terminate()
+{
+    stopRequested = true;
+    setupTimer->stop();
+    abortSwitch("The session is disconnecting");
+
+    if (sleeping) {
+        sleeping = false;
+        if (!isRunning() && !reconnectTimer->isActive()) {
+            // Paused for the suspend, there is no tunnel left to take down
+            finish();
+            return;
+        }
+    }
+
+    if (reconnectTimer->isActive()) {
+        reconnectTimer->stop();
+        finish();
+        return;
+    }
+
+    if (isRunning()) {
+        setStatus(VpnSession::VpnDisconnecting);
+#ifdef HAVE_LIBOPENCONNECT
+        if (libraryBackend) {
+            // Logs off through the command pipe, the worker thread cannot be killed
+            library->cancel();
+            return;
+        }
+#endif
+        openconnect->terminate();
+        killTimer->start();
+    }
+}
+
+QString VpnSession::name()
+{
+    return sessionName;
+}
+
+QString VpnSession::server()
+{
+    return currentServer;
+}
+
+QString VpnSession::interfaceName()
+{
+    return tunInterface;
+}
+
+QString VpnSession::statusName(int status)
+{
+    switch (status) {
+    case VpnSession::VpnNotConnected:
+        return "not_connected";
+    case VpnSession::VpnConnecting:
+        return "connecting";
+    case VpnSession::VpnConnected:
+        return "connected";
+    case VpnSession::VpnDisconnecting:
+        return "disconnecting";
+    }
+    return QString::number(status);
+}
+
+const TunnelMetrics *VpnSession::metrics() const
+{
+    return tunnelMetrics;
+}
+
+qlonglong VpnSession::uptime() const
+{
+    return tunnelMetrics->uptime() / 1000;
+}
+
+int VpnSession::reconnectCount() const
+{
+    return reconnects;
+}
+
+QVariantMap VpnSession::statusDurations() const
+{
+    QVariantMap durations;
+    for (int status = VpnSession::VpnNotConnected; status <= VpnSession::VpnDisconnecting; status++) {
+        durations.insert(statusName(status), tunnelMetrics->timeInStatus(status));
+    }
+    return durations;
+}
+
+void VpnSession::connect(QString server, QString username, QString passwd)
+{
+    connectWithOptions(server, username, passwd, QVariantMap());
+}
+
+void VpnSession::connectWithOptions(QString server, QString username, QString passwd, QVariantMap options)
+{
+    if (vpnStatus != VpnSession::VpnNotConnected || hasPendingConnect) {
+        log("VPN status is: " + QVariant::fromValue(vpnStatus).toString());
+        return;
+    }
+
+    endTrace("superseded");
+    traceId = options.value("traceId").toString();
+    connectSpan = Tracer::begin("service.connect", traceId);
+    resolveEntries = validResolveEntries(options.value("resolve").toStringList());
+
+    failoverCandidates.clear();
+    const QStringList candidates = options.value("candidates").toStringList();
+    for (const QString &candidate : candidates) {
+        if (!candidate.isEmpty() && candidate != server && !failoverCandidates.contains(candidate)) {
+            failoverCandidates << candidate;
+        }
+    }
+
+    currentServer = server;
+    currentUsername = username;
+    cookie.assign(passwd);
+    stopRequested = false;
+    ended = false;
+    authRejected = false;
+    failedOver = false;
+    wasConnected = false;
+    sleeping = false;
+    restoreClock.invalidate();
+    reconnectAttempt = 0;
+    reconnects = 0;
+    tunnelMetrics->reset();
+    notifyPropertiesChanged({ "reconnectCount" });
+
+    libraryBackend = useLibrary(server);
+    tunnelMetrics->setBackendCounts(libraryBackend);
+
+    // The library backend does not need the CLI probe
+    if (!libraryBackend && !probe->isReady()) {
+        log("Waiting for the openconnect probe to finish before connecting");
+        hasPendingConnect = true;
+        tracePhase("service.probe");
+        setStatus(VpnSession::VpnConnecting);
+        probe->refresh();
+        return;
+    }
+
+    startOpenconnect();
+}
+
+// "host:address", the address may be IPv6 and contain colons
+QStringList VpnSession::validResolveEntries(const QStringList &entries)
+{
+    QStringList valid;
+    for (const QString &entry : entries) {
+        const int colon = entry.indexOf(':');
+        if (colon <= 0 || QHostAddress(entry.mid(colon + 1)).isNull()) {
+            continue;
+        }
+        valid << entry;
+    }
+    return valid;
+}
+
+void VpnSession::onProbeFinished()
+{
+    if (!hasPendingConnect) {
+        return;
+    }
+
+    hasPendingConnect = false;
+    setStatus(VpnSession::VpnNotConnected);
+    startOpenconnect();
+}
+
+void VpnSession::startOpenconnect()
+{
+    stdoutParser->reset();
+    stderrParser->reset();
+    setInterface(QString());
+    currentPeer.clear();
+
+    // Bounded only when there is another gateway to go to
+    if (!wasConnected && !failoverCandidates.isEmpty()) {
+        bool ok = false;
+        const int seconds = config->value(currentServer, "setup-timeout").toInt(&ok);
+        setupTimer->start((ok && seconds > 0 ? seconds : SETUP_TIMEOUT_S) * 1000);
+    }
+
+    if (libraryBackend) {
+        startLibrary();
+        return;
+    }
+
+    tracePhase("service.spawn");
+    if (!launch(openconnect, currentServer, currentUsername, cookie)) {
+        endTrace(probe->result().error);
+        emit error(probe->result().error);
+        finish();
+    }
+}
+
+bool VpnSession::useLibrary(const QString &server)
+{
+    const QString backend = config->value(server, "backend", "process");
+#ifdef HAVE_LIBOPENCONNECT
+    return backend == "library";
+#else
+    if (backend == "library") {
+        log("gpservice was built without libopenconnect, using the openconnect binary");
+    }
+    return false;
+#endif
+}
+
+/* The script configuring the tun device, empty for the default one */
+QString VpnSession::vpncScript(const QString &server)
+{
+    const QString script = config->value(server, "vpnc-script");
+    if (script != "builtin") {
+        return script;
+    }
+
+    if (!scripts->isListening()) {
+        log("The built-in vpnc-script is not available, using the default script");
+        return QString();
+    }
+    return scripts->command();
+}
+
+void VpnSession::startLibrary()
+{
+#ifdef HAVE_LIBOPENCONNECT
+    if (!library) {
+        library = new LibOpenconnectTunnel(this);
+        QObject::connect(library, &LibOpenconnectTunnel::progress, this, &VpnSession::log);
+        QObject::connect(library, &LibOpenconnectTunnel::configured, this, &VpnSession::tunnelConfigured);
+        QObject::connect(library, &LibOpenconnectTunnel::reconnected, this, [this]() {
+            emit vpnEvent("Reconnected", OpenconnectParser::monotonicTimestamp(), "The library restored the connection to " + currentServer);
+            // The tun device was kept, only the status is back
+            tunnelConfigured(tunInterface);
+        });
+        QObject::connect(library, &LibOpenconnectTunnel::paused, this, [this]() {
+            if (sleeping) {
+                emit pausedForSleep();
+            }
+        });
+        QObject::connect(library, &LibOpenconnectTunnel::statsReceived, tunnelMetrics, &TunnelMetrics::update);
+        QObject::connect(tunnelMetrics, &TunnelMetrics::sampleRequested, library, &LibOpenconnectTunnel::requestStats);
+        QObject::connect(library, &LibOpenconnectTunnel::finished, this, &VpnSession::onLibraryFinished);
+    }
+
+    QString script = vpncScript(currentServer);
+    if (script.isEmpty()) {
+        for (const QString &path : vpncScriptPaths) {
+            if (QFileInfo::exists(path)) {
+                script = path;
+                break;
+            }
+        }
+    }
+
+    log("Start libopenconnect for " + currentServer + " with the script " + (script.isEmpty() ? "<none>" : script));
+    setStatus(VpnSession::VpnConnecting);
+    tracePhase("service.library");
+
+    if (!library->start(currentServer, cookie, script)) {
+        endTrace("libopenconnect failed to start");
+        emit error("Failed to start libopenconnect for " + currentServer);
+        finish();
+    }
+#endif
+}
+
+void VpnSession::onLibraryFinished(int exitCode)
+{
+    log("libopenconnect exited with code " + QString::number(exitCode));
+    tunnelFinished(exitCode);
+}
+
+bool VpnSession::launch(QProcess *process, const QString &server, const QString &username, const SecureBuffer &secret, const QString &script)
+{
+    const OpenconnectProbe::Result &bin = probe->result();
+    if (bin.path.isEmpty()) {
+        log("Could not find openconnect binary, make sure openconnect is installed, exiting.");
+        return false;
+    }
+
+    if (!bin.valid) {
+        return false;
+    }
+
+    const QStringList extraArgs = config->openconnectArgs(server);
+    log(QString("Got extra OpenConnect args for server: %1 from section [%2], %3")
+        .arg(server, config->sectionName(server), extraArgs.isEmpty() ? "<empty>" : extraArgs.join(" ")));
+
+    QStringList args;
+    args << QCoreApplication::arguments().mid(1)
+         << "--protocol=gp"
+         << extraArgs;
+
+    // Only the built-in handler is passed to the CLI, a script path is set with openconnect-args
+    if (!script.isEmpty()) {
+        args << "--script" << script;
+    } else if (config->value(server, "vpnc-script") == "builtin") {
+        const QString builtin = vpncScript(server);
+        if (!builtin.isEmpty()) {
+            args << "--script" << builtin;
+        }
+    }
+
+    // The address the client resolved, openconnect then connects without a lookup
+    if (bin.resolveSupported) {
+        const QString host = QUrl::fromUserInput(server).host();
+        for (const QString &entry : resolveEntries) {
+            if (entry.section(':', 0, 0) == host) {
+                args << "--resolve" << entry;
+            }
+        }
+    }
+
+    args
+         << "-u" << username
+         << "--cookie-on-stdin"
+         << server;
+
+    log("Start process with arugments: " + args.join(", "));
+
+    process->start(bin.path, args);
+    // Written straight from the locked buffer, without a temporary copy of the cookie
+    process->write(secret.constData(), secret.size());
+    process->write("\n", 1);
+    return true;
+}
+
+void VpnSession::disconnect()
+{
+    if (hasPendingConnect) {
+        hasPendingConnect = false;
+        stopRequested = true;
+        finish();
+        return;
+    }
+
+    terminate();
+}
+
+int VpnSession::status()
+{
+    return vpnStatus;
+}
+
+QVariantMap VpnSession::getLogs(qulonglong sinceSeq, int maxEntries)
+{
+    return logStream->entries(sinceSeq, maxEntries);
+}
+
+void VpnSession::subscribeLogs()
+{
+    if (calledFromDBus()) {
+        logStream->subscribe(message().service());
+    }
+}
+
+void VpnSession::unsubscribeLogs()
+{
+    if (calledFromDBus()) {
+        logStream->unsubscribe(message().service());
+    }
+}
+
+void VpnSession::onProcessStarted()
+{
+    log("Openconnect started successfully, PID=" + QString::number(openconnect->processId()));
+    tracePhase("service.tunnel");
+    setStatus(VpnSession::VpnConnecting);
+}
+
+void VpnSession::onProcessError(QProcess::ProcessError error)
+{
+    log("Error occurred: " + QVariant::fromValue(error).toString());
+
+    // Any other error is followed by finished(), which decides about the reconnect
+    if (error == QProcess::FailedToStart) {
+        finish();
+    }
+}
+
+void VpnSession::onProcessStdout()
+{
+    stdoutParser->feed(openconnect->readAllStandardOutput());
+}
+
+void VpnSession::onProcessStderr()
+{
+    stderrParser->feed(openconnect->readAllStandardError());
+}
+
+void VpnSession::onParserEvent(OpenconnectParser::Event event, qint64 timestamp, const QString &line)
+{
+    if (event == OpenconnectParser::TunnelConfigured) {
+        tunnelConfigured(discoverInterface(openconnect->processId()));
+    } else if (event == OpenconnectParser::AuthExpired) {
+        authRejected = true;
+    } else if (event == OpenconnectParser::PeerConnected) {
+        const QString peer = peerAddress(line);
+        if (!peer.isEmpty()) {
+            currentPeer = peer;
+        }
+    }
+
+    if (phaseSpan) {
+        Tracer::instant("openconnect.event", OpenconnectParser::eventName(event), traceId);
+    }
+
+    emit vpnEvent(OpenconnectParser::eventName(event), timestamp, line);
+}
+
+void VpnSession::tunnelConfigured(const QString &interface)
+{
+    finishRestore();
+
+    if (vpnStatus == VpnSession::VpnConnected) {
+        return;
+    }
+
+    // The reconnects stay on this gateway
+    setupTimer->stop();
+    failoverCandidates.clear();
+
+    setStatus(VpnSession::VpnConnected);
+    setInterface(interface);
+    log("Tunnel interface: " + (tunInterface.isEmpty() ? "<unknown>" : tunInterface));
+    endTrace(tunInterface);
+
+    // A reconnect that succeeded is not reported as a new connection
+    const bool restored = wasConnected;
+    wasConnected = true;
+    reconnectAttempt = 0;
+    breaker->recordSuccess(currentServer);
+    if (!restored) {
+        emit connected();
+    }
+}
+
+void VpnSession::onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    killTimer->stop();
+    stdoutParser->flush();
+    stderrParser->flush();
+
+    log("Openconnect process exited with code " + QString::number(exitCode) + " and exit status " + QVariant::fromValue(exitStatus).toString());
+    tunnelFinished(exitCode);
+}
+
+void VpnSession::tunnelFinished(int exitCode)
+{
+    setInterface(QString());
+
+    // Already over, e.g. errorOccurred() followed by finished()
+    if (ended) {
+        return;
+    }
+
+    if (sleeping && !stopRequested) {
+        log("The tunnel to " + currentServer + " is paused until the system resumes");
+        emit pausedForSleep();
+        return;
+    }
+
+    // A failover would present the same cookie to the next gateway
+    if (!stopRequested && !wasConnected && (authRejected || exitCode == EXIT_COOKIE_REJECTED)) {
+        setupRejected();
+        return;
+    }
+
+    if (failOver()) {
+        return;
+    }
+
+    if (shouldReconnect(exitCode)) {
+        scheduleReconnect();
+        return;
+    }
+
+    finish();
+}
+
+bool VpnSession::shouldReconnect(int exitCode)
+{
+    if (stopRequested || !wasConnected || cookie.isEmpty()) {
+        return false;
+    }
+
+    if (authRejected || exitCode == EXIT_COOKIE_REJECTED) {
+        log("The gateway rejected the cookie, not reconnecting");
+        emit error("The VPN session has expired, please log in again.");
+        return false;
+    }
+
+    if (config->value(currentServer, "auto-reconnect", "true").compare("false", Qt::CaseInsensitive) == 0) {
+        return false;
+    }
+
+    // The circuit breaker only delays the reconnect, see scheduleReconnect()
+    breaker->recordFailure(currentServer);
+    if (!breaker->allow(currentServer)) {
+        log("Too many connection failures to " + currentServer + ", waiting for the circuit breaker to let one attempt through");
+    }
+
+    return true;
+}
+
+/* Exponential backoff with full jitter, so that many clients cut off at once do not reconnect in lockstep */
+void VpnSession::scheduleReconnect()
+{
+    int delay = 0;
+    if (reconnectAttempt > 0) {
+        const qint64 cap = qMin<qint64>(RECONNECT_MAX_DELAY_MS, qint64(RECONNECT_BASE_DELAY_MS) << qMin(reconnectAttempt, 16));
+        delay = int(QRandomGenerator::global()->bounded(cap + 1));
+    }
+    // Not before the circuit breaker half-opens
+    delay = int(qMax<qint64>(delay, breaker->retryDelay(currentServer)));
+    reconnectAttempt++;
+    reconnects++;
+    notifyPropertiesChanged({ "reconnectCount" });
+
+    log(QString("Reconnecting to %1 in %2 ms (attempt %3)").arg(currentServer).arg(delay).arg(reconnectAttempt));
+    setStatus(VpnSession::VpnConnecting);
+    emit vpnEvent(OpenconnectParser::eventName(OpenconnectParser::Reconnecting),
+                  OpenconnectParser::monotonicTimestamp(),
+                  "Reconnecting to " + currentServer);
+
+    reconnectTimer->start(delay);
+}
+
+void VpnSession::onReconnectTimeout()
+{
+    if (stopRequested) {
+        return;
+    }
+
+    authRejected = false;
+    startOpenconnect();
+}
+
+/* Before a suspend: the tunnel goes down without logging off, the cookie is kept for resumeAfterSleep() */
+bool VpnSession::pauseForSleep()
+{
+    if (stopRequested || sleeping || !wasConnected || cookie.isEmpty()) {
+        return false;
+    }
+
+    sleeping = true;
+    restoreClock.invalidate();
+    setStatus(VpnSession::VpnConnecting);
+    log("Pausing the tunnel to " + currentServer + " for the suspend");
+    emit vpnEvent("Paused", OpenconnectParser::monotonicTimestamp(), "Pausing the tunnel to " + currentServer + " for the suspend");
+
+    if (reconnectTimer->isActive()) {
+        // Waiting for a reconnect, it is made on resume instead
+        reconnectTimer->stop();
+        return false;
+    }
+
+#ifdef HAVE_LIBOPENCONNECT
+    if (libraryBackend) {
+        if (!library->isRunning()) {
+            return false;
+        }
+        library->pause();
+        return true;
+    }
+#endif
+
+    if (openconnect->state() == QProcess::NotRunning) {
+        return false;
+    }
+
+    // SIGHUP: openconnect disconnects and restores the network, the session is not logged off
+    ::kill(pid_t(openconnect->processId()), SIGHUP);
+    return true;
+}
+
+void VpnSession::resumeAfterSleep()
+{
+    if (!sleeping) {
+        return;
+    }
+
+    sleeping = false;
+    reconnectAttempt = 0;
+    restoreClock.start();
+    log("The system resumed, restoring the tunnel to " + currentServer);
+
+#ifdef HAVE_LIBOPENCONNECT
+    if (libraryBackend && library->isRunning()) {
+        library->resume();
+        return;
+    }
+#endif
+
+    if (openconnect->state() != QProcess::NotRunning) {
+        // Did not exit before the suspend, it reconnects in place
+        ::kill(pid_t(openconnect->processId()), SIGUSR2);
+        return;
+    }
+
+    authRejected = false;
+    startOpenconnect();
+}
+
+/* A new default route: the connection of the tunnel goes through the old network, replace it now */
+void VpnSession::networkChanged()
+{
+    if (stopRequested || sleeping || !wasConnected || cookie.isEmpty()) {
+        return;
+    }
+    if (config->value(currentServer, "network-reconnect", "true").compare("false", Qt::CaseInsensitive) == 0) {
+        return;
+    }
+
+    if (reconnectTimer->isActive()) {
+        // The backoff was for the previous network
+        log("The network changed, reconnecting to " + currentServer + " now");
+        reconnectTimer->stop();
+        reconnectAttempt = 0;
+        if (!restoreClock.isValid()) {
+            restoreClock.start();
+        }
+        onReconnectTimeout();
+        return;
+    }
+
+    // Still being set up or restored, it will use the new network
+    if (vpnStatus != VpnSession::VpnConnected) {
+        return;
+    }
+
+    log("The network changed, reconnecting to " + currentServer + " now");
+    restoreClock.start();
+    emit vpnEvent(OpenconnectParser::eventName(OpenconnectParser::Reconnecting),
+                  OpenconnectParser::monotonicTimestamp(),
+                  "The network changed, reconnecting to " + currentServer);
+
+#ifdef HAVE_LIBOPENCONNECT
+    if (libraryBackend) {
+        library->reconnect();
+        return;
+    }
+#endif
+
+    if (openconnect->state() != QProcess::NotRunning) {
+        // SIGUSR2: openconnect drops the connection and makes a new one at once
+        ::kill(pid_t(openconnect->processId()), SIGUSR2);
+    }
+}
+
+void VpnSession::finishRestore()
+{
+    if (!restoreClock.isValid()) {
+        return;
+    }
+
+    const qint64 elapsed = restoreClock.elapsed();
+    restoreClock.invalidate();
+    tunnelMetrics->recordRestore(elapsed);
+    notifyPropertiesChanged({ "lastRestoreTime" });
+
+    log(QString("The tunnel to %1 was restored in %2 ms").arg(currentServer).arg(elapsed));
+    emit vpnEvent("Restored", OpenconnectParser::monotonicTimestamp(), QString("Restored in %1 ms").arg(elapsed));
+}
+
+void VpnSession::switchGateway(QString server, QString username, QString passwd)
+{
+    if (libraryBackend) {
+        log("Gateway switching is only supported with the openconnect binary backend");
+        emit switchFailed("The library backend does not support gateway switching");
+        return;
+    }
+
+    if (vpnStatus != VpnSession::VpnConnected || standby) {
+        log("Cannot switch gateway now, VPN status is: " + QVariant::fromValue(vpnStatus).toString());
+        emit switchFailed("The session is not connected or is already switching");
+        return;
+    }
+
+    if (server == currentServer) {
+        log("Already connected to " + server);
+        emit switched(server);
+        return;
+    }
+
+    // A second vpnc-script run would overwrite the default route and resolv.conf saved by the first one
+    if (!scripts->isListening()) {
+        log("The built-in vpnc-script is not available, cannot bring up a second tunnel");
+        emit switchFailed("Gateway switching needs the built-in vpnc-script of gpservice");
+        return;
+    }
+
+    standbyServer = server;
+    standbyUsername = username;
+    standbyPeer.clear();
+    standbyCookie.assign(passwd);
+
+    standby = new QProcess(this);
+    QProcess *process = standby;
+    QObject::connect(process, &QProcess::readyReadStandardOutput, this, [this, process]() {
+        standbyStdoutParser->feed(process->readAllStandardOutput());
+    });
+    QObject::connect(process, &QProcess::readyReadStandardError, this, [this, process]() {
+        standbyStderrParser->feed(process->readAllStandardError());
+    });
+    QObject::connect(process, &QProcess::errorOccurred, this, [this](QProcess::ProcessError error) {
+        if (error == QProcess::FailedToStart) {
+            abortSwitch("The new tunnel failed to start");
+        }
+    });
+    QObject::connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this, &VpnSession::onStandbyFinished);
+
+    for (OpenconnectParser *parser : { standbyStdoutParser, standbyStderrParser }) {
+        parser->reset();
+        QObject::connect(parser, &OpenconnectParser::eventDetected, this, &VpnSession::onStandbyEvent);
+        QObject::connect(parser, &OpenconnectParser::lineReceived, this, [this](const QString &line) {
+            log("[" + standbyServer + "] " + line);
+        });
+    }
+
+    log("Switching from " + currentServer + " to " + server + ", the current tunnel stays up until the new one is configured");
+    switchTimer->start();
+
+    // The new gateway must not be reached through the tunnel it replaces
+    standbyPin = new GatewayPin(tunInterface, currentPeer, this);
+    QObject::connect(standbyPin, &GatewayPin::message, this, &VpnSession::log);
+    QObject::connect(standbyPin, &GatewayPin::finished, this, &VpnSession::onPinFinished);
+    standbyPin->start(QUrl::fromUserInput(server).host());
+}
+
+void VpnSession::onPinFinished(bool ok)
+{
+    if (!standby) {
+        return;
+    }
+
+    if (!ok) {
+        abortSwitch("Could not route the new gateway outside of the current tunnel");
+        return;
+    }
+
+    if (!launch(standby, standbyServer, standbyUsername, standbyCookie, scripts->command())) {
+        abortSwitch(probe->result().error);
+    }
+}
+
+void VpnSession::onStandbyEvent(OpenconnectParser::Event event, qint64 timestamp, const QString &line)
+{
+    Q_UNUSED(timestamp)
+
+    if (event == OpenconnectParser::PeerConnected) {
+        const QString peer = peerAddress(line);
+        if (!peer.isEmpty()) {
+            standbyPeer = peer;
+        }
+    } else if (event == OpenconnectParser::AuthExpired) {
+        abortSwitch("The new gateway rejected the cookie");
+    } else if (event == OpenconnectParser::TunnelConfigured) {
+        promoteStandby();
+    }
+}
+
+void VpnSession::onStandbyFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    Q_UNUSED(exitStatus)
+    abortSwitch(QString("The new tunnel exited with code %1").arg(exitCode));
+}
+
+/* The new tunnel is configured: make it the active one and move the routes over */
+void VpnSession::promoteStandby()
+{
+    switchTimer->stop();
+
+    QProcess *old = openconnect;
+    const QString oldInterface = tunInterface;
+
+    for (QObject *sender : std::initializer_list<QObject *> { old, standby, stdoutParser, stderrParser, standbyStdoutParser, standbyStderrParser }) {
+        QObject::disconnect(sender, nullptr, this, nullptr);
+    }
+
+    openconnect = standby;
+    standby = nullptr;
+    std::swap(stdoutParser, standbyStdoutParser);
+    std::swap(stderrParser, standbyStderrParser);
+    attachProcess(openconnect, stdoutParser, stderrParser);
+
+    currentServer = standbyServer;
+    currentUsername = standbyUsername;
+    currentPeer = standbyPeer;
+    cookie.swap(standbyCookie);
+    standbyCookie.clear();
+    setInterface(discoverInterface(openconnect->processId()));
+    authRejected = false;
+    reconnectAttempt = 0;
+    breaker->recordSuccess(currentServer);
+
+    log("Tunnel interface: " + (tunInterface.isEmpty() ? "<unknown>" : tunInterface));
+
+    // The route of the address it connected to now belongs to the vpnc-script of the new tunnel,
+    // the other addresses of the gateway were pinned in case openconnect picked them
+    if (currentPeer.isEmpty()) {
+        log("The address of the new gateway is unknown, its pinned routes are kept");
+    } else {
+        standbyPin->releaseExcept(currentPeer);
+    }
+    standbyPin->deleteLater();
+    standbyPin = nullptr;
+
+    // The output of the old tunnel is of no interest anymore, but the pipes must not fill up
+    retiring = old;
+    QObject::connect(old, &QProcess::readyReadStandardOutput, this, [old]() { old->readAllStandardOutput(); });
+    QObject::connect(old, &QProcess::readyReadStandardError, this, [old]() { old->readAllStandardError(); });
+    QObject::connect(old, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this, [this, old]() {
+        if (retiring == old) {
+            retiring = nullptr;
+        }
+        log("The previous tunnel is down");
+    });
+
+    auto *handover = new TunnelHandover(oldInterface, tunInterface, this);
+    QObject::connect(handover, &TunnelHandover::message, this, &VpnSession::log);
+    QObject::connect(handover, &TunnelHandover::finished, this, &VpnSession::onHandoverFinished);
+    QObject::connect(handover, &TunnelHandover::finished, handover, &QObject::deleteLater);
+    handover->start();
+}
+
+void VpnSession::onHandoverFinished(bool ok)
+{
+    if (!ok) {
+        log("Could not move the routes, relying on the vpnc-script of the new tunnel");
+    }
+
+    if (retiring) {
+        stopProcess(retiring);
+    }
+
+    log("Switched to " + currentServer);
+    emit switched(currentServer);
+}
+
+void VpnSession::abortSwitch(const QString &reason)
+{
+    if (!standby) {
+        return;
+    }
+
+    switchTimer->stop();
+    QProcess *process = standby;
+    standby = nullptr;
+    standbyCookie.clear();
+
+    QObject::disconnect(process, nullptr, this, nullptr);
+    QObject::disconnect(standbyStdoutParser, nullptr, this, nullptr);
+    QObject::disconnect(standbyStderrParser, nullptr, this, nullptr);
+    stopProcess(process);
+
+    if (standbyPin) {
+        standbyPin->release();
+        standbyPin->deleteLater();
+        standbyPin = nullptr;
+    }
+
+    log("Switch to " + standbyServer + " failed: " + reason + ", staying on " + currentServer);
+    emit switchFailed(reason);
+}
+
+/* Lets a tunnel that is no longer the active one log off, then releases it */
+void VpnSession::stopProcess(QProcess *process)
+{
+    QObject::connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), process, &QObject::deleteLater);
+
+    if (process->state() == QProcess::NotRunning) {
+        process->deleteLater();
+        return;
+    }
+
+    process->terminate();
+    QTimer::singleShot(TERMINATE_TIMEOUT_MS, process, [process]() {
+        process->kill();
+    });
+}
+
+bool VpnSession::failOver()
+{
+    setupTimer->stop();
+    if (stopRequested || wasConnected || failoverCandidates.isEmpty() || cookie.isEmpty()) {
+        return false;
+    }
+
+    const QString failed = currentServer;
+    breaker->recordFailure(failed);
+
+    // The gateways that keep failing are skipped
+    while (!failoverCandidates.isEmpty() && !breaker->allow(failoverCandidates.first())) {
+        log("Skipping " + failoverCandidates.takeFirst() + ", it keeps failing");
+    }
+    if (failoverCandidates.isEmpty()) {
+        return false;
+    }
+
+    currentServer = failoverCandidates.takeFirst();
+    failedOver = true;
+    authRejected = false;
+    log(QString("%1 failed during the setup, trying %2 (%3 more left)").arg(failed, currentServer).arg(failoverCandidates.size()));
+    emit vpnEvent("FailingOver", OpenconnectParser::monotonicTimestamp(), "Trying " + currentServer + " after " + failed);
+    emit failingOver(currentServer);
+
+    libraryBackend = useLibrary(currentServer);
+    tunnelMetrics->setBackendCounts(libraryBackend);
+    setStatus(VpnSession::VpnConnecting);
+    startOpenconnect();
+    return true;
+}
+
+/* The cookie is issued by one gateway, a candidate rejecting it is not failing and needs its own login */
+void VpnSession::setupRejected()
+{
+    setupTimer->stop();
+    failoverCandidates.clear();
+
+    if (failedOver) {
+        log(currentServer + " rejected the cookie of the gateway it was tried after, it needs its own login");
+        emit authRequired(currentServer);
+    } else {
+        log("The gateway rejected the cookie during the setup");
+        emit error("The gateway rejected the login, please log in again.");
+    }
+
+    finish();
+}
+
+/* Stops the attempt on the current gateway, tunnelFinished() then goes on with the next one */
+void VpnSession::abandonSetup()
+{
+#ifdef HAVE_LIBOPENCONNECT
+    if (libraryBackend) {
+        library->cancel();
+        return;
+    }
+#endif
+    if (openconnect->state() != QProcess::NotRunning) {
+        openconnect->terminate();
+        killTimer->start();
+    }
+}
+
+/* Once per connect, disconnected() is what releases a named session */
+void VpnSession::finish()
+{
+    if (ended) {
+        return;
+    }
+    ended = true;
+
+    setupTimer->stop();
+    sleeping = false;
+    restoreClock.invalidate();
+    cookie.clear();
+    endTrace("disconnected");
+    setStatus(VpnSession::VpnNotConnected);
+    emit disconnected();
+}
+
+void VpnSession::tracePhase(const char *name)
+{
+    Tracer::end(phaseSpan);
+    phaseSpan = Tracer::begin(name, traceId);
+}
+
+void VpnSession::endTrace(const QString &detail)
+{
+    Tracer::end(phaseSpan, detail);
+    Tracer::end(connectSpan, detail);
+    phaseSpan = 0;
+    connectSpan = 0;
+}
+
+/* The tun device is not reported by openconnect, find it in the fdinfo of the tun file descriptor */
+QString VpnSession::discoverInterface(qint64 pid)
+{
+    QDir fdDir(QString("/proc/%1/fd").arg(pid));
+    const QFileInfoList fds = fdDir.entryInfoList(QDir::AllEntries | QDir::System | QDir::NoDotAndDotDot);
+
+    for (const QFileInfo &fd : fds) {
+        if (fd.symLinkTarget() != "/dev/net/tun") {
+            continue;
+        }
+
+        QFile fdInfo(QString("/proc/%1/fdinfo/%2").arg(pid).arg(fd.fileName()));
+        if (!fdInfo.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+
+        const QList<QByteArray> lines = fdInfo.readAll().split('\n');
+        for (const QByteArray &line : lines) {
+            if (line.startsWith("iff:")) {
+                return QString::fromUtf8(line.mid(4).trimmed());
+            }
+        }
+    }
+
+    return QString();
+}
+
+void VpnSession::setStatus(int status)
+{
+    if (status == vpnStatus) {
+        return;
+    }
+
+    vpnStatus = status;
+    tunnelMetrics->setStatus(status);
+    notifyPropertiesChanged({ "statusDurations", "uptime" });
+}
+
+void VpnSession::setInterface(const QString &name)
+{
+    tunInterface = name;
+
+    if (!name.isEmpty()) {
+        bool ok;
+        const int interval = config->value(currentServer, "metrics-interval").toInt(&ok);
+        tunnelMetrics->setInterval(ok ? interval * 1000 : 0);
+    }
+    tunnelMetrics->setInterface(name);
+}
+
+void VpnSession::onMetricsSampled()
+{
+    notifyPropertiesChanged({ "rxBytes", "txBytes", "rxPackets", "txPackets", "rxErrors", "txErrors",
+                              "rxDropped", "txDropped", "uptime", "statusDurations" });
+}
+
+void VpnSession::notifyPropertiesChanged(const QStringList &names)
+{
+    for (const QString &name : names) {
+        changedProperties.insert(name);
+    }
+    if (!propertiesTimer->isActive()) {
+        propertiesTimer->start();
+    }
+}
+
+void VpnSession::flushPropertiesChanged()
+{
+    QVariantMap changed;
+    for (const QString &name : std::as_const(changedProperties)) {
+        changed.insert(name, property(name.toLatin1().constData()));
+    }
+    changedProperties.clear();
+
+    QDBusMessage msg = QDBusMessage::createSignal(objectPath(), "org.freedesktop.DBus.Properties", "PropertiesChanged");
+    msg << QString("com.pacha.qt.GPService.Session") << changed << QStringList();
+    QDBusConnection::systemBus().send(msg);
+}
+
+QString VpnSession::peerAddress(const QString &line)
+{
+    static const QRegularExpression connectedTo("Connected to \\[?([0-9A-Fa-f:.]+)\\]?:\\d+$");
+    return connectedTo.match(line).captured(1);
+}
+
+void VpnSession::log(QString msg)
+{
+    logStream->append(msg);
+    emit logged(msg);
+}
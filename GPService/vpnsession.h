@@ -0,0 +1,289 @@
+#ifndef VPNSESSION_H
+#define VPNSESSION_H
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QObject>
+#include <QtCore/QProcess>
+#include <QtCore/QSet>
+#include <QtCore/QTimer>
+#include <QtCore/QVariantMap>
+#include <QtDBus/QDBusContext>
+
+#include "openconnectparser.h"
+#include "openconnectprobe.h"
+#include "gpconfig.h"
+#include "logstream.h"
+#include "securebuffer.h"
+#include "circuitbreaker.h"
+#include "tunnelhandover.h"
+#include "gatewaypin.h"
+#include "tunnelmetrics.h"
+#include "tracer.h"
+#include "scripthandler.h"
+
+class LibOpenconnectTunnel;
+
+/*
+ * One tunnel managed by gpservice.
+ *
+ * Each session owns its openconnect process, status, tun interface and log
+ * stream, and is exported on its own object path (/sessions/<name>). Only the
+ * Q_SCRIPTABLE members are part of the D-Bus interface. Nothing in a session
+ * blocks the event loop, so a slow teardown never stalls the other sessions.
+ *
+ * A gateway switch is make-before-break: the new gateway is pinned to the
+ * underlay, the new tunnel comes up on its own tun device next to the current
+ * one, the routes are moved over once it is configured, and only then the old
+ * tunnel is torn down. The new tunnel is always configured by the built-in
+ * handler (see ScriptHandler), so that the two tunnels never share the state
+ * vpnc-script keeps for the default route and resolv.conf.
+ *
+ * The tunnel is run either by the openconnect CLI (the default) or in-process
+ * through libopenconnect, selected per gateway with backend= in gp.conf.
+ *
+ * The traffic counters and health figures are D-Bus properties, their
+ * changes are coalesced into one PropertiesChanged signal per second.
+ *
+ * A connect request may carry the trace id of the client (options
+ * "traceId"), the phases of the session are then recorded as spans of that
+ * trace, see Tracer. It may also carry the addresses the client resolved for
+ * the gateways (options "resolve", "host:address" entries), passed to
+ * openconnect with --resolve when it supports the option.
+ *
+ * With the other gateways of the portal (options "candidates", in the order
+ * of preference), a gateway that fails before the tunnel is configured, or
+ * is not configured within setup-timeout, is left for the next candidate.
+ * failingOver() reports each gateway tried after the requested one. Once the
+ * tunnel was up, the reconnects stay on its gateway. A rejected cookie is not
+ * a failure of the gateway: the cookie is only valid for the gateway that
+ * issued it, so the setup stops there, without counting against the circuit
+ * breaker, and authRequired() asks for a login to the candidate.
+ *
+ * A tunnel that was up follows the host: it is paused without logging off
+ * before a suspend and restored with the same cookie on resume, and a new
+ * default route makes openconnect reconnect at once rather than wait for
+ * the dead peer detection (network-reconnect in gp.conf). The time to the
+ * restored tunnel is part of the metrics.
+ */
+class VpnSession : public QObject, protected QDBusContext
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "com.pacha.qt.GPService.Session")
+    Q_PROPERTY(qulonglong rxBytes READ rxBytes)
+    Q_PROPERTY(qulonglong txBytes READ txBytes)
+    Q_PROPERTY(qulonglong rxPackets READ rxPackets)
+    Q_PROPERTY(qulonglong txPackets READ txPackets)
+    Q_PROPERTY(qulonglong rxErrors READ rxErrors)
+    Q_PROPERTY(qulonglong txErrors READ txErrors)
+    Q_PROPERTY(qulonglong rxDropped READ rxDropped)
+    Q_PROPERTY(qulonglong txDropped READ txDropped)
+    // Seconds since the tunnel came up, including the automatic reconnects
+    Q_PROPERTY(qlonglong uptime READ uptime)
+    Q_PROPERTY(int reconnectCount READ reconnectCount)
+    // Milliseconds spent in each status, keyed by statusName()
+    Q_PROPERTY(QVariantMap statusDurations READ statusDurations)
+    // Milliseconds the last restore after a network change or a resume took
+    Q_PROPERTY(qlonglong lastRestoreTime READ lastRestoreTime)
+public:
+    enum VpnStatus {
+        VpnNotConnected,
+        VpnConnecting,
+        VpnConnected,
+        VpnDisconnecting,
+    };
+
+    VpnSession(const QString &name, OpenconnectProbe *probe, GPConfig *config, CircuitBreaker *breaker, ScriptHandler *scripts, QObject *parent = nullptr);
+    ~VpnSession();
+
+    static QString pathFor(const QString &name);
+    QString objectPath() const;
+    bool isRunning() const;
+    void terminate();
+    // Returns whether pausedForSleep() is to be waited for
+    bool pauseForSleep();
+    void resumeAfterSleep();
+    void networkChanged();
+
+    static QString statusName(int status);
+    const TunnelMetrics *metrics() const;
+
+    qulonglong rxBytes() const { return tunnelMetrics->counters().rxBytes; }
+    qulonglong txBytes() const { return tunnelMetrics->counters().txBytes; }
+    qulonglong rxPackets() const { return tunnelMetrics->counters().rxPackets; }
+    qulonglong txPackets() const { return tunnelMetrics->counters().txPackets; }
+    qulonglong rxErrors() const { return tunnelMetrics->counters().rxErrors; }
+    qulonglong txErrors() const { return tunnelMetrics->counters().txErrors; }
+    qulonglong rxDropped() const { return tunnelMetrics->counters().rxDropped; }
+    qulonglong txDropped() const { return tunnelMetrics->counters().txDropped; }
+    qlonglong uptime() const;
+    int reconnectCount() const;
+    QVariantMap statusDurations() const;
+    qlonglong lastRestoreTime() const { return tunnelMetrics->lastRestoreTime(); }
+
+signals:
+    Q_SCRIPTABLE void connected();
+    Q_SCRIPTABLE void disconnected();
+    Q_SCRIPTABLE void error(QString errorMessage);
+    Q_SCRIPTABLE void vpnEvent(QString event, qlonglong timestamp, QString message);
+    // Only delivered to the subscribers, see subscribeLogs()
+    Q_SCRIPTABLE void logsAvailable(qulonglong firstSeq, QStringList lines);
+    Q_SCRIPTABLE void switched(QString server);
+    // The switch was abandoned, the session is still connected to the previous gateway
+    Q_SCRIPTABLE void switchFailed(QString errorMessage);
+    // The gateway connecting failed during the setup, the connection goes on with server
+    Q_SCRIPTABLE void failingOver(QString server);
+    // The failover candidate server rejected the cookie, the connect is to be retried with a login to server
+    Q_SCRIPTABLE void authRequired(QString server);
+
+    // Every log line of the session, for the service-wide log
+    void logged(QString msg);
+    // The tunnel is down for the suspend, see pauseForSleep()
+    void pausedForSleep();
+
+public slots:
+    Q_SCRIPTABLE void connect(QString server, QString username, QString passwd);
+    Q_SCRIPTABLE void connectWithOptions(QString server, QString username, QString passwd, QVariantMap options);
+    Q_SCRIPTABLE void disconnect();
+    Q_SCRIPTABLE void switchGateway(QString server, QString username, QString passwd);
+    Q_SCRIPTABLE int status();
+    Q_SCRIPTABLE QString name();
+    Q_SCRIPTABLE QString server();
+    Q_SCRIPTABLE QString interfaceName();
+
+    Q_SCRIPTABLE QVariantMap getLogs(qulonglong sinceSeq, int maxEntries);
+    Q_SCRIPTABLE void subscribeLogs();
+    Q_SCRIPTABLE void unsubscribeLogs();
+
+private slots:
+    void onProcessStarted();
+    void onProcessError(QProcess::ProcessError error);
+    void onProcessStdout();
+    void onProcessStderr();
+    void onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void onParserEvent(OpenconnectParser::Event event, qint64 timestamp, const QString &line);
+    void onProbeFinished();
+    void onReconnectTimeout();
+    void onStandbyEvent(OpenconnectParser::Event event, qint64 timestamp, const QString &line);
+    void onStandbyFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void onPinFinished(bool ok);
+    void onHandoverFinished(bool ok);
+    void onMetricsSampled();
+    void onLibraryFinished(int exitCode);
+    void flushPropertiesChanged();
+
+private:
+    // Time given to openconnect to log off and restore the network before it is killed
+    static const int TERMINATE_TIMEOUT_MS { 10000 };
+    // Backoff of the automatic reconnects, the first one is immediate
+    static const int RECONNECT_BASE_DELAY_MS { 500 };
+    static const int RECONNECT_MAX_DELAY_MS { 30000 };
+    // openconnect exits with this code when the gateway rejects the cookie
+    static const int EXIT_COOKIE_REJECTED { 2 };
+    // Time given to the new tunnel of a gateway switch to get configured
+    static const int SWITCH_TIMEOUT_MS { 60000 };
+    // Time given to a gateway to configure the tunnel while other candidates remain, see setup-timeout
+    static const int SETUP_TIMEOUT_S { 15 };
+    static const int PROPERTIES_CHANGED_DELAY_MS { 1000 };
+
+    QString sessionName;
+    QProcess *openconnect;
+    // Only created when the library backend is used
+    LibOpenconnectTunnel *library = nullptr;
+    bool libraryBackend = false;
+    OpenconnectParser *stdoutParser;
+    OpenconnectParser *stderrParser;
+
+    // The tunnel brought up by switchGateway(), promoted once it is configured
+    QProcess *standby = nullptr;
+    OpenconnectParser *standbyStdoutParser;
+    OpenconnectParser *standbyStderrParser;
+    QTimer *switchTimer;
+    // Routes the new gateway around the current tunnel until the standby one is up, see GatewayPin
+    GatewayPin *standbyPin = nullptr;
+    QString standbyServer;
+    QString standbyUsername;
+    QString standbyPeer;
+    SecureBuffer standbyCookie;
+    // The previous tunnel, torn down once the routes are moved
+    QProcess *retiring = nullptr;
+
+    // The gateways left to try while the tunnel was never configured, see connectWithOptions()
+    QStringList failoverCandidates;
+    QTimer *setupTimer;
+
+    OpenconnectProbe *probe;
+    GPConfig *config;
+    LogStream *logStream;
+    CircuitBreaker *breaker;
+    ScriptHandler *scripts;
+    QTimer *killTimer;
+    QTimer *reconnectTimer;
+    TunnelMetrics *tunnelMetrics;
+    QTimer *propertiesTimer;
+    QSet<QString> changedProperties;
+
+    QString currentServer;
+    QString currentUsername;
+    QString tunInterface;
+    // The address openconnect connected to, used to pin the gateway route on a switch
+    QString currentPeer;
+    // The gateway cookie, kept for the automatic reconnects
+    SecureBuffer cookie;
+
+    int vpnStatus = VpnSession::VpnNotConnected;
+
+    // The connect request waiting for the openconnect probe to finish
+    bool hasPendingConnect = false;
+
+    bool stopRequested = false;
+    // finish() ran for the last connect, the session is not finished twice
+    bool ended = true;
+    bool authRejected = false;
+    // The gateway being set up is a failover candidate, not the one the cookie is for
+    bool failedOver = false;
+    // The tunnel came up at least once since connect(), only then it is restored automatically
+    bool wasConnected = false;
+    int reconnectAttempt = 0;
+    int reconnects = 0;
+    // Paused for the suspend, restored by resumeAfterSleep()
+    bool sleeping = false;
+    // Started by a network change or a resume, until the tunnel is back
+    QElapsedTimer restoreClock;
+
+    // Set by the client, see connectWithOptions()
+    QString traceId;
+    // "host:address" of the servers the client resolved, see connectWithOptions()
+    QStringList resolveEntries;
+    Tracer::SpanId connectSpan = 0;
+    Tracer::SpanId phaseSpan = 0;
+
+    void log(QString msg);
+    void setStatus(int status);
+    void setInterface(const QString &name);
+    void notifyPropertiesChanged(const QStringList &names);
+    void tracePhase(const char *name);
+    void endTrace(const QString &detail);
+    static QStringList validResolveEntries(const QStringList &entries);
+    bool failOver();
+    void setupRejected();
+    void abandonSetup();
+    void attachProcess(QProcess *process, OpenconnectParser *out, OpenconnectParser *err);
+    bool launch(QProcess *process, const QString &server, const QString &username, const SecureBuffer &secret, const QString &script = QString());
+    void startOpenconnect();
+    bool useLibrary(const QString &server);
+    QString vpncScript(const QString &server);
+    void startLibrary();
+    void tunnelConfigured(const QString &interface);
+    void tunnelFinished(int exitCode);
+    void promoteStandby();
+    void abortSwitch(const QString &reason);
+    void stopProcess(QProcess *process);
+    bool shouldReconnect(int exitCode);
+    void scheduleReconnect();
+    void finishRestore();
+    void finish();
+    static QString discoverInterface(qint64 pid);
+    static QString peerAddress(const QString &line);
+};
+
+#endif // VPNSESSION_H
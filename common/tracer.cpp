@@ -0,0 +1,194 @@
+#include <QtCore/QHash>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QUuid>
+#include <time.h>
+#include <unistd.h>
+
+#include "tracer.h"
+
+std::atomic<bool> Tracer::enabled { false };
+
+namespace {
+
+// Bounds the memory of a long running process with tracing on
+const int MAX_EVENTS = 4096;
+const int MAX_OPEN_SPANS = 256;
+
+struct OpenSpan {
+    QString traceId;
+    const char *name;
+    qint64 start;
+};
+
+struct State {
+    QMutex mutex;
+    QString processName;
+    QString currentTrace;
+    Tracer::SpanId nextSpan { 1 };
+    QHash<Tracer::SpanId, OpenSpan> open;
+    QList<QJsonObject> done;
+};
+
+State &state()
+{
+    static State s;
+    return s;
+}
+
+void record(State &s, const QJsonObject &event)
+{
+    if (s.done.size() >= MAX_EVENTS) {
+        s.done.removeFirst();
+    }
+    s.done.append(event);
+}
+
+}
+
+void Tracer::setEnabled(bool value)
+{
+    enabled.store(value, std::memory_order_relaxed);
+}
+
+void Tracer::setProcessName(const QString &name)
+{
+    State &s = state();
+    QMutexLocker locker(&s.mutex);
+    s.processName = name;
+}
+
+QString Tracer::newTraceId()
+{
+    if (!isEnabled()) {
+        return QString();
+    }
+    return QUuid::createUuid().toString(QUuid::WithoutBraces);
+}
+
+void Tracer::setCurrentTrace(const QString &traceId)
+{
+    state().currentTrace = traceId;
+}
+
+QString Tracer::currentTrace()
+{
+    return state().currentTrace;
+}
+
+qint64 Tracer::now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return qint64(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+Tracer::SpanId Tracer::begin(const char *name, const QString &traceId)
+{
+    if (!isEnabled() || traceId.isEmpty()) {
+        return 0;
+    }
+
+    State &s = state();
+    QMutexLocker locker(&s.mutex);
+
+    // Spans that were never ended, e.g. a login window left open
+    if (s.open.size() >= MAX_OPEN_SPANS) {
+        s.open.clear();
+    }
+
+    const SpanId span = s.nextSpan++;
+    s.open.insert(span, OpenSpan { traceId, name, now() });
+    return span;
+}
+
+void Tracer::end(SpanId span, const QString &detail)
+{
+    if (span == 0) {
+        return;
+    }
+
+    const qint64 timestamp = now();
+    State &s = state();
+    QMutexLocker locker(&s.mutex);
+
+    const auto it = s.open.constFind(span);
+    if (it == s.open.constEnd()) {
+        return;
+    }
+
+    QJsonObject args { { "trace", it->traceId } };
+    if (!detail.isEmpty()) {
+        args.insert("detail", detail);
+    }
+
+    record(s, QJsonObject {
+        { "name", QString::fromLatin1(it->name) },
+        { "cat", "connect" },
+        { "ph", "X" },
+        { "ts", it->start },
+        { "dur", timestamp - it->start },
+        { "pid", qint64(getpid()) },
+        { "tid", 0 },
+        { "args", args },
+    });
+    s.open.erase(it);
+}
+
+void Tracer::instant(const char *name, const QString &detail, const QString &traceId)
+{
+    if (!isEnabled() || traceId.isEmpty()) {
+        return;
+    }
+
+    const qint64 timestamp = now();
+    State &s = state();
+    QMutexLocker locker(&s.mutex);
+
+    QJsonObject args { { "trace", traceId } };
+    if (!detail.isEmpty()) {
+        args.insert("detail", detail);
+    }
+
+    record(s, QJsonObject {
+        { "name", QString::fromLatin1(name) },
+        { "cat", "connect" },
+        { "ph", "i" },
+        { "s", "p" },
+        { "ts", timestamp },
+        { "pid", qint64(getpid()) },
+        { "tid", 0 },
+        { "args", args },
+    });
+}
+
+QJsonArray Tracer::events(const QString &traceId)
+{
+    State &s = state();
+    QMutexLocker locker(&s.mutex);
+
+    QJsonArray result;
+    result.append(QJsonObject {
+        { "name", "process_name" },
+        { "ph", "M" },
+        { "pid", qint64(getpid()) },
+        { "args", QJsonObject { { "name", s.processName } } },
+    });
+
+    for (const QJsonObject &event : std::as_const(s.done)) {
+        if (event.value("args").toObject().value("trace").toString() == traceId) {
+            result.append(event);
+        }
+    }
+    return result;
+}
+
+QByteArray Tracer::toJson(const QJsonArray &events)
+{
+    return QJsonDocument(QJsonObject {
+        { "traceEvents", events },
+        { "displayTimeUnit", "ms" },
+    }).toJson(QJsonDocument::Compact);
+}
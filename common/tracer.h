@@ -0,0 +1,59 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QtCore/QString>
+#include <QtCore/QJsonArray>
+#include <atomic>
+
+/*
+ * Span recorder for the phases of a connection attempt, shared by gpclient
+ * and gpservice.
+ *
+ * Every span belongs to a trace id, which gpclient creates for a connection
+ * attempt and passes to gpservice with the connect call, so the spans of
+ * both processes can be put on one timeline (the timestamps come from
+ * CLOCK_MONOTONIC, which is shared by the processes of a host). The events
+ * are exported in the Chrome trace-event format, for chrome://tracing or
+ * Perfetto.
+ *
+ * With tracing disabled, or with an empty trace id, begin() returns 0 and
+ * end(0) returns immediately: the cost is one atomic load, the current trace
+ * is not even copied.
+ */
+class Tracer
+{
+public:
+    using SpanId = quint64;
+
+    static void setEnabled(bool enabled);
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+    static void setProcessName(const QString &name);
+
+    // A new trace id when tracing is enabled, an empty one otherwise
+    static QString newTraceId();
+    // The attempt followed by this process, used when no trace id is given (main thread only)
+    static void setCurrentTrace(const QString &traceId);
+    static QString currentTrace();
+
+    // In the current trace, which is only read with tracing enabled
+    static SpanId begin(const char *name) { return isEnabled() ? begin(name, currentTrace()) : 0; }
+    static SpanId begin(const char *name, const QString &traceId);
+    static void end(SpanId span, const QString &detail = QString());
+    static void instant(const char *name, const QString &detail = QString()) {
+        if (isEnabled()) {
+            instant(name, detail, currentTrace());
+        }
+    }
+    static void instant(const char *name, const QString &detail, const QString &traceId);
+
+    // The events recorded for the trace, including the process name metadata
+    static QJsonArray events(const QString &traceId);
+    static QByteArray toJson(const QJsonArray &events);
+
+private:
+    static std::atomic<bool> enabled;
+
+    static qint64 now();
+};
+
+#endif // TRACER_H
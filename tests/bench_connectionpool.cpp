@@ -0,0 +1,112 @@
+#include <QtCore/QStandardPaths>
+#include <QtCore/QTemporaryDir>
+#include <QtNetwork/QNetworkAccessManager>
+#include <QtNetwork/QNetworkReply>
+#include <QtTest/QSignalSpy>
+#include <QtTest/QTest>
+
+#include "connectionpool.h"
+#include "mockgateway.h"
+
+/*
+ * The requests of a login, prelogin to getconfig to login, against a local
+ * mock portal: through the pool, preconnected while the portal address was
+ * typed, against a network manager of their own for each of them as the
+ * authentication and the CDP commands had. The connections the portal
+ * accepted tell the handshakes apart, the pool opens one for all of them.
+ */
+class BenchConnectionPool : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void pooled();
+    void cold();
+
+private:
+    QTemporaryDir dir;
+    MockGateway portal;
+
+    static const QStringList paths;
+
+    QNetworkRequest requestOf(const QString &path) const;
+    static bool finishes(QNetworkReply *reply);
+};
+
+const QStringList BenchConnectionPool::paths {
+    "/global-protect/prelogin.esp",
+    "/global-protect/getconfig.esp",
+    "/ssl-vpn/login.esp",
+};
+
+QNetworkRequest BenchConnectionPool::requestOf(const QString &path) const
+{
+    QNetworkRequest request(QUrl("https://" + portal.address() + path));
+    request.setSslConfiguration(ConnectionPool::instance().sslConfiguration(request.url().host()));
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded");
+    return request;
+}
+
+bool BenchConnectionPool::finishes(QNetworkReply *reply)
+{
+    QSignalSpy finished(reply, &QNetworkReply::finished);
+    const bool ok = (reply->isFinished() || finished.wait(5000)) && reply->error() == QNetworkReply::NoError;
+    reply->deleteLater();
+    return ok;
+}
+
+void BenchConnectionPool::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+
+    QVERIFY(dir.isValid());
+    if (!MockGateway::makeCertificate(dir.path())) {
+        QSKIP("Needs openssl(1) for the certificate of the mock portal");
+    }
+    QVERIFY(portal.start(dir.path()));
+}
+
+void BenchConnectionPool::init()
+{
+    portal.resetCounts();
+}
+
+void BenchConnectionPool::pooled()
+{
+    ConnectionPool &pool = ConnectionPool::instance();
+    pool.preconnect(portal.address());
+    QTRY_COMPARE(portal.connections(), 1);
+
+    QBENCHMARK {
+        for (const QString &path : paths) {
+            QVERIFY(finishes(pool.post(requestOf(path), "user=user&passwd=secret")));
+        }
+    }
+
+    QCOMPARE(portal.connections(), 1);
+}
+
+void BenchConnectionPool::cold()
+{
+    int iterations = 0;
+
+    QBENCHMARK {
+        for (const QString &path : paths) {
+            // Nor a TLS session to resume
+            QNetworkRequest request = requestOf(path);
+            request.setSslConfiguration(ConnectionPool::instance().sslConfiguration());
+
+            QNetworkAccessManager manager;
+            QVERIFY(finishes(manager.post(request, "user=user&passwd=secret")));
+        }
+        iterations++;
+    }
+
+    QCOMPARE(portal.connections(), iterations * int(paths.size()));
+}
+
+QTEST_GUILESS_MAIN(BenchConnectionPool)
+
+#include "bench_connectionpool.moc"
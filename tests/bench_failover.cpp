@@ -0,0 +1,130 @@
+#include <QtCore/QFile>
+#include <QtTest/QSignalSpy>
+#include <QtTest/QTest>
+#include <sched.h>
+#include <sys/mount.h>
+#include <unistd.h>
+
+#include "vpnsession.h"
+
+/*
+ * The time to a tunnel when the requested gateway is down: from the connect
+ * to connected() through the next candidate, without a round trip through
+ * the client. A fake openconnect is mounted over /usr/local/bin in a mount
+ * namespace of its own, it needs root but never touches the host. The
+ * gateway it is run for decides what it does: dead.* fails the setup,
+ * rejecting.* rejects the cookie and any other one is configured.
+ */
+class BenchFailover : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void failOver();
+    void cookieRejected();
+
+private:
+    OpenconnectProbe *probe = nullptr;
+    GPConfig *config = nullptr;
+    ScriptHandler *scripts = nullptr;
+    CircuitBreaker breaker;
+
+    static const QByteArray fakeOpenconnect;
+};
+
+const QByteArray BenchFailover::fakeOpenconnect {
+    "#!/bin/sh\n"
+    "case \"$1\" in\n"
+    "--version) echo 'OpenConnect version v9.12'; exit 0 ;;\n"
+    "--help) echo '--resolve'; exit 0 ;;\n"
+    "esac\n"
+    "for server; do :; done\n"
+    "read cookie\n"
+    "case \"$server\" in\n"
+    "dead.*) echo \"Failed to connect to host $server\" >&2; exit 1 ;;\n"
+    "rejecting.*) echo 'Cookie was rejected' >&2; exit 2 ;;\n"
+    "esac\n"
+    "echo 'Connected as 198.18.0.2, using SSL'\n"
+    "exec sleep 600\n"
+};
+
+void BenchFailover::initTestCase()
+{
+    if (geteuid() != 0 || unshare(CLONE_NEWNS) != 0
+        || mount(nullptr, "/", nullptr, MS_REC | MS_PRIVATE, nullptr) != 0
+        || mount("tmpfs", "/usr/local/bin", "tmpfs", 0, nullptr) != 0) {
+        QSKIP("Needs root for a mount namespace of its own");
+    }
+
+    QFile binary("/usr/local/bin/openconnect");
+    QVERIFY(binary.open(QIODevice::WriteOnly));
+    QVERIFY(binary.write(fakeOpenconnect) == fakeOpenconnect.size());
+    binary.close();
+    QVERIFY(binary.setPermissions(QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner));
+
+    probe = new OpenconnectProbe(this);
+    QSignalSpy probed(probe, &OpenconnectProbe::finished);
+    probe->refresh();
+    QVERIFY(!probed.isEmpty() || probed.wait(5000));
+    QVERIFY(probe->result().valid);
+
+    // Nothing is read from there, every setting has its default
+    config = new GPConfig("/nonexistent/gp.conf", this);
+    scripts = new ScriptHandler(this);
+}
+
+void BenchFailover::cleanupTestCase()
+{
+    umount("/usr/local/bin");
+}
+
+void BenchFailover::failOver()
+{
+    VpnSession session("failover", probe, config, &breaker, scripts);
+    QSignalSpy connected(&session, &VpnSession::connected);
+    QSignalSpy disconnected(&session, &VpnSession::disconnected);
+    QSignalSpy failingOver(&session, &VpnSession::failingOver);
+
+    const QVariantMap options { { "candidates", QStringList { "dead.example", "gateway.example" } } };
+    QBENCHMARK {
+        connected.clear();
+        failingOver.clear();
+        session.connectWithOptions("dead.example", "user", "cookie", options);
+        QVERIFY(connected.wait(10000));
+        QCOMPARE(failingOver.size(), 1);
+        QCOMPARE(failingOver.first().first().toString(), QString("gateway.example"));
+
+        disconnected.clear();
+        session.disconnect();
+        QVERIFY(disconnected.wait(10000));
+    }
+}
+
+/* The cookie is not valid on the candidate, which is not a failure of the candidate */
+void BenchFailover::cookieRejected()
+{
+    VpnSession session("rejected", probe, config, &breaker, scripts);
+    QSignalSpy connected(&session, &VpnSession::connected);
+    QSignalSpy disconnected(&session, &VpnSession::disconnected);
+    QSignalSpy authRequired(&session, &VpnSession::authRequired);
+
+    const QVariantMap options { { "candidates", QStringList { "rejecting.example", "gateway.example" } } };
+    QBENCHMARK {
+        authRequired.clear();
+        disconnected.clear();
+        session.connectWithOptions("dead.example", "user", "cookie", options);
+        QVERIFY(disconnected.wait(10000));
+        QCOMPARE(authRequired.size(), 1);
+        QCOMPARE(authRequired.first().first().toString(), QString("rejecting.example"));
+    }
+
+    // The setup stopped there, and the candidate was not held against
+    QVERIFY(connected.isEmpty());
+    QVERIFY(breaker.allow("rejecting.example"));
+}
+
+QTEST_GUILESS_MAIN(BenchFailover)
+
+#include "bench_failover.moc"
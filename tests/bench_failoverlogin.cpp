@@ -0,0 +1,114 @@
+#include <QtCore/QStandardPaths>
+#include <QtCore/QTemporaryDir>
+#include <QtTest/QSignalSpy>
+#include <QtTest/QTest>
+
+#include "authenticationmanager.h"
+#include "mockgateway.h"
+
+/*
+ * The client side of bench_failover: the service failed over to a gateway
+ * that rejected the cookie, and the client logs in to it while the manager
+ * is still authenticated from the first login, as the tray gateway switch
+ * does too. Local mock gateways accept the cookie login.
+ */
+class BenchFailoverLogin : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void reauthenticate();
+    void alreadyAuthenticating();
+
+private:
+    QTemporaryDir dir;
+    MockGateway requested;
+    MockGateway candidate;
+    AuthenticationManager *manager = nullptr;
+
+    static GatewayAuthenticatorParams cookieParams();
+    static QByteArray loginResponse();
+};
+
+/* A cookie login, no login window is shown */
+GatewayAuthenticatorParams BenchFailoverLogin::cookieParams()
+{
+    GatewayAuthenticatorParams params;
+    params.setClientos("Linux");
+    params.setUsername("user");
+    params.setUserAuthCookie("portal-cookie");
+    return params;
+}
+
+/* The arguments of the openconnect command line, the authcookie second */
+QByteArray BenchFailoverLogin::loginResponse()
+{
+    QByteArray arguments;
+    for (int i = 0; i < 16; i++) {
+        arguments += "<argument>" + (i == 1 ? QByteArray("gateway-cookie") : QByteArray::number(i)) + "</argument>";
+    }
+    return "<?xml version=\"1.0\"?><jnlp><application-desc>" + arguments + "</application-desc></jnlp>";
+}
+
+void BenchFailoverLogin::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+
+    QVERIFY(dir.isValid());
+    if (!MockGateway::makeCertificate(dir.path())) {
+        QSKIP("Needs openssl(1) for the certificate of the mock gateways");
+    }
+    QVERIFY(requested.start(dir.path()));
+    QVERIFY(candidate.start(dir.path()));
+    requested.setBody(loginResponse());
+    candidate.setBody(loginResponse());
+}
+
+/* Logged in to the requested gateway, the cookie handed to the connection */
+void BenchFailoverLogin::init()
+{
+    delete manager;
+    manager = new AuthenticationManager(this);
+
+    QSignalSpy succeeded(manager, &AuthenticationManager::gatewayAuthenticationSucceeded);
+    manager->authenticateGateway(requested.address(), cookieParams());
+    QVERIFY(succeeded.wait(5000));
+    QVERIFY(manager->isAuthenticated());
+}
+
+void BenchFailoverLogin::reauthenticate()
+{
+    QSignalSpy succeeded(manager, &AuthenticationManager::gatewayAuthenticationSucceeded);
+    QSignalSpy failed(manager, &AuthenticationManager::authenticationFailed);
+
+    QBENCHMARK {
+        succeeded.clear();
+        candidate.resetCounts();
+        QVERIFY(manager->reauthenticateGateway(candidate.address(), cookieParams()));
+        QVERIFY(succeeded.wait(5000));
+        QCOMPARE(candidate.requests(), 1);
+    }
+
+    QVERIFY(failed.isEmpty());
+    QVERIFY(succeeded.first().first().toString().contains("authcookie=gateway-cookie"));
+    QVERIFY(manager->isAuthenticated());
+}
+
+/* A login still running is not restarted, the caller gives up its switch or failover */
+void BenchFailoverLogin::alreadyAuthenticating()
+{
+    QSignalSpy succeeded(manager, &AuthenticationManager::gatewayAuthenticationSucceeded);
+
+    QVERIFY(manager->reauthenticateGateway(candidate.address(), cookieParams()));
+    QCOMPARE(manager->currentState(), AuthenticationManager::AuthState::AuthenticatingGateway);
+    QVERIFY(!manager->reauthenticateGateway(requested.address(), cookieParams()));
+
+    QVERIFY(succeeded.wait(5000));
+    QCOMPARE(succeeded.size(), 1);
+}
+
+QTEST_GUILESS_MAIN(BenchFailoverLogin)
+
+#include "bench_failoverlogin.moc"
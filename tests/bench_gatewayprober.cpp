@@ -0,0 +1,169 @@
+#include <QtCore/QStandardPaths>
+#include <QtCore/QTemporaryDir>
+#include <QtTest/QSignalSpy>
+#include <QtTest/QTest>
+#include <algorithm>
+#include <limits>
+
+#include "gatewayprober.h"
+#include "mockgateway.h"
+
+/*
+ * The time to a ranking of the gateways of a portal: all of them probed at
+ * once, against one after the other. Local mock gateways answer prelogin.esp
+ * after a delay of their own, one in eight does not listen at all. The
+ * ranking follows the delays, the closed ones last.
+ */
+class BenchGatewayProber : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void parallel_data();
+    void parallel();
+    void sequential_data();
+    void sequential();
+
+private:
+    static const int MAX_GATEWAYS { 40 };
+    static const int DELAY_STEP_MS { 5 };
+    // The mock gateways share the event loop of the prober, their answers are late by as much
+    static const int RANKING_TOLERANCE_MS { 20 };
+
+    QTemporaryDir dir;
+    QList<MockGateway *> servers;
+    QList<GPGateway> gateways;
+
+    static int delayOf(int i) { return ((i * 7) % MAX_GATEWAYS) * DELAY_STEP_MS; }
+
+    QList<GPGateway> gatewaysOf(int count) const;
+    static void verifyRanking(const QList<GPGateway> &ranked, int count);
+};
+
+void BenchGatewayProber::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+
+    QVERIFY(dir.isValid());
+    if (!MockGateway::makeCertificate(dir.path())) {
+        QSKIP("Needs openssl(1) for the certificate of the mock gateways");
+    }
+
+    // The delays are shuffled against the order of the portal
+    for (int i = 0; i < MAX_GATEWAYS; i++) {
+        GPGateway gateway;
+        gateway.setName(QString("gateway-%1").arg(i));
+
+        if (i % 8 != 7) {
+            auto *server = new MockGateway(this);
+            QVERIFY(server->start(dir.path()));
+            server->setDelay(delayOf(i));
+            servers.append(server);
+            gateway.setAddress(server->address());
+        }
+        gateways.append(gateway);
+    }
+
+    // Nothing listens there once the server is gone, the mock gateways keep their ports
+    QTcpServer closed;
+    QVERIFY(closed.listen(QHostAddress::LocalHost));
+    const QString closedAddress = "127.0.0.1:" + QString::number(closed.serverPort());
+    closed.close();
+    for (GPGateway &gateway : gateways) {
+        if (gateway.address().isEmpty()) {
+            gateway.setAddress(closedAddress);
+        }
+    }
+}
+
+QList<GPGateway> BenchGatewayProber::gatewaysOf(int count) const
+{
+    return gateways.mid(0, count);
+}
+
+/* The delay of a gateway is in its name, see initTestCase() */
+void BenchGatewayProber::verifyRanking(const QList<GPGateway> &ranked, int count)
+{
+    QCOMPARE(ranked.size(), count);
+
+    int previousDelay = -1;
+    bool unreachable = false;
+    for (const GPGateway &gateway : ranked) {
+        const int i = gateway.name().section('-', 1).toInt();
+        if (i % 8 == 7) {
+            unreachable = true;
+            continue;
+        }
+        // Reachable after unreachable, or out of order by more than the noise of a loopback
+        QVERIFY2(!unreachable, qPrintable(gateway.name()));
+        const int delay = delayOf(i);
+        QVERIFY2(delay + RANKING_TOLERANCE_MS >= previousDelay, qPrintable(gateway.name()));
+        previousDelay = std::max(previousDelay, delay);
+    }
+}
+
+void BenchGatewayProber::parallel_data()
+{
+    QTest::addColumn<int>("count");
+
+    QTest::newRow("4 gateways") << 4;
+    QTest::newRow("16 gateways") << 16;
+    QTest::newRow("40 gateways") << 40;
+}
+
+void BenchGatewayProber::parallel()
+{
+    QFETCH(int, count);
+
+    GatewayProber prober;
+    QSignalSpy finished(&prober, &GatewayProber::finished);
+
+    QBENCHMARK {
+        finished.clear();
+        prober.probe(gatewaysOf(count), "Any");
+        QVERIFY(finished.wait(10000));
+    }
+
+    verifyRanking(finished.first().first().value<QList<GPGateway>>(), count);
+}
+
+void BenchGatewayProber::sequential_data()
+{
+    parallel_data();
+}
+
+/* One probe per gateway, what a ranking costs when the gateways are tried in turn */
+void BenchGatewayProber::sequential()
+{
+    QFETCH(int, count);
+
+    GatewayProber prober;
+    QSignalSpy finished(&prober, &GatewayProber::finished);
+    QList<std::pair<qint64, GPGateway>> measured;
+
+    QBENCHMARK {
+        measured.clear();
+        for (const GPGateway &gateway : gatewaysOf(count)) {
+            finished.clear();
+            prober.probe({ gateway }, "Any");
+            QVERIFY(finished.wait(10000));
+
+            const GPGateway probed = finished.first().first().value<QList<GPGateway>>().first();
+            measured.append({ probed.latency() < 0 ? std::numeric_limits<qint64>::max() : probed.latency(), probed });
+        }
+    }
+
+    std::stable_sort(measured.begin(), measured.end(), [](const auto &a, const auto &b) {
+        return a.first < b.first;
+    });
+    QList<GPGateway> ranked;
+    for (const auto &entry : std::as_const(measured)) {
+        ranked.append(entry.second);
+    }
+    verifyRanking(ranked, count);
+}
+
+QTEST_GUILESS_MAIN(BenchGatewayProber)
+
+#include "bench_gatewayprober.moc"
@@ -0,0 +1,118 @@
+#include <QtCore/QFile>
+#include <QtCore/QTemporaryDir>
+#include <QtTest/QTest>
+#include <cstdio>
+
+#include "logging.h"
+
+/*
+ * The cost of the log records: a filtered one, and a batch formatted, handed
+ * to the writer thread and written, redaction included, against the same
+ * batch formatted into a string and a stream of each record as LogMessage
+ * did before its buffers were reused. The batches stay below the writer
+ * queue, so that none is dropped. stderr goes to /dev/null, the records are
+ * checked in the log file.
+ */
+class BenchLogger : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void filteredRecord();
+    void recordsWritten();
+    void recordsWrittenFreshBuffer();
+    void nestedRecord();
+
+private:
+    static const int RECORDS_PER_BATCH { 1000 };
+
+    QTemporaryDir dir;
+
+    QString logPath() const { return dir.filePath("gpclient.log"); }
+    QByteArray logContents();
+};
+
+/* Logs a record of its own while it is formatted */
+struct Gateway
+{
+    QString name;
+};
+
+QTextStream &operator<<(QTextStream &stream, const Gateway &gateway)
+{
+    LOGI << "Formatting " << gateway.name;
+    return stream << gateway.name;
+}
+
+QByteArray BenchLogger::logContents()
+{
+    Logger::flush();
+    QFile file(logPath());
+    return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+}
+
+void BenchLogger::initTestCase()
+{
+    QVERIFY(dir.isValid());
+    QVERIFY(std::freopen("/dev/null", "w", stderr));
+    Logger::configure(2, logPath());
+}
+
+void BenchLogger::cleanupTestCase()
+{
+    Logger::flush();
+}
+
+void BenchLogger::filteredRecord()
+{
+    int i = 0;
+    QBENCHMARK {
+        LOGD << "Probe " << ++i << " of " << QString("gateway.example.com") << " answered";
+    }
+}
+
+void BenchLogger::recordsWritten()
+{
+    QBENCHMARK {
+        for (int i = 0; i < RECORDS_PER_BATCH; i++) {
+            LOGI << "Gateway login with portal-userauthcookie=" << QString("0123456789abcdef") << " took " << i << " ms";
+        }
+        Logger::flush();
+    }
+
+    const QByteArray contents = logContents();
+    QVERIFY(contents.contains("portal-userauthcookie=<redacted> took"));
+    QVERIFY(!contents.contains("0123456789abcdef"));
+}
+
+void BenchLogger::recordsWrittenFreshBuffer()
+{
+    QBENCHMARK {
+        for (int i = 0; i < RECORDS_PER_BATCH; i++) {
+            QString text;
+            text.reserve(128);
+            QTextStream stream(&text);
+            stream << "Gateway login with portal-userauthcookie=" << QString("0123456789abcdef") << " took " << i << " ms";
+            stream.flush();
+            Logger::submit(QtInfoMsg, text);
+        }
+        Logger::flush();
+    }
+
+    QVERIFY(logContents().contains("portal-userauthcookie=<redacted> took"));
+}
+
+void BenchLogger::nestedRecord()
+{
+    LOGI << "Connecting to " << Gateway { "gateway.example.com" } << " now";
+
+    const QByteArray contents = logContents();
+    QVERIFY(contents.contains("Formatting gateway.example.com\n"));
+    QVERIFY(contents.contains("Connecting to gateway.example.com now\n"));
+}
+
+QTEST_GUILESS_MAIN(BenchLogger)
+
+#include "bench_logger.moc"
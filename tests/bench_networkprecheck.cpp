@@ -0,0 +1,113 @@
+#include <QtCore/QStandardPaths>
+#include <QtNetwork/QTcpServer>
+#include <QtNetwork/QTcpSocket>
+#include <QtTest/QSignalSpy>
+#include <QtTest/QTest>
+
+#include "networkprecheck.h"
+#include "settingsmanager.h"
+
+/*
+ * The time to a verdict of the network precheck, against a local
+ * connectivity check server and a local portal: the part of the
+ * authentication a captive portal or a filtered network now costs, instead
+ * of the prelogin timeout.
+ */
+class BenchNetworkPrecheck : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void verdict_data();
+    void verdict();
+
+private:
+    // Answers every request of the connectivity check with the status of the current row
+    QTcpServer checkServer;
+    QByteArray checkResponse;
+    QTcpServer portal;
+    quint16 closedPort { 0 };
+};
+
+void BenchNetworkPrecheck::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+
+    QVERIFY(checkServer.listen(QHostAddress::LocalHost));
+    connect(&checkServer, &QTcpServer::newConnection, this, [this]() {
+        while (QTcpSocket *socket = checkServer.nextPendingConnection()) {
+            connect(socket, &QTcpSocket::readyRead, socket, [this, socket]() {
+                if (socket->readAll().contains("\r\n\r\n")) {
+                    socket->write(checkResponse);
+                    socket->disconnectFromHost();
+                }
+            });
+            connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        }
+    });
+    SettingsManager::instance().setConnectivityCheckUrl(QString("http://127.0.0.1:%1/generate_204").arg(checkServer.serverPort()));
+
+    QVERIFY(portal.listen(QHostAddress::LocalHost));
+    connect(&portal, &QTcpServer::newConnection, this, [this]() {
+        while (QTcpSocket *socket = portal.nextPendingConnection()) {
+            socket->abort();
+            socket->deleteLater();
+        }
+    });
+
+    // Nothing listens there once the server is gone
+    QTcpServer closed;
+    QVERIFY(closed.listen(QHostAddress::LocalHost));
+    closedPort = closed.serverPort();
+}
+
+void BenchNetworkPrecheck::verdict_data()
+{
+    QTest::addColumn<QByteArray>("response");
+    QTest::addColumn<bool>("portalUp");
+    QTest::addColumn<NetworkPrecheck::Reachability>("expected");
+    // A reason to fail, or a warning with a reachable portal
+    QTest::addColumn<bool>("message");
+
+    QTest::newRow("reachable")
+        << QByteArray("HTTP/1.1 204 No Content\r\nContent-Length: 0\r\n\r\n") << true
+        << NetworkPrecheck::Reachability::Reachable << false;
+    QTest::newRow("captive portal")
+        << QByteArray("HTTP/1.1 302 Found\r\nLocation: http://login.example/\r\nContent-Length: 0\r\n\r\n") << false
+        << NetworkPrecheck::Reachability::Captive << true;
+    QTest::newRow("proxy answering the check")
+        << QByteArray("HTTP/1.1 403 Forbidden\r\nContent-Length: 0\r\n\r\n") << true
+        << NetworkPrecheck::Reachability::Reachable << true;
+}
+
+void BenchNetworkPrecheck::verdict()
+{
+    QFETCH(QByteArray, response);
+    QFETCH(bool, portalUp);
+    QFETCH(NetworkPrecheck::Reachability, expected);
+    QFETCH(bool, message);
+
+    checkResponse = response;
+    const QString address = QString("127.0.0.1:%1").arg(portalUp ? portal.serverPort() : closedPort);
+
+    NetworkPrecheck precheck;
+    QSignalSpy finished(&precheck, &NetworkPrecheck::finished);
+
+    QBENCHMARK {
+        finished.clear();
+        precheck.check(address);
+        QVERIFY(!finished.isEmpty() || finished.wait(5000));
+
+        const auto reachability = finished.first().at(0).value<NetworkPrecheck::Reachability>();
+        if (reachability == NetworkPrecheck::Reachability::Offline) {
+            QSKIP("No network interface up");
+        }
+        QCOMPARE(reachability, expected);
+        QCOMPARE(!finished.first().at(1).toString().isEmpty(), message);
+    }
+}
+
+QTEST_GUILESS_MAIN(BenchNetworkPrecheck)
+
+#include "bench_networkprecheck.moc"
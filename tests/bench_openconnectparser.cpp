@@ -0,0 +1,133 @@
+#include <QtTest/QSignalSpy>
+#include <QtTest/QTest>
+
+#include "openconnectparser.h"
+
+/*
+ * Parser throughput over a multi-MB openconnect log, fed in the chunks of
+ * the pipe reads, against the former scan of every chunk as a QString. The
+ * chunks split the lines anywhere, the markers split across two of them are
+ * only seen by the parser.
+ */
+class BenchOpenconnectParser : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void parser_data();
+    void parser();
+    void chunkScan_data();
+    void chunkScan();
+
+private:
+    // About 4 MB of log
+    static const int LINES { 64 * 1024 };
+    // One tunnel configured every so many lines
+    static const int MARKER_INTERVAL { 1000 };
+
+    QByteArray log;
+    int markers { 0 };
+
+    static QList<QByteArray> chunks(const QByteArray &data, int size);
+};
+
+void BenchOpenconnectParser::initTestCase()
+{
+    // The lines of a long session with debug output, between the reconnects
+    static const QList<QByteArray> lines {
+        "POST https://gateway.example.com/ssl-vpn/hipreportcheck.esp",
+        "Received DPD response from gateway.example.com",
+        "Sent ESP packet of 1400 bytes, seq 0x0001a2b3",
+        "Received ESP packet of 1380 bytes from 198.51.100.7, seq 0x0000f00d",
+        "Got HTTP response: HTTP/1.1 200 OK",
+        "Send DPD request to gateway.example.com",
+        "ESP tunnel connected; exiting HTTPS mainloop.",
+    };
+
+    log.reserve(LINES * 64);
+    for (int i = 0; i < LINES; i++) {
+        if (i % MARKER_INTERVAL == 0) {
+            log += "Connected as 198.18.0.2, using SSL, with ESP in progress\n";
+            markers++;
+        } else {
+            log += lines.at(i % lines.size()) + '\n';
+        }
+    }
+}
+
+QList<QByteArray> BenchOpenconnectParser::chunks(const QByteArray &data, int size)
+{
+    QList<QByteArray> result;
+    result.reserve(data.size() / size + 1);
+    for (qsizetype offset = 0; offset < data.size(); offset += size) {
+        result.append(data.mid(offset, size));
+    }
+    return result;
+}
+
+void BenchOpenconnectParser::parser_data()
+{
+    QTest::addColumn<int>("chunkSize");
+
+    QTest::newRow("512 B reads") << 512;
+    QTest::newRow("4 KB reads") << 4096;
+    QTest::newRow("64 KB reads") << 65536;
+}
+
+void BenchOpenconnectParser::parser()
+{
+    QFETCH(int, chunkSize);
+
+    const QList<QByteArray> reads = chunks(log, chunkSize);
+    OpenconnectParser parser;
+    int configured = 0;
+    connect(&parser, &OpenconnectParser::eventDetected, this, [&configured](OpenconnectParser::Event event) {
+        if (event == OpenconnectParser::TunnelConfigured) {
+            configured++;
+        }
+    });
+
+    QBENCHMARK {
+        configured = 0;
+        parser.reset();
+        for (const QByteArray &read : reads) {
+            parser.feed(read);
+        }
+        parser.flush();
+    }
+
+    QCOMPARE(configured, markers);
+}
+
+void BenchOpenconnectParser::chunkScan_data()
+{
+    parser_data();
+}
+
+/* What gpservice did before the parser: every read converted and searched as a whole */
+void BenchOpenconnectParser::chunkScan()
+{
+    QFETCH(int, chunkSize);
+
+    const QList<QByteArray> reads = chunks(log, chunkSize);
+    int configured = 0;
+
+    QBENCHMARK {
+        configured = 0;
+        for (const QByteArray &read : reads) {
+            const QString output = QString::fromUtf8(read);
+            if (output.indexOf("Connected as") >= 0 || output.indexOf("Configured as") >= 0
+                || output.indexOf("Configurado como") >= 0) {
+                configured++;
+            }
+        }
+    }
+
+    // At most one per read, and none where the marker is split
+    QVERIFY(configured <= markers);
+}
+
+QTEST_GUILESS_MAIN(BenchOpenconnectParser)
+
+#include "bench_openconnectparser.moc"
@@ -0,0 +1,87 @@
+#include <QtCore/QProcess>
+#include <QtTest/QSignalSpy>
+#include <QtTest/QTest>
+#include <sched.h>
+#include <unistd.h>
+
+#include "routemonitor.h"
+
+/*
+ * The first part of the time to a restored tunnel after a network change:
+ * from the new default route to RouteMonitor::changed(), which makes the
+ * sessions reconnect. Runs in its own network namespace, so it needs root
+ * but never touches the routes of the host.
+ */
+class BenchRouteMonitor : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void detectNewNetwork();
+    void fullTunnelIsNotAChange();
+
+private:
+    static bool ip(const QStringList &args);
+};
+
+bool BenchRouteMonitor::ip(const QStringList &args)
+{
+    QProcess process;
+    process.start("ip", args);
+    return process.waitForFinished() && process.exitStatus() == QProcess::NormalExit && process.exitCode() == 0;
+}
+
+void BenchRouteMonitor::initTestCase()
+{
+    if (geteuid() != 0 || unshare(CLONE_NEWNET) != 0) {
+        QSKIP("Needs root for a network namespace of its own");
+    }
+
+    for (const QString &device : { "uplink0", "uplink1" }) {
+        QVERIFY(ip({ "link", "add", device, "type", "dummy" }));
+        QVERIFY(ip({ "link", "set", device, "up" }));
+    }
+    QVERIFY(ip({ "addr", "add", "192.0.2.10/24", "dev", "uplink0" }));
+    QVERIFY(ip({ "addr", "add", "198.51.100.10/24", "dev", "uplink1" }));
+    QVERIFY(ip({ "route", "add", "default", "via", "192.0.2.1", "dev", "uplink0" }));
+
+    if (!ip({ "tuntap", "add", "mode", "tun", "tun0" }) || !ip({ "link", "set", "tun0", "up" })) {
+        QSKIP("Cannot create a tun device");
+    }
+}
+
+void BenchRouteMonitor::detectNewNetwork()
+{
+    RouteMonitor monitor;
+    QSignalSpy changed(&monitor, &RouteMonitor::changed);
+    monitor.start();
+
+    bool onUplink1 = false;
+    QBENCHMARK {
+        onUplink1 = !onUplink1;
+        QVERIFY(ip({ "route", "replace", "default", "via", onUplink1 ? "198.51.100.1" : "192.0.2.1",
+                     "dev", onUplink1 ? "uplink1" : "uplink0" }));
+        QVERIFY(changed.wait(10000));
+        changed.clear();
+    }
+}
+
+/* The vpnc-script of a full tunnel replaces the default route and puts it back */
+void BenchRouteMonitor::fullTunnelIsNotAChange()
+{
+    QVERIFY(ip({ "route", "replace", "default", "via", "192.0.2.1", "dev", "uplink0" }));
+
+    RouteMonitor monitor;
+    QSignalSpy changed(&monitor, &RouteMonitor::changed);
+    monitor.start();
+
+    QVERIFY(ip({ "route", "replace", "default", "dev", "tun0" }));
+    QVERIFY(!changed.wait(3000));
+    QVERIFY(ip({ "route", "replace", "default", "via", "192.0.2.1", "dev", "uplink0" }));
+    QVERIFY(!changed.wait(3000));
+}
+
+QTEST_GUILESS_MAIN(BenchRouteMonitor)
+
+#include "bench_routemonitor.moc"
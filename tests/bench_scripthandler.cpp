@@ -0,0 +1,167 @@
+#include <QtCore/QProcess>
+#include <QtCore/QTemporaryDir>
+#include <QtNetwork/QLocalSocket>
+#include <QtTest/QSignalSpy>
+#include <QtTest/QTest>
+#include <sched.h>
+#include <unistd.h>
+
+#include "scripthandler.h"
+
+/*
+ * The time to configure the routes of a split tunnel: the built-in handler
+ * (one request over its socket, the routes in batched rtnetlink messages)
+ * against what vpnc-script does (one ip(8) process per route). A dummy
+ * device stands in for the tun device, in a network namespace of its own:
+ * it needs root but never touches the routes of the host.
+ */
+class BenchScriptHandler : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanup();
+    void builtin_data();
+    void builtin();
+    void ipPerRoute_data();
+    void ipPerRoute();
+
+private:
+    const QString device { "gpbench0" };
+    QTemporaryDir dir;
+    ScriptHandler *handler = nullptr;
+
+    static bool ip(const QStringList &args);
+    static int routeCount(const QString &device);
+    static QString routeAddress(int i);
+    QByteArray request(const QString &reason, int routes) const;
+    bool send(const QByteArray &request);
+};
+
+bool BenchScriptHandler::ip(const QStringList &args)
+{
+    QProcess process;
+    process.start("ip", args);
+    return process.waitForFinished() && process.exitStatus() == QProcess::NormalExit && process.exitCode() == 0;
+}
+
+int BenchScriptHandler::routeCount(const QString &device)
+{
+    QProcess process;
+    process.start("ip", { "-4", "route", "show", "dev", device });
+    process.waitForFinished();
+    return process.readAllStandardOutput().count('\n');
+}
+
+QString BenchScriptHandler::routeAddress(int i)
+{
+    return QString("10.%1.%2.0").arg(i / 256).arg(i % 256);
+}
+
+/* The environment openconnect gives to the script, as the helper forwards it */
+QByteArray BenchScriptHandler::request(const QString &reason, int routes) const
+{
+    QStringList env {
+        "reason=" + reason,
+        "TUNDEV=" + device,
+        "INTERNAL_IP4_ADDRESS=198.18.0.1",
+        "INTERNAL_IP4_MTU=1400",
+        "CISCO_SPLIT_INC=" + QString::number(routes),
+    };
+    for (int i = 0; i < routes; i++) {
+        env << QString("CISCO_SPLIT_INC_%1_ADDR=%2").arg(i).arg(routeAddress(i))
+            << QString("CISCO_SPLIT_INC_%1_MASKLEN=24").arg(i);
+    }
+
+    QByteArray data;
+    for (const QString &variable : std::as_const(env)) {
+        data += variable.toUtf8() + '\0';
+    }
+    return data + '\0';
+}
+
+/* The handler runs on this thread, the answer is waited for in the event loop */
+bool BenchScriptHandler::send(const QByteArray &request)
+{
+    QLocalSocket socket;
+    socket.connectToServer(dir.filePath("script.sock"));
+    if (!socket.waitForConnected(5000)) {
+        return false;
+    }
+    socket.write(request);
+
+    QSignalSpy disconnected(&socket, &QLocalSocket::disconnected);
+    if (!disconnected.wait(60000)) {
+        return false;
+    }
+    return socket.readAll() == "ok\n";
+}
+
+void BenchScriptHandler::initTestCase()
+{
+    if (geteuid() != 0 || unshare(CLONE_NEWNET) != 0) {
+        QSKIP("Needs root for a network namespace of its own");
+    }
+
+    QVERIFY(dir.isValid());
+    QVERIFY(ip({ "link", "add", device, "type", "dummy" }));
+
+    handler = new ScriptHandler(this);
+    handler->listen(dir.filePath("script.sock"));
+    QVERIFY(handler->isListening());
+}
+
+void BenchScriptHandler::cleanup()
+{
+    ip({ "route", "flush", "dev", device });
+}
+
+void BenchScriptHandler::builtin_data()
+{
+    QTest::addColumn<int>("routes");
+
+    QTest::newRow("100 routes") << 100;
+    QTest::newRow("1000 routes") << 1000;
+    QTest::newRow("10000 routes") << 10000;
+}
+
+void BenchScriptHandler::builtin()
+{
+    QFETCH(int, routes);
+
+    const QByteArray connect = request("connect", routes);
+    const QByteArray disconnect = request("disconnect", 0);
+    QBENCHMARK {
+        // Forgets the device, every connect is applied in full
+        QVERIFY(send(disconnect));
+        QVERIFY(send(connect));
+    }
+
+    QCOMPARE(routeCount(device), routes);
+}
+
+void BenchScriptHandler::ipPerRoute_data()
+{
+    builtin_data();
+}
+
+void BenchScriptHandler::ipPerRoute()
+{
+    QFETCH(int, routes);
+
+    QVERIFY(ip({ "link", "set", device, "up", "mtu", "1400" }));
+    QVERIFY(ip({ "addr", "replace", "198.18.0.1/32", "dev", device }));
+
+    QBENCHMARK {
+        for (int i = 0; i < routes; i++) {
+            QVERIFY(ip({ "route", "replace", routeAddress(i) + "/24", "dev", device }));
+        }
+    }
+
+    QCOMPARE(routeCount(device), routes);
+}
+
+QTEST_GUILESS_MAIN(BenchScriptHandler)
+
+#include "bench_scripthandler.moc"
@@ -0,0 +1,105 @@
+#include <QtCore/QProcess>
+#include <QtTest/QSignalSpy>
+#include <QtTest/QTest>
+#include <sched.h>
+#include <unistd.h>
+
+#include "tunnelhandover.h"
+
+/*
+ * The switch gap of a make-before-break gateway switch: the time from the
+ * new tunnel being configured to every route of the old tunnel being on the
+ * new device. Two dummy devices stand in for the tun devices, in a network
+ * namespace of its own: it needs root but never touches the routes of the
+ * host.
+ */
+class BenchTunnelHandover : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void moveRoutes_data();
+    void moveRoutes();
+
+private:
+    const QString from { "gpbench0" };
+    const QString to { "gpbench1" };
+
+    static bool ip(const QStringList &args, const QByteArray &input = QByteArray());
+    static int routeCount(const QString &device);
+};
+
+bool BenchTunnelHandover::ip(const QStringList &args, const QByteArray &input)
+{
+    QProcess process;
+    process.start("ip", args);
+    if (!input.isEmpty()) {
+        process.write(input);
+    }
+    process.closeWriteChannel();
+    return process.waitForFinished() && process.exitStatus() == QProcess::NormalExit && process.exitCode() == 0;
+}
+
+int BenchTunnelHandover::routeCount(const QString &device)
+{
+    QProcess process;
+    process.start("ip", { "-4", "route", "show", "dev", device });
+    process.waitForFinished();
+    return process.readAllStandardOutput().count('\n');
+}
+
+void BenchTunnelHandover::initTestCase()
+{
+    if (geteuid() != 0 || unshare(CLONE_NEWNET) != 0) {
+        QSKIP("Needs root for a network namespace of its own");
+    }
+
+    for (const QString &device : { from, to }) {
+        QVERIFY(ip({ "link", "add", device, "type", "dummy" }));
+        QVERIFY(ip({ "link", "set", device, "up" }));
+    }
+    QVERIFY(ip({ "addr", "add", "198.18.0.1/32", "dev", from }));
+    QVERIFY(ip({ "addr", "add", "198.18.0.2/32", "dev", to }));
+}
+
+void BenchTunnelHandover::moveRoutes_data()
+{
+    QTest::addColumn<int>("routes");
+
+    QTest::newRow("100 routes") << 100;
+    QTest::newRow("1000 routes") << 1000;
+    QTest::newRow("10000 routes") << 10000;
+}
+
+void BenchTunnelHandover::moveRoutes()
+{
+    QFETCH(int, routes);
+
+    QByteArray batch;
+    for (int i = 0; i < routes; i++) {
+        batch += QString("route replace 10.%1.%2.0/24 dev %3\n").arg(i / 256).arg(i % 256).arg(from).toUtf8();
+    }
+    QVERIFY(ip({ "-batch", "-" }, batch));
+
+    // Back and forth, every iteration starts with the routes on the device it moves them from
+    QString source = from;
+    QString target = to;
+    QBENCHMARK {
+        TunnelHandover handover(source, target);
+        QSignalSpy finished(&handover, &TunnelHandover::finished);
+        handover.start();
+        QVERIFY(finished.wait(60000));
+        QVERIFY(finished.first().first().toBool());
+        std::swap(source, target);
+    }
+
+    QCOMPARE(routeCount(source), routes);
+    QCOMPARE(routeCount(target), 0);
+
+    ip({ "route", "flush", "dev", source });
+}
+
+QTEST_GUILESS_MAIN(BenchTunnelHandover)
+
+#include "bench_tunnelhandover.moc"
@@ -0,0 +1,112 @@
+#ifndef MOCKGATEWAY_H
+#define MOCKGATEWAY_H
+
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QProcess>
+#include <QtCore/QTimer>
+#include <QtNetwork/QSslCertificate>
+#include <QtNetwork/QSslKey>
+#include <QtNetwork/QSslSocket>
+#include <QtNetwork/QTcpServer>
+
+/*
+ * A local HTTPS server standing in for a portal or a gateway: every request
+ * is answered 200 with the configured body after the configured delay, on a
+ * connection kept alive.
+ * The connections and requests are counted. The certificate is self-signed,
+ * made once per directory with openssl(1), see makeCertificate().
+ */
+class MockGateway : public QTcpServer
+{
+public:
+    using QTcpServer::QTcpServer;
+
+    static bool makeCertificate(const QString &dir)
+    {
+        if (QFile::exists(dir + "/cert.pem")) {
+            return true;
+        }
+
+        QProcess openssl;
+        openssl.start("openssl", { "req", "-x509", "-nodes", "-days", "1", "-subj", "/CN=127.0.0.1",
+                                   "-newkey", "ec", "-pkeyopt", "ec_paramgen_curve:prime256v1",
+                                   "-keyout", dir + "/key.pem", "-out", dir + "/cert.pem" });
+        return openssl.waitForFinished() && openssl.exitStatus() == QProcess::NormalExit && openssl.exitCode() == 0;
+    }
+
+    bool start(const QString &dir)
+    {
+        QFile cert(dir + "/cert.pem");
+        QFile key(dir + "/key.pem");
+        if (!cert.open(QIODevice::ReadOnly) || !key.open(QIODevice::ReadOnly)) {
+            return false;
+        }
+        certificate = QSslCertificate(&cert);
+        privateKey = QSslKey(&key, QSsl::Ec);
+        return !certificate.isNull() && !privateKey.isNull() && listen(QHostAddress::LocalHost);
+    }
+
+    QString address() const { return "127.0.0.1:" + QString::number(serverPort()); }
+
+    void setDelay(int ms) { delay = ms; }
+    void setBody(const QByteArray &newBody) { body = newBody; }
+    int connections() const { return connectionCount; }
+    int requests() const { return requestCount; }
+    void resetCounts() { connectionCount = requestCount = 0; }
+
+protected:
+    void incomingConnection(qintptr descriptor) override
+    {
+        auto *socket = new QSslSocket(this);
+        if (!socket->setSocketDescriptor(descriptor)) {
+            delete socket;
+            return;
+        }
+        connectionCount++;
+
+        socket->setLocalCertificate(certificate);
+        socket->setPrivateKey(privateKey);
+        connect(socket, &QSslSocket::readyRead, socket, [this, socket]() { serve(socket); });
+        connect(socket, &QSslSocket::disconnected, socket, &QObject::deleteLater);
+        socket->startServerEncryption();
+    }
+
+private:
+    QSslCertificate certificate;
+    QSslKey privateKey;
+    int delay { 0 };
+    QByteArray body { "<response status=\"success\"/>" };
+    int connectionCount { 0 };
+    int requestCount { 0 };
+
+    // Answers the complete requests in the buffer, the client does not pipeline
+    void serve(QSslSocket *socket)
+    {
+        QByteArray buffer = socket->property("buffer").toByteArray() + socket->readAll();
+
+        qsizetype end;
+        while ((end = buffer.indexOf("\r\n\r\n")) >= 0) {
+            qsizetype length = 0;
+            for (const QByteArray &header : buffer.left(end).split('\n')) {
+                if (header.toLower().startsWith("content-length:")) {
+                    length = header.mid(15).trimmed().toLongLong();
+                }
+            }
+            if (buffer.size() < end + 4 + length) {
+                break;
+            }
+            buffer.remove(0, end + 4 + length);
+            requestCount++;
+
+            QTimer::singleShot(delay, socket, [socket, response = body]() {
+                socket->write("HTTP/1.1 200 OK\r\nContent-Type: application/xml\r\nContent-Length: "
+                              + QByteArray::number(response.size()) + "\r\n\r\n" + response);
+            });
+        }
+
+        socket->setProperty("buffer", buffer);
+    }
+};
+
+#endif // MOCKGATEWAY_H